@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "memory_pool/memory_pool.h"
+
+// 申请记录的开销，同时生成一份给 memory_pool_replay_benchmark 回放的记录
+// 同样的工作量先在不记录时运行一次，再开始记录运行一次
+// 工作量模拟一个服务：每个线程持有一批长短不一的对象，随机替换，偶尔申请大块内存，
+// 一部分对象交给下一个线程归还，每次操作之间有一点计算
+// 同一份代码编译成两个程序，一个没有编译进申请记录，一个定义了 MEMORY_POOL_ALLOCATION_TRACE
+
+const size_t NUM_THREADS = 4;                   // 工作线程数
+const size_t OPERATIONS_PER_THREAD = 200000;    // 每个线程的申请次数
+const size_t LIVE_OBJECTS = 2048;               // 每个线程同时持有的对象个数
+const size_t OBJECT_SIZES[] = {16, 24, 32, 48, 64, 96, 128, 192, 256, 512, 1024, 1500};
+const size_t LARGE_OBJECT_INTERVAL = 2000;      // 每隔多少次申请一个大块内存
+const size_t LARGE_OBJECT_SIZE = 256 * 1024;    // 大块内存的大小
+const size_t HANDOFF_INTERVAL = 16;             // 每隔多少次把一个对象交给下一个线程归还
+const size_t WORK_PER_OPERATION = 50;           // 每次操作之间的计算量
+const unsigned int RANDOM_SEED = 54321;         // 固定的随机种子，确保每次运行结果可复现
+const char* TRACE_PATH = "memory_pool_allocations.trace";
+
+// 交给下一个线程归还的对象
+struct handoff_queue {
+    std::mutex mutex;
+    std::deque<std::pair<void*, size_t>> objects;
+};
+
+// 所有工作线程跑完需要的时间 (ms)
+double run_workers() {
+    std::vector<handoff_queue> queues(NUM_THREADS);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < NUM_THREADS; ++t) {
+        threads.emplace_back([t, &queues] {
+            std::mt19937 rng(RANDOM_SEED + t);
+            std::vector<std::pair<void*, size_t>> objects(LIVE_OBJECTS, {nullptr, 0});
+            std::deque<std::pair<void*, size_t>> received;
+            volatile size_t work = 0;
+            for (size_t i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+                auto& [object, size] = objects[rng() % LIVE_OBJECTS];
+                if (object != nullptr && i % HANDOFF_INTERVAL == 0) {
+                    handoff_queue& next = queues[(t + 1) % NUM_THREADS];
+                    std::lock_guard<std::mutex> lock(next.mutex);
+                    next.objects.emplace_back(object, size);
+                } else {
+                    memory_pool::memory_pool::deallocate(object, size);
+                }
+                size = i % LARGE_OBJECT_INTERVAL == 0 ? LARGE_OBJECT_SIZE
+                                                      : OBJECT_SIZES[rng() % std::size(OBJECT_SIZES)];
+                object = memory_pool::memory_pool::allocate(size).value();
+                static_cast<char*>(object)[0] = 1;
+
+                if (i % HANDOFF_INTERVAL == HANDOFF_INTERVAL / 2) {
+                    std::lock_guard<std::mutex> lock(queues[t].mutex);
+                    received.swap(queues[t].objects);
+                }
+                for (auto [other, other_size] : received) {
+                    memory_pool::memory_pool::deallocate(other, other_size);
+                }
+                received.clear();
+                for (size_t w = 0; w < WORK_PER_OPERATION; ++w) {
+                    work = work + w;
+                }
+            }
+            for (auto& [object, size] : objects) {
+                memory_pool::memory_pool::deallocate(object, size);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // 最后一批交出去的对象
+    for (handoff_queue& queue : queues) {
+        for (auto [object, size] : queue.objects) {
+            memory_pool::memory_pool::deallocate(object, size);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    const std::string trace_path = argc > 1 ? argv[1] : TRACE_PATH;
+    std::cout << "\n=== Allocation Trace Benchmark ===\n"
+              << "Threads: " << NUM_THREADS << ", operations per thread: " << OPERATIONS_PER_THREAD << "\n"
+#ifdef MEMORY_POOL_ALLOCATION_TRACE
+              << "Allocation recorder: compiled in\n\n";
+#else
+              << "Allocation recorder: compiled out\n\n";
+#endif
+
+    // 先跑一次让内存池准备好页面，两次测量的条件相同
+    run_workers();
+    const double quiet_ms = run_workers();
+
+    std::cout << std::left << std::fixed << std::setprecision(2)
+              << std::setw(32) << "Not recording (ms)" << quiet_ms << "\n";
+    if (!memory_pool::memory_pool::start_allocation_trace(trace_path)) {
+        std::cout << "Recording not available in this build\n";
+        return 0;
+    }
+    const double recording_ms = run_workers();
+    const bool written = memory_pool::memory_pool::stop_allocation_trace();
+
+    const uintmax_t file_size = std::filesystem::file_size(trace_path);
+    const uintmax_t records = (file_size - sizeof(memory_pool::allocation_trace_header)) /
+                              sizeof(memory_pool::allocation_record);
+    std::cout << std::setw(32) << "Recording (ms)" << recording_ms << "\n"
+              << std::setw(32) << "Overhead (%)" << (recording_ms / quiet_ms - 1) * 100 << "\n"
+              << std::setw(32) << "Records" << records << "\n"
+              << std::setw(32) << "Trace size (MB)" << file_size / (1024.0 * 1024.0) << "\n"
+              << std::setw(32) << "Overhead per record (ns)"
+              << (recording_ms - quiet_ms) * 1e6 / static_cast<double>(std::max<uintmax_t>(records, 1)) << "\n"
+              << std::setw(32) << "All records written" << (written ? "yes" : "no") << "\n\n"
+              << "Replay with: memory_pool_replay_benchmark " << trace_path << "\n";
+    return written ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include "memory_pool/pool_allocator.h"
+
+// 对比 std::allocator 和 memory_pool::pool_allocator 在结点容器上的表现
+// 结点容器每一次只申请一个结点，pool_allocator在编译期就算好了结点大小对应的下标
+
+const size_t NUM_KEYS = 100000;          // 容器中同时存在的最多元素个数
+const size_t NUM_OPERATIONS = 2000000;   // 每一个负载执行的操作次数
+const unsigned int RANDOM_SEED = 54321;  // 固定的随机种子，确保每次运行结果可复现
+const unsigned int NUM_RUNS = 3;         // 运行次数
+
+// 返回整个负载耗费的时间 (ms)
+template <typename Workload>
+double measure(Workload workload) {
+    auto start = std::chrono::steady_clock::now();
+    workload();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// 随机插入、删除 std::map
+template <template <typename> class Allocator>
+void map_churn() {
+    using value_type = std::pair<const int, int>;
+    std::mt19937 rng(RANDOM_SEED);
+    std::map<int, int, std::less<int>, Allocator<value_type>> map;
+    for (size_t i = 0; i < NUM_OPERATIONS; ++i) {
+        int key = static_cast<int>(rng() % NUM_KEYS);
+        if (rng() % 2 == 0) {
+            map[key] = static_cast<int>(i);
+        } else {
+            map.erase(key);
+        }
+    }
+}
+
+// 随机插入、删除 std::unordered_map
+template <template <typename> class Allocator>
+void unordered_map_churn() {
+    using value_type = std::pair<const int, int>;
+    std::mt19937 rng(RANDOM_SEED);
+    std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, Allocator<value_type>> map;
+    for (size_t i = 0; i < NUM_OPERATIONS; ++i) {
+        int key = static_cast<int>(rng() % NUM_KEYS);
+        if (rng() % 2 == 0) {
+            map[key] = static_cast<int>(i);
+        } else {
+            map.erase(key);
+        }
+    }
+}
+
+// 在 std::list 的两端随机追加和删除
+template <template <typename> class Allocator>
+void list_churn() {
+    std::mt19937 rng(RANDOM_SEED);
+    std::list<int, Allocator<int>> list;
+    for (size_t i = 0; i < NUM_OPERATIONS; ++i) {
+        if (list.size() < NUM_KEYS && rng() % 2 == 0) {
+            list.push_back(static_cast<int>(i));
+        } else if (!list.empty()) {
+            list.pop_front();
+        }
+    }
+}
+
+int main() {
+    std::cout << "\n=== Node Container Allocator Benchmark ===\n"
+              << "Operations per workload: " << NUM_OPERATIONS << "\n"
+              << "Number of runs: " << NUM_RUNS << "\n\n";
+
+    std::cout << std::left << std::setw(20) << "Workload"
+              << std::right << std::setw(20) << "std::allocator (ms)"
+              << std::setw(20) << "pool_allocator (ms)"
+              << std::setw(15) << "speedup" << "\n";
+    std::cout << std::string(75, '-') << "\n";
+
+    auto print_line = [](const std::string& name, std::function<void()> std_workload, std::function<void()> pool_workload) {
+        double std_ms = 0, pool_ms = 0;
+        for (unsigned int run = 0; run < NUM_RUNS; ++run) {
+            std_ms += measure(std_workload);
+            pool_ms += measure(pool_workload);
+        }
+        std::cout << std::left << std::setw(20) << name
+                  << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(20) << std_ms / NUM_RUNS
+                  << std::setw(20) << pool_ms / NUM_RUNS
+                  << std::setw(14) << (pool_ms > 0 ? std_ms / pool_ms : 0.0) << "x\n";
+    };
+    print_line("std::map", map_churn<std::allocator>, map_churn<memory_pool::pool_allocator>);
+    print_line("std::unordered_map", unordered_map_churn<std::allocator>, unordered_map_churn<memory_pool::pool_allocator>);
+    print_line("std::list", list_churn<std::allocator>, list_churn<memory_pool::pool_allocator>);
+
+    return 0;
+}
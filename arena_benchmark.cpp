@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+#include "memory_pool/arena.h"
+#include "memory_pool/memory_pool.h"
+
+// 模拟一次请求的处理（解析、转换、回复）：申请大量小对象，请求结束时全部销毁
+// 对比 arena 整体释放、内存池逐个释放和 malloc/free 逐个释放的单次请求延迟
+
+const size_t NUM_REQUESTS = 20000;          // 请求个数
+const size_t OBJECTS_PER_REQUEST = 2000;    // 每个请求申请的对象个数
+const size_t MIN_OBJECT_SIZE = 16;          // 最小的对象大小
+const size_t MAX_OBJECT_SIZE = 256;         // 最大的对象大小
+const unsigned int RANDOM_SEED = 54321;     // 固定的随机种子，确保每次运行结果可复现
+
+struct LatencyStats {
+    double average_us = 0;
+    double p99_us = 0;
+};
+
+// 处理所有的请求，返回单次请求的延迟
+// allocate(size)申请一个对象，finish(objects, sizes)在请求结束时释放这个请求中的所有对象
+template <typename Allocate, typename Finish>
+LatencyStats run_requests(const std::vector<size_t>& sizes, Allocate allocate, Finish finish) {
+    std::vector<void*> objects(OBJECTS_PER_REQUEST);
+    std::vector<double> latencies;
+    latencies.reserve(NUM_REQUESTS);
+    for (size_t request = 0; request < NUM_REQUESTS; ++request) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < OBJECTS_PER_REQUEST; ++i) {
+            objects[i] = allocate(sizes[i]);
+            // 写一下对象的开头，模拟初始化
+            std::memset(objects[i], 0, MIN_OBJECT_SIZE);
+        }
+        finish(objects, sizes);
+        auto end = std::chrono::steady_clock::now();
+        latencies.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    LatencyStats stats;
+    for (double latency : latencies) {
+        stats.average_us += latency;
+    }
+    stats.average_us /= latencies.size();
+    stats.p99_us = latencies[latencies.size() * 99 / 100];
+    return stats;
+}
+
+int main() {
+    std::mt19937 rng(RANDOM_SEED);
+    std::uniform_int_distribution<size_t> size_dist(MIN_OBJECT_SIZE, MAX_OBJECT_SIZE);
+    std::vector<size_t> sizes(OBJECTS_PER_REQUEST);
+    for (auto& size : sizes) {
+        size = size_dist(rng);
+    }
+
+    std::cout << "\n=== Request-scoped Allocation Benchmark ===\n"
+              << "Requests: " << NUM_REQUESTS << ", objects per request: " << OBJECTS_PER_REQUEST
+              << " (" << MIN_OBJECT_SIZE << "-" << MAX_OBJECT_SIZE << " B)\n\n";
+
+    memory_pool::arena arena;
+    auto arena_stats = run_requests(
+        sizes, [&](size_t size) { return arena.allocate(size).value(); },
+        [&](const std::vector<void*>&, const std::vector<size_t>&) { arena.reset(); });
+
+    // 用pmr容器的方式使用arena，请求结束时回退到请求开始的位置
+    auto marker = arena.save();
+    auto resource = arena.resource();
+    auto arena_pmr_stats = run_requests(
+        sizes, [&](size_t size) { return resource->allocate(size); },
+        [&](const std::vector<void*>&, const std::vector<size_t>&) { arena.rewind(marker); });
+
+    auto pool_stats = run_requests(
+        sizes, [](size_t size) { return memory_pool::memory_pool::allocate(size).value(); },
+        [](const std::vector<void*>& objects, const std::vector<size_t>& object_sizes) {
+            for (size_t i = 0; i < objects.size(); ++i) {
+                memory_pool::memory_pool::deallocate(objects[i], object_sizes[i]);
+            }
+        });
+
+    auto malloc_stats = run_requests(
+        sizes, [](size_t size) { return std::malloc(size); },
+        [](const std::vector<void*>& objects, const std::vector<size_t>&) {
+            for (void* object : objects) {
+                std::free(object);
+            }
+        });
+
+    std::cout << std::left << std::setw(30) << "Method"
+              << std::right << std::setw(15) << "Avg (us)"
+              << std::setw(15) << "P99 (us)" << "\n";
+    std::cout << std::string(60, '-') << "\n";
+    auto print_line = [](const std::string& name, const LatencyStats& stats) {
+        std::cout << std::left << std::setw(30) << name
+                  << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(15) << stats.average_us
+                  << std::setw(15) << stats.p99_us << "\n";
+    };
+    print_line("arena (reset)", arena_stats);
+    print_line("arena pmr view (rewind)", arena_pmr_stats);
+    print_line("memory_pool", pool_stats);
+    print_line("malloc/free", malloc_stats);
+
+    return 0;
+}
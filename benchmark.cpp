@@ -346,6 +346,61 @@ void print_comparison_line(const std::string& metric,
                          higher_is_better);
 }
 
+// 大块内存的尺寸扫描：16KB ~ 64MB，每个尺寸反复申请一批内存、写一遍再全部释放
+void run_large_size_sweep() {
+    constexpr size_t MIN_SWEEP_SIZE = 16 * 1024;
+    constexpr size_t MAX_SWEEP_SIZE = 64 * 1024 * 1024;
+    // 每个尺寸总共处理的字节数，用来决定循环次数
+    constexpr size_t BYTES_PER_SIZE = 1024ull * 1024 * 1024;
+    constexpr size_t BATCH = 8;
+
+    std::cout << "\n=== Large Allocation Size Sweep ===\n";
+    std::cout << std::left << std::setw(15) << "Size"
+              << std::right << std::setw(20) << "Pool (ns/op)"
+              << std::setw(20) << "malloc (ns/op)"
+              << std::setw(15) << "Pool/malloc" << "\n";
+    std::cout << std::string(70, '-') << "\n";
+
+    auto run = [](size_t size, size_t rounds, auto allocate_func, auto deallocate_func) {
+        std::vector<void*> blocks(BATCH);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t round = 0; round < rounds; ++round) {
+            for (auto& block : blocks) {
+                block = allocate_func(size);
+                // 每一页都写一次，把缺页的开销也算进去
+                for (size_t offset = 0; offset < size; offset += 4096) {
+                    static_cast<volatile char*>(block)[offset] = 1;
+                }
+            }
+            for (auto block : blocks) {
+                deallocate_func(block, size);
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / (rounds * BATCH);
+    };
+
+    for (size_t size = MIN_SWEEP_SIZE; size <= MAX_SWEEP_SIZE; size *= 2) {
+        // 在2的幂次之间再插入一个1.5倍的尺寸，覆盖不是整页对齐好的大小
+        for (size_t current : {size, size + size / 2}) {
+            if (current > MAX_SWEEP_SIZE) {
+                break;
+            }
+            size_t rounds = std::max<size_t>(BYTES_PER_SIZE / (current * BATCH), 4);
+            double pool_ns = run(current, rounds,
+                                 [](size_t s) { return memory_pool::memory_pool::allocate(s).value(); },
+                                 [](void* p, size_t s) { memory_pool::memory_pool::deallocate(p, s); });
+            double malloc_ns = run(current, rounds,
+                                   [](size_t s) { return malloc(s); },
+                                   [](void* p, size_t) { free(p); });
+            std::cout << std::left << std::setw(15) << (std::to_string(current / 1024) + " KB")
+                      << std::right << std::setw(20) << std::fixed << std::setprecision(2) << pool_ns
+                      << std::setw(20) << malloc_ns
+                      << std::setw(15) << (malloc_ns > 0 ? pool_ns / malloc_ns : 0.0) << "x\n";
+        }
+    }
+}
+
 int main() {
     std::cout << "\n=== Memory Allocator Benchmark ===\n"
               << "Duration: 30 seconds\n"
@@ -412,5 +467,7 @@ int main() {
                          pool_stats.success_frees,
                          malloc_stats.success_frees);
 
+    run_large_size_sweep();
+
     return 0;
 } 
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "memory_pool/memory_pool.h"
+
+// 模拟每个连接一个计数器的场景：多个线程同时申请小对象，然后反复写自己的对象
+// 如果不同线程的对象落在同一个缓存行上，写操作会让缓存行在核之间来回传递（伪共享）
+// 同一份代码编译成两个程序，一个使用默认的内存池，一个开启了 MEMORY_POOL_CACHE_LINE_ISOLATION
+
+const size_t OBJECTS_PER_ROUND = 16;       // 每个线程每一轮申请的对象个数
+const size_t NUM_ROUNDS = 2000;            // 每个线程的轮数
+const size_t WRITES_PER_OBJECT = 1000;     // 每一轮对每个对象写的次数
+const unsigned int NUM_RUNS = 3;           // 运行次数
+
+// 所有线程跑完需要的时间 (ms)
+double run_scratch(unsigned int thread_count, size_t object_size) {
+    std::atomic<unsigned int> ready{0};
+    std::atomic<bool> start{false};
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&] {
+            ready.fetch_add(1);
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            std::vector<void*> objects(OBJECTS_PER_ROUND);
+            for (size_t round = 0; round < NUM_ROUNDS; ++round) {
+                for (auto& object : objects) {
+                    object = memory_pool::memory_pool::allocate(object_size).value();
+                }
+                for (size_t i = 0; i < WRITES_PER_OBJECT; ++i) {
+                    for (void* object : objects) {
+                        // volatile 保证每一次写都真正落到内存上
+                        volatile size_t* counter = static_cast<size_t*>(object);
+                        *counter = *counter + 1;
+                    }
+                }
+                for (void* object : objects) {
+                    memory_pool::memory_pool::deallocate(object, object_size);
+                }
+            }
+        });
+    }
+    while (ready.load() != thread_count) {
+        std::this_thread::yield();
+    }
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+int main() {
+#ifdef MEMORY_POOL_CACHE_LINE_ISOLATION
+    const char* mode = "cache-line isolation";
+#else
+    const char* mode = "default";
+#endif
+    const unsigned int thread_count = std::max(2u, std::thread::hardware_concurrency());
+    std::cout << "\n=== Cache Scratch Benchmark ===\n"
+              << "Mode: " << mode << "\n"
+              << "Threads: " << thread_count << "\n"
+              << "Objects per round: " << OBJECTS_PER_ROUND << ", rounds: " << NUM_ROUNDS
+              << ", writes per object: " << WRITES_PER_OBJECT << "\n"
+              << "Number of runs: " << NUM_RUNS << "\n\n";
+
+    std::cout << std::left << std::setw(20) << "Object size (B)"
+              << std::right << std::setw(15) << "Time (ms)" << "\n";
+    std::cout << std::string(35, '-') << "\n";
+    for (size_t object_size : {8, 24, 40, 72, 100}) {
+        double total_ms = 0;
+        for (unsigned int run = 0; run < NUM_RUNS; ++run) {
+            total_ms += run_scratch(thread_count, object_size);
+        }
+        std::cout << std::left << std::setw(20) << object_size
+                  << std::right << std::setw(15) << std::fixed << std::setprecision(2) << total_ms / NUM_RUNS << "\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "memory_pool/memory_pool.h"
+
+// 慢路径事件记录的开销
+// 同样的工作量先在不记录时运行一次，再开始记录运行一次，最后把事件写成Chrome的trace_event JSON
+// 同一份代码编译成两个程序，一个没有编译进事件记录，一个定义了 MEMORY_POOL_EVENT_TRACE
+
+const size_t NUM_THREADS = 4;                  // 工作线程数
+const size_t OPERATIONS_PER_THREAD = 2000000;  // 每个线程的申请次数
+const size_t LIVE_OBJECTS = 4096;              // 每个线程同时持有的对象个数
+const size_t MAX_OBJECT_SIZE = 1024;           // 小对象的最大大小
+const size_t LARGE_OBJECT_INTERVAL = 1000;     // 每隔多少次申请一个大块内存
+const size_t LARGE_OBJECT_SIZE = 256 * 1024;   // 大块内存的大小
+const unsigned int RANDOM_SEED = 54321;        // 固定的随机种子，确保每次运行结果可复现
+const char* TRACE_PATH = "memory_pool_trace.json";
+
+// 所有工作线程跑完需要的时间 (ms)
+double run_workers() {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < NUM_THREADS; ++t) {
+        threads.emplace_back([t] {
+            std::mt19937 rng(RANDOM_SEED + t);
+            std::vector<std::pair<void*, size_t>> objects(LIVE_OBJECTS, {nullptr, 0});
+            for (size_t i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+                auto& [object, size] = objects[rng() % LIVE_OBJECTS];
+                memory_pool::memory_pool::deallocate(object, size);
+                size = i % LARGE_OBJECT_INTERVAL == 0 ? LARGE_OBJECT_SIZE : rng() % MAX_OBJECT_SIZE + 1;
+                object = memory_pool::memory_pool::allocate(size).value();
+            }
+            for (auto& [object, size] : objects) {
+                memory_pool::memory_pool::deallocate(object, size);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main() {
+    std::cout << "\n=== Event Trace Benchmark ===\n"
+              << "Threads: " << NUM_THREADS << ", operations per thread: " << OPERATIONS_PER_THREAD << "\n"
+#ifdef MEMORY_POOL_EVENT_TRACE
+              << "Event tracer: compiled in\n\n";
+#else
+              << "Event tracer: compiled out\n\n";
+#endif
+
+    // 先跑一遍，让各层都准备好内存
+    run_workers();
+    const double off_ms = run_workers();
+
+    const bool started = memory_pool::memory_pool::start_event_trace();
+    const double on_ms = run_workers();
+    memory_pool::memory_pool::stop_event_trace();
+
+    std::cout << std::left << std::fixed << std::setprecision(2)
+              << std::setw(35) << "Workers, tracer off (ms)" << off_ms << "\n";
+    if (!started) {
+        std::cout << "Tracer not compiled in (build with MEMORY_POOL_EVENT_TRACE)\n";
+        return 0;
+    }
+    std::cout << std::setw(35) << "Workers, tracer on (ms)" << on_ms << "\n";
+
+    if (memory_pool::memory_pool::write_event_trace(TRACE_PATH)) {
+        // 每个事件一行，按名字统计个数
+        std::ifstream input(TRACE_PATH);
+        std::string line;
+        std::vector<std::pair<std::string, size_t>> counts;
+        while (std::getline(input, line)) {
+            const size_t begin = line.find("\"name\":\"");
+            if (begin == std::string::npos) {
+                continue;
+            }
+            const std::string name = line.substr(begin + 8, line.find('"', begin + 8) - begin - 8);
+            auto it = std::find_if(counts.begin(), counts.end(), [&](const auto& count) { return count.first == name; });
+            if (it == counts.end()) {
+                counts.emplace_back(name, 1);
+            } else {
+                it->second++;
+            }
+        }
+        std::cout << "\nEvents written to " << TRACE_PATH << " (open in chrome://tracing or ui.perfetto.dev)\n";
+        for (const auto& [name, count] : counts) {
+            std::cout << "  " << std::setw(33) << name << count << "\n";
+        }
+    }
+    return 0;
+}
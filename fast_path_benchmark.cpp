@@ -0,0 +1,85 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "memory_pool/memory_pool.h"
+
+// 测量线程缓存命中时，一次申请加一次释放需要的CPU周期数
+// 对比返回 std::optional 的接口和不抛出异常、返回裸指针的接口
+
+const size_t NUM_PAIRS = 10000000;      // 每种大小申请释放的次数
+const size_t BATCH_SIZE = 64;           // 每一批同时持有的内存块个数，保证每次都能命中线程缓存
+const unsigned int NUM_RUNS = 3;        // 运行次数
+
+// 当前的时间戳，x86上使用rdtsc得到周期数，其他平台使用纳秒代替
+inline uint64_t read_timestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// 返回每一对申请和释放平均需要的周期数
+template <typename Allocate, typename Deallocate>
+double run_pairs(size_t size, Allocate allocate, Deallocate deallocate) {
+    std::vector<void*> blocks(BATCH_SIZE);
+    // 先把线程缓存填满，测量时只走快速路径
+    for (auto& block : blocks) {
+        block = allocate(size);
+    }
+    for (auto block : blocks) {
+        deallocate(block, size);
+    }
+    uint64_t start = read_timestamp();
+    for (size_t i = 0; i < NUM_PAIRS / BATCH_SIZE; ++i) {
+        for (auto& block : blocks) {
+            block = allocate(size);
+        }
+        for (auto block : blocks) {
+            deallocate(block, size);
+        }
+    }
+    uint64_t end = read_timestamp();
+    return static_cast<double>(end - start) / (NUM_PAIRS / BATCH_SIZE * BATCH_SIZE);
+}
+
+int main() {
+#if defined(__x86_64__) || defined(__i386__)
+    const char* unit = "cycles";
+#else
+    const char* unit = "ns";
+#endif
+    std::cout << "\n=== Fast Path Benchmark ===\n"
+              << "Pairs per size: " << NUM_PAIRS << ", batch size: " << BATCH_SIZE << "\n"
+              << "Number of runs: " << NUM_RUNS << "\n\n";
+
+    std::cout << std::left << std::setw(15) << "Size (B)"
+              << std::right << std::setw(25) << std::string("optional (") + unit + "/pair)"
+              << std::setw(25) << std::string("raw (") + unit + "/pair)" << "\n";
+    std::cout << std::string(65, '-') << "\n";
+    for (size_t size : {8, 16, 64, 256, 1024, 8192}) {
+        double optional_cycles = 0, raw_cycles = 0;
+        for (unsigned int run = 0; run < NUM_RUNS; ++run) {
+            optional_cycles += run_pairs(
+                size, [](size_t n) { return memory_pool::memory_pool::allocate(n).value(); },
+                [](void* p, size_t n) { memory_pool::memory_pool::deallocate(p, n); });
+            raw_cycles += run_pairs(
+                size, [](size_t n) { return memory_pool::memory_pool::allocate_raw(n); },
+                [](void* p, size_t n) { memory_pool::memory_pool::deallocate_raw(p, n); });
+        }
+        std::cout << std::left << std::setw(15) << size
+                  << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(25) << optional_cycles / NUM_RUNS
+                  << std::setw(25) << raw_cycles / NUM_RUNS << "\n";
+    }
+
+    return 0;
+}
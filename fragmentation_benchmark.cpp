@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "memory_pool/memory_pool.h"
+
+// 碎片报告
+// 先申请大量小对象和大块内存，再随机释放其中的大部分，留下几乎是空的span和零散的空闲页面，
+// 然后在一个线程持续申请释放的同时生成碎片报告，对比这个线程在有报告和没有报告时最慢的一次操作
+
+const size_t NUM_OBJECTS = 300000;            // 小对象的个数
+const size_t OBJECT_SIZES[] = {48, 256, 1024}; // 小对象的大小
+const size_t NUM_LARGE_BLOCKS = 400;          // 大块内存的个数
+const size_t LARGE_BLOCK_PAGES = 24;          // 大块内存的最大页数
+const double KEEP_RATIO = 0.1;                // 保留的小对象的比例
+const size_t WORKER_OPERATIONS = 2000000;     // 工作线程申请释放的次数
+const unsigned int RANDOM_SEED = 54321;       // 固定的随机种子，确保每次运行结果可复现
+
+// 工作线程申请释放，直到stop为true并且至少做了WORKER_OPERATIONS次，返回最慢的一次 (us)
+double run_worker(const std::atomic<bool>& stop) {
+    std::mt19937 rng(RANDOM_SEED + 1);
+    std::vector<void*> objects(256, nullptr);
+    double slowest_us = 0;
+    for (size_t i = 0; i < WORKER_OPERATIONS || !stop.load(std::memory_order_relaxed); ++i) {
+        void*& object = objects[rng() % objects.size()];
+        auto start = std::chrono::steady_clock::now();
+        memory_pool::memory_pool::deallocate(object, 128);
+        object = memory_pool::memory_pool::allocate(128).value();
+        auto end = std::chrono::steady_clock::now();
+        slowest_us = std::max(slowest_us, std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    for (void* object : objects) {
+        memory_pool::memory_pool::deallocate(object, 128);
+    }
+    return slowest_us;
+}
+
+int main() {
+    std::cout << "\n=== Fragmentation Report Benchmark ===\n"
+              << "Objects: " << NUM_OBJECTS << ", kept: " << KEEP_RATIO * 100 << "%, large blocks: "
+              << NUM_LARGE_BLOCKS << "\n\n";
+
+    // 小对象和大块内存交错申请，让大块内存释放以后在页缓存中留下零散的空闲页面
+    std::mt19937 rng(RANDOM_SEED);
+    std::vector<std::pair<void*, size_t>> objects;
+    std::vector<std::pair<void*, size_t>> large_blocks;
+    for (size_t i = 0; i < NUM_OBJECTS; ++i) {
+        const size_t size = OBJECT_SIZES[rng() % std::size(OBJECT_SIZES)];
+        objects.emplace_back(memory_pool::memory_pool::allocate(size).value(), size);
+        if (i % (NUM_OBJECTS / NUM_LARGE_BLOCKS) == 0) {
+            const size_t large_size = (rng() % LARGE_BLOCK_PAGES + 5) * 4096;
+            large_blocks.emplace_back(memory_pool::memory_pool::allocate(large_size).value(), large_size);
+        }
+    }
+    std::shuffle(objects.begin(), objects.end(), rng);
+    const size_t kept = static_cast<size_t>(objects.size() * KEEP_RATIO);
+    for (size_t i = kept; i < objects.size(); ++i) {
+        memory_pool::memory_pool::deallocate(objects[i].first, objects[i].second);
+    }
+    objects.resize(kept);
+    for (size_t i = 0; i < large_blocks.size(); i += 2) {
+        memory_pool::memory_pool::deallocate(large_blocks[i].first, large_blocks[i].second);
+    }
+
+    // 没有报告时工作线程最慢的一次
+    std::atomic<bool> stop{true};
+    const double quiet_us = run_worker(stop);
+
+    stop.store(false);
+    double observed_us = 0;
+    std::thread worker([&] { observed_us = run_worker(stop); });
+    auto start = std::chrono::steady_clock::now();
+    memory_pool::fragmentation_report report = memory_pool::memory_pool::fragmentation();
+    auto end = std::chrono::steady_clock::now();
+    stop.store(true);
+    worker.join();
+
+    std::cout << memory_pool::format_fragmentation(report) << "\n"
+              << std::left << std::fixed << std::setprecision(2)
+              << std::setw(40) << "Report time (ms)" << std::chrono::duration<double, std::milli>(end - start).count()
+              << "\n"
+              << std::setw(40) << "Slowest worker op without report (us)" << quiet_us << "\n"
+              << std::setw(40) << "Slowest worker op with report (us)" << observed_us << "\n"
+              << std::setw(40) << "Fragmentation ratio (stats)" << memory_pool::memory_pool::stats().fragmentation_ratio
+              << "\n";
+
+    for (auto [object, size] : objects) {
+        memory_pool::memory_pool::deallocate(object, size);
+    }
+    for (size_t i = 1; i < large_blocks.size(); i += 2) {
+        memory_pool::memory_pool::deallocate(large_blocks[i].first, large_blocks[i].second);
+    }
+    return 0;
+}
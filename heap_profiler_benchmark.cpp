@@ -0,0 +1,116 @@
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "memory_pool/memory_pool.h"
+
+// 采样的堆分析的开销和准确度
+// 同样的工作量分别在关闭采样和开启采样（默认间隔）时运行，对比每次申请加释放的耗时
+// 工作中有两个调用点长期持有内存（会话和缓存），其他的申请马上释放
+// 最后写出pprof格式的堆分析，按采样估计还在使用的字节数，和实际持有的字节数对比
+
+const size_t NUM_OPERATIONS = 20000000;   // 临时对象申请释放的次数
+const size_t NUM_SESSIONS = 20000;        // 长期持有的会话个数
+const size_t SESSION_SIZE = 256;          // 会话的大小
+const size_t NUM_CACHE_ENTRIES = 2000;    // 长期持有的缓存项个数
+const size_t CACHE_ENTRY_SIZE = 64 * 1024; // 缓存项的大小（大块内存）
+const size_t MAX_TEMPORARY_SIZE = 512;    // 临时对象的最大大小
+const unsigned int RANDOM_SEED = 54321;   // 固定的随机种子，确保每次运行结果可复现
+const char* PROFILE_PATH = "memory_pool_heap.prof";
+
+// 不内联，让每个调用点在调用栈中都能看到
+__attribute__((noinline)) void* create_session() {
+    return memory_pool::memory_pool::allocate(SESSION_SIZE).value();
+}
+
+__attribute__((noinline)) void* create_cache_entry() {
+    return memory_pool::memory_pool::allocate(CACHE_ENTRY_SIZE).value();
+}
+
+// 申请并马上释放临时对象，返回每一对申请和释放的平均纳秒数
+__attribute__((noinline)) double run_temporaries() {
+    std::mt19937 rng(RANDOM_SEED);
+    std::vector<size_t> sizes(4096);
+    for (auto& size : sizes) {
+        size = rng() % MAX_TEMPORARY_SIZE + 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < NUM_OPERATIONS; ++i) {
+        const size_t size = sizes[i % sizes.size()];
+        void* object = memory_pool::memory_pool::allocate_raw(size);
+        memory_pool::memory_pool::deallocate_raw(object, size);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / NUM_OPERATIONS;
+}
+
+// 按照pprof的方法把采样还原成还在使用的字节数的估计：每一个调用栈乘以 1 / (1 - exp(-平均大小 / 间隔))
+double estimate_in_use_bytes(const std::string& path) {
+    std::ifstream input(path);
+    std::string line;
+    if (!std::getline(input, line)) {
+        return 0;
+    }
+    const double period = std::stod(line.substr(line.find("heap_v2/") + 8));
+    double estimate = 0;
+    while (std::getline(input, line) && !line.empty()) {
+        std::istringstream fields(line);
+        double count = 0, bytes = 0;
+        char colon = 0;
+        fields >> count >> colon >> bytes;
+        if (count > 0) {
+            estimate += bytes / (1 - std::exp(-bytes / count / period));
+        }
+    }
+    return estimate;
+}
+
+int main() {
+    std::cout << "\n=== Heap Profiler Benchmark ===\n"
+              << "Temporary allocations: " << NUM_OPERATIONS << " (1-" << MAX_TEMPORARY_SIZE << " B)\n"
+              << "Sample period: " << memory_pool::heap_profiler::DEFAULT_SAMPLE_PERIOD << " B\n\n";
+
+    // 先跑一次预热线程缓存
+    run_temporaries();
+    const double off_ns = run_temporaries();
+
+    memory_pool::memory_pool::start_heap_profiler();
+    std::vector<void*> sessions;
+    std::vector<void*> cache_entries;
+    for (size_t i = 0; i < NUM_SESSIONS; ++i) {
+        sessions.push_back(create_session());
+    }
+    for (size_t i = 0; i < NUM_CACHE_ENTRIES; ++i) {
+        cache_entries.push_back(create_cache_entry());
+    }
+    const double on_ns = run_temporaries();
+    const bool written = memory_pool::memory_pool::write_heap_profile(PROFILE_PATH);
+    memory_pool::memory_pool::stop_heap_profiler();
+
+    const double actual_bytes = static_cast<double>(NUM_SESSIONS * SESSION_SIZE + NUM_CACHE_ENTRIES * CACHE_ENTRY_SIZE);
+    const double estimated_bytes = estimate_in_use_bytes(PROFILE_PATH);
+
+    std::cout << std::left << std::fixed << std::setprecision(2)
+              << std::setw(40) << "Allocate+free, sampling off (ns)" << off_ns << "\n"
+              << std::setw(40) << "Allocate+free, sampling on (ns)" << on_ns << "\n"
+              << std::setw(40) << "Actual in-use bytes (MB)" << actual_bytes / 1024 / 1024 << "\n"
+              << std::setw(40) << "Estimated in-use bytes (MB)" << estimated_bytes / 1024 / 1024 << "\n\n";
+    if (written) {
+        std::cout << "Heap profile written to " << PROFILE_PATH << " (view with: pprof <binary> " << PROFILE_PATH
+                  << ")\n";
+    }
+
+    for (void* session : sessions) {
+        memory_pool::memory_pool::deallocate(session, SESSION_SIZE);
+    }
+    for (void* entry : cache_entries) {
+        memory_pool::memory_pool::deallocate(entry, CACHE_ENTRY_SIZE);
+    }
+    return 0;
+}
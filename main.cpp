@@ -1,7 +1,9 @@
 #include <iostream>
 #include <vector>
 
+#include "memory_pool/heap.h"
 #include "memory_pool/memory_pool.h"
+#include "memory_pool/object_pool.h"
 
 struct MyData {
     int id;
@@ -10,26 +12,19 @@ struct MyData {
 };
 
 int main() {
-    // 分配内存
-    size_t size_to_alloc = sizeof(MyData);
-    std::optional<void*> mem_opt = memory_pool::memory_pool::allocate(size_to_alloc);
-
-    if (mem_opt) {
-        void* mem = *mem_opt;
-        std::cout << "Allocated " << size_to_alloc << " bytes at " << mem << std::endl;
-
-        // 使用内存 (Placement new)
-        MyData* data_ptr = new (mem) MyData{1, 3.14, "Hello"};
+    // 使用对象池创建对象，大小在编译期确定，不需要手动placement new
+    memory_pool::object_pool<MyData> data_pool;
+    // 预先准备好一些内存块，之后的创建不会再走慢路径
+    data_pool.reserve(16);
+    try {
+        MyData* data_ptr = data_pool.create(MyData{1, 3.14, "Hello"});
+        std::cout << "Created MyData (" << sizeof(MyData) << " bytes) at " << data_ptr << std::endl;
         std::cout << "Data ID: " << data_ptr->id << ", Value: " << data_ptr->value << std::endl;
 
-        // 使用完需要显式调用析构函数 (如果对象有非平凡析构)
-        data_ptr->~MyData();
-
-        // 归还内存
-        memory_pool::memory_pool::deallocate(mem, size_to_alloc);
-        std::cout << "Deallocated memory at " << mem << std::endl;
-
-    } else {
+        // 析构并归还内存
+        data_pool.destroy(data_ptr);
+        std::cout << "Destroyed MyData at " << data_ptr << std::endl;
+    } catch (const std::bad_alloc&) {
         std::cerr << "Memory allocation failed!" << std::endl;
     }
 
@@ -44,6 +39,28 @@ int main() {
         std::cout << "Deallocated large memory at " << large_mem << std::endl;
     }
 
+    // 分配按缓存行对齐的内存
+    size_t aligned_size = 100;
+    size_t alignment = 64;
+    std::optional<void*> aligned_mem_opt = memory_pool::memory_pool::allocate_aligned(aligned_size, alignment);
+    if (aligned_mem_opt) {
+        void* aligned_mem = *aligned_mem_opt;
+        std::cout << "Allocated " << aligned_size << " bytes aligned to " << alignment << " at " << aligned_mem << std::endl;
+        // 大小和对齐都要和申请时一样
+        memory_pool::memory_pool::deallocate_aligned(aligned_mem, aligned_size, alignment);
+        std::cout << "Deallocated aligned memory at " << aligned_mem << std::endl;
+    }
+
+    // 每个租户使用一个独立的堆，租户结束时整个堆一次释放，不需要逐个归还
+    {
+        memory_pool::heap tenant_heap;
+        std::vector<void*> tenant_blocks;
+        for (size_t i = 0; i < 100; ++i) {
+            tenant_blocks.push_back(tenant_heap.allocate(64 + i).value());
+        }
+        std::cout << "Allocated " << tenant_blocks.size() << " blocks from a tenant heap" << std::endl;
+    }
+    std::cout << "Destroyed the tenant heap" << std::endl;
 
     // 注意：内存池对象通常是单例，在程序结束时会自动清理（归还向系统申请的内存）
     // page_cache 的析构函数会调用 stop() 来释放 page_vector 中的内存
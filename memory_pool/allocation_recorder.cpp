@@ -0,0 +1,205 @@
+#include "allocation_recorder.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "latency.h"
+#include "metadata_allocator.h"
+
+namespace memory_pool {
+    namespace {
+        // 写入全部的字节，被信号打断或者只写了一部分时继续写
+        bool write_all(int fd, const void* data, size_t size, uint64_t offset) noexcept {
+            const std::byte* bytes = static_cast<const std::byte*>(data);
+            while (size > 0) {
+                const ssize_t written = ::pwrite(fd, bytes, size, static_cast<off_t>(offset));
+                if (written < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (written <= 0) {
+                    return false;
+                }
+                bytes += written;
+                size -= written;
+                offset += written;
+            }
+            return true;
+        }
+    }
+
+    bool allocation_recorder::start(const std::string& path) {
+#ifdef MEMORY_POOL_ALLOCATION_TRACE
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_fd >= 0) {
+            return false;
+        }
+        const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        m_fd = fd;
+        m_start_ticks = latency_recorder::now();
+        m_offset.store(sizeof(allocation_trace_header), std::memory_order_relaxed);
+        m_write_failed.store(false, std::memory_order_relaxed);
+        if (!write_header()) {
+            ::close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+        // 记录的线程在自己的锁中再读一次s_enabled，读到true时一定能看到上面打开的文件
+        s_enabled.store(true, std::memory_order_release);
+        return true;
+#else
+        (void)path;
+        return false;
+#endif
+    }
+
+    bool allocation_recorder::stop() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_fd < 0) {
+            return false;
+        }
+        s_enabled.store(false, std::memory_order_relaxed);
+        // 拿到每个缓冲区的锁以后，之后再加锁的线程一定能看到停止了，不会再往缓冲区中写
+        for (thread_buffer* buffer = m_threads.load(std::memory_order_acquire); buffer != nullptr;
+             buffer = buffer->next) {
+            while (buffer->lock.test_and_set(std::memory_order_acquire)) {
+            }
+            flush_buffer(*buffer);
+            buffer->lock.clear(std::memory_order_release);
+        }
+        // 记录的时间更长了，重新估计的换算比例更准确
+        const bool succeed = write_header() && !m_write_failed.load(std::memory_order_relaxed);
+        ::close(m_fd);
+        m_fd = -1;
+        return succeed;
+    }
+
+    void allocation_recorder::record(allocation_op op, const void* address, size_t size) noexcept {
+        const uint64_t ticks = latency_recorder::now();
+        thread_buffer* buffer = local_buffer();
+        if (buffer == nullptr) {
+            return;
+        }
+        while (buffer->lock.test_and_set(std::memory_order_acquire)) {
+        }
+        // 在检查enabled和加锁之间可能已经停止了
+        if (s_enabled.load(std::memory_order_acquire)) {
+            buffer->records[buffer->count++] = {ticks, reinterpret_cast<uint64_t>(address),
+                                                allocation_record::pack(op, buffer->thread, size)};
+            if (buffer->count == BUFFER_RECORDS) {
+                flush_buffer(*buffer);
+            }
+        }
+        buffer->lock.clear(std::memory_order_release);
+    }
+
+    void allocation_recorder::after_fork_child() noexcept {
+        m_mutex.unlock();
+        s_enabled.store(false, std::memory_order_relaxed);
+        // fork时其他线程可能正持有自己缓冲区的锁，子进程中这些线程已经不存在了
+        for (thread_buffer* buffer = m_threads.load(std::memory_order_relaxed); buffer != nullptr;
+             buffer = buffer->next) {
+            buffer->count = 0;
+            buffer->lock.clear(std::memory_order_relaxed);
+        }
+        if (m_fd >= 0) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    allocation_recorder::thread_buffer* allocation_recorder::local_buffer() noexcept {
+        static thread_local thread_buffer* local_buffer = nullptr;
+        if (local_buffer != nullptr) {
+            return local_buffer;
+        }
+        // 直接向元数据分配器申请，不会回到内存池，也不会在替换了malloc时递归
+        thread_buffer* buffer = nullptr;
+        try {
+            buffer = new (metadata_arena::GetInstance().allocate(sizeof(thread_buffer))) thread_buffer();
+        } catch (...) {
+            return nullptr;
+        }
+        buffer->thread = m_thread_count.fetch_add(1, std::memory_order_relaxed);
+        buffer->next = m_threads.load(std::memory_order_relaxed);
+        while (!m_threads.compare_exchange_weak(buffer->next, buffer, std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+        }
+        local_buffer = buffer;
+        return buffer;
+    }
+
+    void allocation_recorder::flush_buffer(thread_buffer& buffer) noexcept {
+        if (buffer.count == 0) {
+            return;
+        }
+        const size_t bytes = buffer.count * sizeof(allocation_record);
+        const uint64_t offset = m_offset.fetch_add(bytes, std::memory_order_relaxed);
+        if (!write_all(m_fd, buffer.records.data(), bytes, offset)) {
+            m_write_failed.store(true, std::memory_order_relaxed);
+        }
+        buffer.count = 0;
+    }
+
+    bool allocation_recorder::write_header() noexcept {
+        allocation_trace_header header;
+        header.record_size = sizeof(allocation_record);
+        header.start_ticks = m_start_ticks;
+        header.ticks_per_ns = latency_recorder::GetInstance().ticks_per_ns();
+        return write_all(m_fd, &header, sizeof(header), 0);
+    }
+
+    std::optional<allocation_trace> load_allocation_trace(const std::string& path) {
+        std::ifstream input(path, std::ios::binary);
+        allocation_trace_header header;
+        if (!input || !input.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            header.magic != allocation_trace_header::MAGIC || header.version != allocation_trace_header::VERSION ||
+            header.record_size != sizeof(allocation_record) || !(header.ticks_per_ns > 0)) {
+            return std::nullopt;
+        }
+        std::vector<allocation_record> records;
+        allocation_record record;
+        while (input.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+            records.push_back(record);
+        }
+        // 同一个线程的记录在文件中已经是先后顺序，时间戳相同时保持这个顺序
+        std::stable_sort(records.begin(), records.end(),
+                         [](const allocation_record& a, const allocation_record& b) { return a.ticks < b.ticks; });
+
+        allocation_trace trace;
+        trace.events.reserve(records.size());
+        std::unordered_map<uint32_t, uint32_t> threads;
+        // 还没有归还的地址对应的对象
+        std::unordered_map<uint64_t, uint64_t> live_objects;
+        for (const allocation_record& current : records) {
+            allocation_event event;
+            const int64_t elapsed = static_cast<int64_t>(current.ticks - header.start_ticks);
+            event.time_ns = elapsed > 0 ? static_cast<uint64_t>(elapsed / header.ticks_per_ns) : 0;
+            event.size = current.size();
+            event.op = current.op();
+            event.thread = threads.try_emplace(current.thread(), threads.size()).first->second;
+            if (event.op == allocation_op::allocate) {
+                // 地址还没有归还又被申请了，说明中间的归还没有记录到，原来的对象当作一直没有归还
+                event.object = trace.object_count++;
+                live_objects[current.address] = event.object;
+            } else {
+                auto it = live_objects.find(current.address);
+                if (it == live_objects.end()) {
+                    trace.unmatched_count++;
+                    continue;
+                }
+                event.object = it->second;
+                live_objects.erase(it);
+            }
+            trace.events.push_back(event);
+        }
+        trace.thread_count = threads.size();
+        return trace;
+    }
+} // memory_pool
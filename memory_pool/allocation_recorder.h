@@ -0,0 +1,188 @@
+#ifndef ALLOCATION_RECORDER_H
+#define ALLOCATION_RECORDER_H
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace memory_pool
+{
+
+    // 记录的操作
+    enum class allocation_op : uint8_t
+    {
+        allocate,
+        deallocate,
+    };
+
+    // 记录文件的开头，停止记录时会用更准确的换算比例重写一次
+    struct allocation_trace_header
+    {
+        static constexpr std::array<char, 8> MAGIC = {'M', 'P', 'A', 'L', 'L', 'O', 'C', '\0'};
+        static constexpr uint32_t VERSION = 1;
+
+        std::array<char, 8> magic = MAGIC;
+        uint32_t version = VERSION;
+        uint32_t record_size = 0;
+        // 开始记录时的时间戳，和每纳秒的周期数一起把记录中的时间戳换算成纳秒
+        uint64_t start_ticks = 0;
+        double ticks_per_ns = 0;
+    };
+
+    // 文件中的一条记录，24个字节
+    // 各个线程的记录按写满缓冲区的先后交错排列，读取时按时间戳重新排序
+    struct allocation_record
+    {
+        // latency_recorder::now()的时间戳
+        uint64_t ticks = 0;
+        // 对象的地址：申请的时间戳在申请返回以后读取，归还的时间戳在归还开始之前读取，
+        // 所以按时间戳排序以后同一个地址的先后几次使用不会重叠，地址可以作为对象的标识
+        uint64_t address = 0;
+        // 低8位为操作，之后16位为线程的序号（按第一次记录的先后编号），高40位为申请或归还时传入的大小
+        uint64_t info = 0;
+
+        static constexpr uint64_t pack(allocation_op op, uint32_t thread, uint64_t size)
+        {
+            return static_cast<uint64_t>(op) | (static_cast<uint64_t>(thread & 0xffff) << 8) | (size << 24);
+        }
+        allocation_op op() const { return static_cast<allocation_op>(info & 0xff); }
+        uint32_t thread() const { return static_cast<uint32_t>((info >> 8) & 0xffff); }
+        uint64_t size() const { return info >> 24; }
+    };
+
+    // 读取以后的一次操作
+    struct allocation_event
+    {
+        // 距离开始记录的纳秒数
+        uint64_t time_ns = 0;
+        // 对象的序号，从0开始连续编号，同一个对象的申请和归还相同
+        uint64_t object = 0;
+        uint64_t size = 0;
+        // 线程的序号，从0开始连续编号
+        uint32_t thread = 0;
+        allocation_op op = allocation_op::allocate;
+    };
+
+    // 读取以后的记录，按时间排列
+    struct allocation_trace
+    {
+        std::vector<allocation_event> events;
+        size_t object_count = 0;
+        size_t thread_count = 0;
+        // 对象在开始记录之前申请、只记录到了归还的次数，这些归还不在events中
+        size_t unmatched_count = 0;
+    };
+
+    // 记录每一次申请和归还，给回放工具在离线时重新执行
+    // 每个线程先写到自己的缓冲区中，写满以后用pwrite追加到文件，各个线程用原子变量分配文件中的位置，不需要全局的锁
+    // 缓冲区有一个自旋锁，平时只有拥有的线程会加锁，只在停止记录时和写出剩下的记录的线程争用
+    // 只有定义了MEMORY_POOL_ALLOCATION_TRACE时记录的代码才会编译进来，否则record_allocate和record_deallocate什么也不做
+    // 编译进来以后默认不记录，调用start以后才开始，没有开始时每一次申请和归还只多读一个原子变量
+    // 只记录大小，不记录对齐；大块内存原地调整大小记录为归还原来的大小再申请新的大小
+    class allocation_recorder
+    {
+    public:
+        // 每个线程的缓冲区能保存的记录个数
+        static constexpr size_t BUFFER_RECORDS = 4096;
+
+        static allocation_recorder &GetInstance()
+        {
+#ifdef MEMORY_POOL_NO_DESTROY
+            alignas(allocation_recorder) static std::byte storage[sizeof(allocation_recorder)];
+            static allocation_recorder *instance = new (storage) allocation_recorder();
+            return *instance;
+#else
+            static allocation_recorder instance;
+            return instance;
+#endif
+        }
+
+        // 开始记录，写到path中，文件已经存在时会被覆盖
+        // 返回值：是否开始成功，没有定义MEMORY_POOL_ALLOCATION_TRACE、已经在记录或者打不开文件时返回false
+        bool start(const std::string &path);
+
+        // 停止记录，把所有线程缓冲区中剩下的记录写出并关闭文件
+        // 返回值：是否所有的记录都写入成功，没有在记录时返回false
+        bool stop();
+
+        // 是否正在记录
+        static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+        // 记录一次操作，写到当前线程的缓冲区中
+        void record(allocation_op op, const void *address, size_t size) noexcept;
+
+        // fork前后调用，子进程不继续记录，也不会写父进程的文件
+        void prepare_fork() { m_mutex.lock(); }
+        void after_fork() { m_mutex.unlock(); }
+        void after_fork_child() noexcept;
+
+    private:
+        allocation_recorder() = default;
+
+        // 一个线程的缓冲区，线程退出以后仍然保留，剩下的记录在停止时写出
+        struct thread_buffer
+        {
+            std::array<allocation_record, BUFFER_RECORDS> records;
+            size_t count = 0;
+            std::atomic_flag lock;
+            uint32_t thread = 0;
+            thread_buffer *next = nullptr;
+        };
+
+        // 当前线程的缓冲区，第一次记录时创建，申请失败时返回nullptr
+        thread_buffer *local_buffer() noexcept;
+
+        // 把缓冲区中的记录追加到文件中，调用时持有缓冲区的锁
+        void flush_buffer(thread_buffer &buffer) noexcept;
+
+        // 写入文件的开头
+        bool write_header() noexcept;
+
+        static inline std::atomic<bool> s_enabled = false;
+        std::atomic<thread_buffer *> m_threads = nullptr;
+        std::atomic<uint32_t> m_thread_count = 0;
+        // 正在写入的文件，在开始记录之前打开，在停止记录、所有缓冲区都写出以后关闭
+        int m_fd = -1;
+        uint64_t m_start_ticks = 0;
+        // 下一批记录在文件中的位置
+        std::atomic<uint64_t> m_offset = 0;
+        std::atomic<bool> m_write_failed = false;
+        // 保证开始和停止不会同时进行
+        std::mutex m_mutex;
+    };
+
+    // 读取记录文件，按时间排序并给对象和线程重新编号，文件不完整时丢掉最后不完整的一条
+    // 返回值：文件不存在或者格式不对时返回nullopt
+    std::optional<allocation_trace> load_allocation_trace(const std::string &path);
+
+#ifdef MEMORY_POOL_ALLOCATION_TRACE
+    // 在申请返回以后记录，失败的申请不记录
+    inline void record_allocate(const void *address, size_t size) noexcept
+    {
+        if (allocation_recorder::enabled() && address != nullptr) [[unlikely]]
+        {
+            allocation_recorder::GetInstance().record(allocation_op::allocate, address, size);
+        }
+    }
+
+    // 在归还开始之前记录，nullptr不记录
+    inline void record_deallocate(const void *address, size_t size) noexcept
+    {
+        if (allocation_recorder::enabled() && address != nullptr) [[unlikely]]
+        {
+            allocation_recorder::GetInstance().record(allocation_op::deallocate, address, size);
+        }
+    }
+#else
+    inline void record_allocate(const void *, size_t) noexcept {}
+    inline void record_deallocate(const void *, size_t) noexcept {}
+#endif
+
+} // memory_pool
+
+#endif // ALLOCATION_RECORDER_H
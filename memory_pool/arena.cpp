@@ -0,0 +1,75 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <new>
+#include <span>
+
+#include "page_cache.h"
+
+namespace memory_pool {
+    arena::arena(size_t chunk_page_count) : m_chunk_page_count(std::max(chunk_page_count, size_t{1})) {}
+
+    arena::~arena() {
+        reset();
+    }
+
+    std::optional<void*> arena::allocate(size_t memory_size, size_t alignment) {
+        if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+            return std::nullopt;
+        }
+        memory_size = std::max(memory_size, size_t{1});
+        if (memory_size > SIZE_MAX - alignment - size_utils::PAGE_SIZE) {
+            return std::nullopt;
+        }
+        auto address = size_utils::align(reinterpret_cast<std::uintptr_t>(m_current), alignment);
+        if (m_current == nullptr || address + memory_size > reinterpret_cast<std::uintptr_t>(m_end)) {
+            // 当前块剩下的空间直接丢弃，新块按页对齐，最多浪费alignment - 1个字节
+            if (!add_chunk(memory_size + alignment - 1)) {
+                return std::nullopt;
+            }
+            address = size_utils::align(reinterpret_cast<std::uintptr_t>(m_current), alignment);
+        }
+        m_current = reinterpret_cast<std::byte*>(address) + memory_size;
+        return reinterpret_cast<void*>(address);
+    }
+
+    void arena::rewind(marker position) {
+        assert(position.chunk_count <= m_chunks.size());
+        if (position.chunk_count < m_chunks.size()) {
+            page_cache::GetInstance().deallocate_pages(std::span<const memory_span>(m_chunks).subspan(position.chunk_count));
+            m_chunks.erase(m_chunks.begin() + position.chunk_count, m_chunks.end());
+        }
+        if (m_chunks.empty()) {
+            m_current = nullptr;
+            m_end = nullptr;
+            return;
+        }
+        const memory_span& last = m_chunks.back();
+        assert(position.position >= last.data() && position.position <= last.data() + last.size());
+        m_current = position.position;
+        m_end = last.data() + last.size();
+    }
+
+    bool arena::add_chunk(size_t memory_size) {
+        const size_t page_count = std::max(m_chunk_page_count,
+                                           size_utils::align(memory_size, size_utils::PAGE_SIZE) / size_utils::PAGE_SIZE);
+        auto ret = page_cache::GetInstance().allocate_page(page_count);
+        if (!ret.has_value()) {
+            return false;
+        }
+        m_chunks.push_back(ret.value());
+        m_current = ret->data();
+        m_end = ret->data() + ret->size();
+        return true;
+    }
+
+    void* arena::arena_resource::do_allocate(size_t bytes, size_t alignment) {
+        auto ret = m_owner.allocate(bytes, alignment);
+        if (!ret.has_value()) {
+            throw std::bad_alloc();
+        }
+        return ret.value();
+    }
+} // memory_pool
@@ -0,0 +1,89 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+
+#include "metadata_allocator.h"
+#include "utils.h"
+
+namespace memory_pool
+{
+
+    // 区域分配器：从page_cache申请整块的页面，在里面顺序切分，单个对象不需要也不能单独释放
+    // 适合一次请求中创建、最后一起销毁的大量小对象，reset和析构时把所有页面一次还给page_cache
+    // 不是线程安全的，一个arena只能在一个线程中使用
+    class arena
+    {
+    public:
+        // 默认每一块申请的页数，64KB
+        static constexpr size_t DEFAULT_CHUNK_PAGE_COUNT = 16;
+
+        // 记录arena当前的位置，用于像栈一样回退
+        struct marker
+        {
+            // 当时已经申请的块数
+            size_t chunk_count = 0;
+            // 当时在最后一块中的位置
+            std::byte *position = nullptr;
+        };
+
+        explicit arena(size_t chunk_page_count = DEFAULT_CHUNK_PAGE_COUNT);
+        ~arena();
+
+        arena(const arena &) = delete;
+        arena &operator=(const arena &) = delete;
+
+        // 申请一块空间
+        // 参数：memory_size:大小 alignment:对齐，必须是2的幂
+        // 返回值：指向空间的指针，对齐不合法或申请失败时返回nullopt
+        std::optional<void *> allocate(size_t memory_size, size_t alignment = alignof(std::max_align_t));
+
+        // 保存当前的位置
+        marker save() const { return marker{m_chunks.size(), m_current}; }
+
+        // 回退到之前保存的位置，这之后申请的空间全部失效，多出来的块还给page_cache
+        void rewind(marker position);
+
+        // 释放所有的空间，所有的块一次还给page_cache
+        void reset() { rewind(marker{}); }
+
+        // 作为 std::pmr::memory_resource 使用，deallocate什么也不做，空间在reset时统一释放
+        std::pmr::memory_resource *resource() { return &m_resource; }
+
+    private:
+        class arena_resource : public std::pmr::memory_resource
+        {
+        public:
+            explicit arena_resource(arena &owner) : m_owner(owner) {}
+
+        protected:
+            void *do_allocate(size_t bytes, size_t alignment) override;
+
+            void do_deallocate(void *, size_t, size_t) override {}
+
+            bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+            {
+                return this == &other;
+            }
+
+        private:
+            arena &m_owner;
+        };
+
+        // 申请一个至少能放下memory_size字节的新块
+        bool add_chunk(size_t memory_size);
+
+        // 每一块的页数
+        const size_t m_chunk_page_count;
+        // 申请到的所有块
+        metadata_vector<memory_span> m_chunks = {};
+        // 最后一块中下一次分配的位置和结尾
+        std::byte *m_current = nullptr;
+        std::byte *m_end = nullptr;
+        arena_resource m_resource{*this};
+    };
+
+} // memory_pool
+
+#endif // ARENA_H
@@ -1,6 +1,7 @@
 // created by wei on 2025-5-26
 #include "central_cache.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <sys/mman.h>
@@ -8,10 +9,31 @@
 #include <iostream>
 #include <thread>
 
+#include "event_tracer.h"
 #include "page_cache.h"
+#include "page_map.h"
 #include "thread_cache.h"
 
 namespace memory_pool {
+    page_cache& central_cache::default_page_cache() {
+        return page_cache::GetInstance();
+    }
+
+    central_cache::~central_cache() {
+        for (auto& page_set : m_page_set) {
+            for (auto& [_, span] : page_set) {
+                page_map::GetInstance().clear(span.get_memory_span());
+            }
+        }
+        thread_cache_counters* counters = m_thread_counters.load(std::memory_order_acquire);
+        while (counters != nullptr) {
+            thread_cache_counters* next = counters->next;
+            counters->~thread_cache_counters();
+            metadata_arena::GetInstance().deallocate(counters, sizeof(thread_cache_counters));
+            counters = next;
+        }
+    }
+
     std::optional<std::byte*> central_cache::allocate(const size_t memory_size, const size_t block_count) {
         // 内存的传入应该一定是8的倍数
         assert(memory_size % 8 == 0);
@@ -23,7 +45,7 @@ namespace memory_pool {
         }
         //大内存，直接分配给page_cache管理
         if (memory_size > size_utils::MAX_CACHED_UNIT_SIZE) {
-            return page_cache::GetInstance().allocate_unit(memory_size).transform([this](memory_span memory) {
+            return m_page_cache.allocate_unit(memory_size).transform([this](memory_span memory) {
                 return memory.data();
             });
         }
@@ -32,89 +54,42 @@ namespace memory_pool {
         const size_t index = size_utils::get_index(memory_size);
         std::byte* result = nullptr;
         //给对应的桶加锁
-        atomic_flag_guard guard(m_status[index]);
-
-        try {
-            // 如果当前缓存的个数小于申请的块数，则向页分配器申请
-            if (m_free_array_size[index] < block_count) {
-
-                // 一共要申请的大小
-                //size_t total_size = block_count * memory_size;
-                // 原本使用这个，只分配适量的空间
-                //size_t allocate_page_count = size_utils::align(total_size, size_utils::PAGE_SIZE) / size_utils::PAGE_SIZE;
-                // 现在改成直接分配能分配的最大的大小
-                // 要申请的页面个数
-                size_t allocate_page_count = get_page_allocate_count(memory_size);
-                auto ret = get_page_from_page_cache(allocate_page_count);
-                if (!ret.has_value()) {
-                    return std::nullopt;
-                }
-                memory_span memory = ret.value();
-
-                // 用于管理这个页面
-                page_span page_span(memory, memory_size);
-
-#ifndef NDEBUG
-                // 如果使用的page_span是固定大小管理的，则可分配的个数也是固定的
-                size_t allocate_unit_count = page_span::MAX_UNIT_COUNT;
-#else
-                // 否则就是不同个数的
-                size_t allocate_unit_count = memory.size() / memory_size;
-#endif
-
-                // 将页面中的内存块分配出去
-                for (size_t i = 0; i < block_count; i++) {
-                    memory_span split_memory = memory.subspan(0, memory_size);
-                    memory = memory.subspan(memory_size);
-                    assert((index + 1) * 8 == split_memory.size());
-
-                    *(reinterpret_cast<std::byte**>(split_memory.data())) = result;
-                    result = split_memory.data();
+        profiled_flag_guard guard(m_status[index], m_counters[index].lock);
 
-                    // 这个页面已经被分配出去了
-                    page_span.allocate(split_memory);
-                }
-
-                // 完成页面分配的管理
-                auto start_addr = page_span.data();
-                //emplace返回类型为pair<iterator, bool>，第一个是迭代器，第二个是bool
-                auto [_, succeed] = m_page_set[index].emplace(start_addr, std::move(page_span));
-                // 如果插入失败了，说明代码写的有问题
-                assert(succeed == true);
-
-                // 多余的值存到空闲列表中
-                allocate_unit_count -= block_count;
-                for (size_t i = 0; i < allocate_unit_count; i++) {
-                    memory_span split_memory = memory.subspan(0, memory_size);
-                    memory = memory.subspan(memory_size);
-                    assert((index + 1) * 8 == split_memory.size());
-
-                    *(reinterpret_cast<std::byte**>(split_memory.data())) = m_free_array[index];
-                    m_free_array[index] = split_memory.data();
-                    m_free_array_size[index] ++;
-                }
-            } else {// 如果当前缓存的个数大于等于申请的块数，则直接从空闲链表中取
-                auto& target_list = m_free_array[index];
-                assert(m_free_array_size[index] >= block_count);
-                // 直接从中心缓存区中分配内存
-                for (size_t i = 0; i < block_count; i++) {
-                    assert(m_free_array[index] != nullptr);
-                    //头插法
-                    std::byte* node = m_free_array[index];
-                    m_free_array[index] = *(reinterpret_cast<std::byte**>(node));
-                    m_free_array_size[index] --;
-                    // 在页管理中记录分配的内存块
-                    record_allocated_memory_span(node, memory_size);
-
-                    *(reinterpret_cast<std::byte**>(node)) = result;
-                    result = node;
-                }
+        // 如果当前缓存的个数小于申请的块数，则向页分配器申请
+        while (m_free_array_size[index] < block_count) {
+            // 一共要申请的大小
+            //size_t total_size = block_count * memory_size;
+            // 原本使用这个，只分配适量的空间
+            //size_t allocate_page_count = size_utils::align(total_size, size_utils::PAGE_SIZE) / size_utils::PAGE_SIZE;
+            // 现在改成直接分配能分配的最大的大小
+            // 要申请的页面个数
+            size_t allocate_page_count = get_page_allocate_count(memory_size);
+            if (!allocate_page_span(memory_size, allocate_page_count)) {
+                return std::nullopt;
             }
-        } catch (...) {
-            throw std::runtime_error("central_cache::allocate Memory allocation failed");
-            return std::nullopt;
         }
 
+        assert(m_free_array_size[index] >= block_count);
+        // 直接从中心缓存区中分配内存
+        for (size_t i = 0; i < block_count; i++) {
+            assert(m_free_array[index] != nullptr);
+            //头插法
+            std::byte* node = m_free_array[index];
+            m_free_array[index] = *(reinterpret_cast<std::byte**>(node));
+            m_free_array_size[index] --;
+            // 在页管理中记录分配的内存块
+            record_allocated_memory_span(node, memory_size);
+
+            *(reinterpret_cast<std::byte**>(node)) = result;
+            result = node;
+        }
+        // 记录这个大小的使用情况，用于保存画像
+        m_max_batch_count[index] = std::max(m_max_batch_count[index], block_count);
+        m_used_block_count[index] += block_count;
+        m_peak_used_block_count[index] = std::max(m_peak_used_block_count[index], m_used_block_count[index]);
+        m_counters[index].allocate_count.fetch_add(1, std::memory_order_relaxed);
+        publish_counters(index);
 
         assert(check_ptr_length(result) == block_count);
         return result;
@@ -125,13 +100,13 @@ namespace memory_pool {
 
         // 如果是大内存块，则直接返回给page_cache管理
         if (memory_size > size_utils::MAX_CACHED_UNIT_SIZE) {
-            page_cache::GetInstance().deallocate_unit(memory_span(memory_list, memory_size));
+            m_page_cache.deallocate_unit(memory_span(memory_list, memory_size));
             return;
         }
 
         // 小内存，从中心缓存中释放
         const size_t index = size_utils::get_index(memory_size);
-        atomic_flag_guard guard(m_status[index]);
+        profiled_flag_guard guard(m_status[index], m_counters[index].lock);
 
         std::byte* current_memory = memory_list;
         while (current_memory != nullptr) {
@@ -142,20 +117,22 @@ namespace memory_pool {
             *(reinterpret_cast<std::byte**>(current_memory)) = m_free_array[index];
             m_free_array[index] = current_memory;
             m_free_array_size[index] ++;
+            m_used_block_count[index] --;
 
 
             // 然后再还给页面管理器中
-            auto it = m_page_set[index].upper_bound(current_memory);
-            assert(it != m_page_set[index].begin());
-            -- it;
-            assert(it->second.is_valid_unit_span(memory_span(current_memory, memory_size)));
-            it->second.deallocate(memory_span(current_memory, memory_size));
+            // 通过页表直接找到所属的span，不需要在树中查找
+            page_span* span = page_map::GetInstance().get(current_memory);
+            assert(span != nullptr && span->unit_size() == memory_size);
+            assert(span->is_valid_unit_span(memory_span(current_memory, memory_size)));
+            span->deallocate(memory_span(current_memory, memory_size));
             // 同时判断需不需要返回给页面管理器
-            if (it->second.is_empty()) {
+            if (span->is_empty()) {
+                trace_scope trace(trace_event_type::span_release, span->size(), memory_size);
                 // 如果已经还清内存了，则将这块内存还给页面管理器(page_cache)
-                auto page_start_addr = it->second.data();
-                auto page_end_addr = page_start_addr + it->second.size();
-                assert(it->second.unit_size() == memory_size);
+                auto page_start_addr = span->data();
+                auto page_end_addr = page_start_addr + span->size();
+                assert(span->unit_size() == memory_size);
 
                 std::byte* current = m_free_array[index];
                 std::byte* prev = nullptr;
@@ -169,7 +146,7 @@ namespace memory_pool {
                     if (memory_start_addr >= page_start_addr && memory_end_addr <= page_end_addr) {
                         // 如果这个内存在这个范围内，则说明是正确的
                         // 一定是满足要求的，如果不满足，则说明代码写错了
-                        assert(it->second.is_valid_unit_span(memory_span(current, memory_size)));
+                        assert(span->is_valid_unit_span(memory_span(current, memory_size)));
                         should_remove = true;
                     }
                     // 只有在不需要删除的时候才会更新prev
@@ -188,18 +165,268 @@ namespace memory_pool {
                     }
                     current = next;
                 }
-                memory_span page_memory = it->second.get_memory_span();
-                m_page_set[index].erase(it);
+                memory_span page_memory = span->get_memory_span();
+                page_map::GetInstance().clear(page_memory);
+                m_page_set[index].erase(span->data());
+                m_counters[index].span_count.fetch_sub(1, std::memory_order_relaxed);
+                m_counters[index].span_bytes.fetch_sub(page_memory.size(), std::memory_order_relaxed);
                 // 如果是动态分配申请页面的
 #ifdef NDEBUG
                 // 如果回收了指定的页面，则说明当前这个空间分配的过多了，下一次申请内存的时候要少一点申请
                 m_next_allocate_memory_group_count[index] /= 2;
 #endif
 
-                page_cache::GetInstance().deallocate_page(page_memory);
+                m_page_cache.deallocate_page(page_memory);
             }
             current_memory = next_node_to_add;
         }
+        m_counters[index].deallocate_count.fetch_add(1, std::memory_order_relaxed);
+        publish_counters(index);
+    }
+
+    bool central_cache::reserve(size_t memory_size, const size_t block_count) {
+        memory_size = size_utils::align_unit(memory_size);
+        if (memory_size == 0 || memory_size > size_utils::MAX_CACHED_UNIT_SIZE) {
+            return false;
+        }
+        const size_t index = size_utils::get_index(memory_size);
+        profiled_flag_guard guard(m_status[index], m_counters[index].lock);
+        while (m_free_array_size[index] < block_count) {
+            // 按缺少的个数申请，但是一个页面不能超过能管理的上限
+            size_t missing_size = (block_count - m_free_array_size[index]) * memory_size;
+            size_t allocate_page_count = size_utils::align(missing_size, size_utils::PAGE_SIZE) / size_utils::PAGE_SIZE;
+            allocate_page_count = std::min(allocate_page_count, get_max_page_count(memory_size));
+            if (!allocate_page_span(memory_size, allocate_page_count)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_class_profile central_cache::get_profile(const size_t index) {
+        assert(index < size_utils::CACHE_LINE_SIZE);
+        profiled_flag_guard guard(m_status[index], m_counters[index].lock);
+        size_class_profile profile;
+        profile.batch_count = m_max_batch_count[index];
+#ifdef NDEBUG
+        profile.group_count = m_next_allocate_memory_group_count[index];
+#endif
+        profile.peak_block_count = m_peak_used_block_count[index];
+        return profile;
+    }
+
+    bool central_cache::apply_profile(const size_t index, const size_class_profile& profile) {
+        assert(index < size_utils::CACHE_LINE_SIZE);
+        m_initial_batch_count[index].store(profile.batch_count, std::memory_order_relaxed);
+        {
+            profiled_flag_guard guard(m_status[index], m_counters[index].lock);
+            m_max_batch_count[index] = std::max(m_max_batch_count[index], profile.batch_count);
+#ifdef NDEBUG
+            m_next_allocate_memory_group_count[index] = std::max(m_next_allocate_memory_group_count[index], profile.group_count);
+#endif
+        }
+        // 按照上一次的峰值预先切好页面
+        return reserve((index + 1) * size_utils::ALIGNMENT, profile.peak_block_count);
+    }
+
+    bool central_cache::allocate_page_span(const size_t memory_size, const size_t page_count) {
+        const size_t index = size_utils::get_index(memory_size);
+        page_span* span = create_page_span(memory_size, page_count);
+        if (span == nullptr) {
+            return false;
+        }
+        memory_span memory = span->get_memory_span();
+
+        size_t allocate_unit_count = memory.size() / memory_size;
+#ifndef NDEBUG
+        // 如果使用的page_span是固定大小管理的，则可分配的个数也是有上限的
+        allocate_unit_count = std::min(allocate_unit_count, page_span::MAX_UNIT_COUNT);
+#endif
+        // 全部存到空闲列表中，从后往前插入，让链表按地址从小到大排列
+        for (size_t i = allocate_unit_count; i > 0; i--) {
+            std::byte* unit = memory.data() + (i - 1) * memory_size;
+            *(reinterpret_cast<std::byte**>(unit)) = m_free_array[index];
+            m_free_array[index] = unit;
+        }
+        m_free_array_size[index] += allocate_unit_count;
+        publish_counters(index);
+        return true;
+    }
+
+    page_span* central_cache::create_page_span(const size_t memory_size, const size_t page_count) {
+        const size_t index = size_utils::get_index(memory_size);
+        trace_scope trace(trace_event_type::span_create, page_count * size_utils::PAGE_SIZE, memory_size);
+        auto ret = get_page_from_page_cache(page_count);
+        if (!ret.has_value()) {
+            return nullptr;
+        }
+        memory_span memory = ret.value();
+
+        // 完成页面分配的管理
+        // 元数据申请不到时把页面还回去，和申请不到页面一样返回nullptr，不把异常抛给线程缓存
+        try {
+            //try_emplace返回类型为pair<iterator, bool>，第一个是迭代器，第二个是bool
+            auto [span_it, succeed] = m_page_set[index].try_emplace(memory.data(), memory, memory_size);
+            // 如果插入失败了，说明代码写的有问题
+            assert(succeed == true);
+            try {
+                // 在页表中记录这个span，用于不带大小的释放
+                page_map::GetInstance().set(memory, &span_it->second);
+            } catch (const std::bad_alloc&) {
+                m_page_set[index].erase(span_it);
+                throw;
+            }
+            m_counters[index].span_count.fetch_add(1, std::memory_order_relaxed);
+            m_counters[index].span_bytes.fetch_add(memory.size(), std::memory_order_relaxed);
+            return &span_it->second;
+        } catch (const std::bad_alloc&) {
+            m_page_cache.deallocate_page(memory);
+            return nullptr;
+        }
+    }
+
+#ifdef MEMORY_POOL_REMOTE_FREE
+    page_span* central_cache::allocate_owned_span(const size_t memory_size, const uint64_t owner) {
+        assert(memory_size % 8 == 0 && memory_size <= size_utils::MAX_CACHED_UNIT_SIZE);
+        const size_t index = size_utils::get_index(memory_size);
+        profiled_flag_guard guard(m_status[index], m_counters[index].lock);
+
+        // 每一个线程只拿一小段，让不同大小、不同线程之间的浪费不会太多
+        size_t page_count = std::min(size_utils::align(OWNED_SPAN_SIZE, size_utils::PAGE_SIZE) / size_utils::PAGE_SIZE,
+                                     get_max_page_count(memory_size));
+        page_span* span = create_page_span(memory_size, page_count);
+        if (span == nullptr) {
+            return nullptr;
+        }
+
+        size_t unit_count = span->size() / memory_size;
+#ifndef NDEBUG
+        unit_count = std::min(unit_count, page_span::MAX_UNIT_COUNT);
+#endif
+        // 所有的内存块都交给了线程缓存，在中心缓存看来都已经分配出去了
+        for (size_t i = 0; i < unit_count; i++) {
+            span->allocate(memory_span(span->data() + i * memory_size, memory_size));
+        }
+        span->owner_state().owner.store(owner, std::memory_order_relaxed);
+        span->owner_state().unit_count = unit_count;
+
+        m_used_block_count[index] += unit_count;
+        m_peak_used_block_count[index] = std::max(m_peak_used_block_count[index], m_used_block_count[index]);
+        m_counters[index].allocate_count.fetch_add(1, std::memory_order_relaxed);
+        publish_counters(index);
+        return span;
+    }
+
+    void central_cache::deallocate_owned_span(page_span* span) {
+        const size_t memory_size = span->unit_size();
+        const size_t index = size_utils::get_index(memory_size);
+        assert(span->owner_state().remote_free_list.load() == nullptr);
+        memory_span page_memory = span->get_memory_span();
+        trace_scope trace(trace_event_type::span_release, page_memory.size(), memory_size);
+
+        profiled_flag_guard guard(m_status[index], m_counters[index].lock);
+        m_used_block_count[index] -= span->owner_state().unit_count;
+        page_map::GetInstance().clear(page_memory);
+        m_page_set[index].erase(span->data());
+        m_counters[index].span_count.fetch_sub(1, std::memory_order_relaxed);
+        m_counters[index].span_bytes.fetch_sub(page_memory.size(), std::memory_order_relaxed);
+        m_counters[index].deallocate_count.fetch_add(1, std::memory_order_relaxed);
+        publish_counters(index);
+        m_page_cache.deallocate_page(page_memory);
+    }
+#endif
+
+    size_t central_cache::copy_span_occupancy(size_t index, std::byte* start, size_t max_count,
+                                              metadata_vector<span_occupancy>& output) {
+        assert(index < size_utils::CACHE_LINE_SIZE);
+        // 调用的一方已经留好了位置，持有锁时不再申请内存
+        assert(output.capacity() - output.size() >= max_count);
+        profiled_flag_guard guard(m_status[index], m_counters[index].lock);
+        size_t copied = 0;
+        for (auto it = m_page_set[index].lower_bound(start); it != m_page_set[index].end() && copied < max_count;
+             ++it, ++copied) {
+            page_span& span = it->second;
+            output.push_back({span.data(), span.size(), span.unit_count(), span.allocated_count()});
+        }
+        return copied;
+    }
+
+    thread_cache_counters* central_cache::register_thread_cache() noexcept {
+        {
+            std::lock_guard<std::mutex> lock(m_thread_counters_mutex);
+            if (thread_cache_counters* counters = m_free_thread_counters; counters != nullptr) {
+                m_free_thread_counters = counters->next_free;
+                counters->next_free = nullptr;
+                counters->active.store(true, std::memory_order_relaxed);
+                return counters;
+            }
+        }
+        void* memory = nullptr;
+        try {
+            memory = metadata_arena::GetInstance().allocate(sizeof(thread_cache_counters));
+        } catch (const std::bad_alloc&) {
+            return nullptr;
+        }
+        auto* counters = new (memory) thread_cache_counters();
+        counters->active.store(true, std::memory_order_relaxed);
+        // 只会在头部插入，不会删除，所以不需要担心ABA
+        counters->next = m_thread_counters.load(std::memory_order_relaxed);
+        while (!m_thread_counters.compare_exchange_weak(counters->next, counters, std::memory_order_release,
+                                                        std::memory_order_relaxed)) {
+        }
+        return counters;
+    }
+
+    void central_cache::unregister_thread_cache(thread_cache_counters* counters) noexcept {
+        // 先加到合计中再清零，读取的一方在这之间可能多算一次，但是不会少算
+        for (size_t index = 0; index < counters->allocate_count.size(); index++) {
+            const size_t count = counters->allocate_count[index].load(std::memory_order_relaxed);
+            if (count != 0) {
+                m_retired_thread_counters.allocate_count[index].fetch_add(count, std::memory_order_relaxed);
+                counters->allocate_count[index].store(0, std::memory_order_relaxed);
+            }
+        }
+        m_retired_thread_counters.deallocate_count.fetch_add(
+            counters->deallocate_count.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        for (auto& count : counters->free_block_count) {
+            count.store(0, std::memory_order_relaxed);
+        }
+        counters->active.store(false, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(m_thread_counters_mutex);
+        counters->next_free = m_free_thread_counters;
+        m_free_thread_counters = counters;
+    }
+
+    void central_cache::publish_counters(const size_t index) {
+        m_counters[index].free_block_count.store(m_free_array_size[index], std::memory_order_relaxed);
+        m_counters[index].used_block_count.store(m_used_block_count[index], std::memory_order_relaxed);
+    }
+
+    void central_cache::prepare_fork() {
+        for (auto& status : m_status) {
+            while (status.test_and_set(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+        }
+        m_thread_counters_mutex.lock();
+    }
+
+    void central_cache::after_fork() {
+        m_thread_counters_mutex.unlock();
+        for (auto& status : m_status) {
+            status.clear(std::memory_order_release);
+        }
+    }
+
+    size_t central_cache::get_max_page_count(size_t memory_size) {
+#ifndef NDEBUG
+        // page_span最多只能管理MAX_UNIT_COUNT个单元
+        return size_utils::align(memory_size * page_span::MAX_UNIT_COUNT, size_utils::PAGE_SIZE) / size_utils::PAGE_SIZE;
+#else
+        // 一个页面最多是一次向系统申请的大小
+        return page_cache::PAGE_ALLOCATE_COUNT;
+#endif
     }
 
     size_t central_cache::get_page_allocate_count(size_t memory_size) {
@@ -221,14 +448,12 @@ namespace memory_pool {
     }
 
     void central_cache::record_allocated_memory_span(std::byte* memory, const size_t memory_size) {
-        const size_t index = size_utils::get_index(memory_size);
-        auto it = m_page_set[index].upper_bound(memory);
-        assert(it != m_page_set[index].begin());
-        --it;
-        it->second.allocate(memory_span(memory, memory_size));
+        page_span* span = page_map::GetInstance().get(memory);
+        assert(span != nullptr && span->unit_size() == memory_size);
+        span->allocate(memory_span(memory, memory_size));
     }
 
     std::optional<memory_span> central_cache::get_page_from_page_cache(size_t page_allocate_count) {
-        return page_cache::GetInstance().allocate_page(page_allocate_count);
+        return m_page_cache.allocate_page(page_allocate_count);
     }
 }
\ No newline at end of file
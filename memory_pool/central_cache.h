@@ -3,18 +3,75 @@
 #ifndef CENTRAL_CACHE_H
 #define CENTRAL_CACHE_H
 #include <atomic>
-#include <list>
-#include <map>
 #include <span>
 #include <optional>
 #include <mutex>
-#include <set>
-#include <unordered_map>
+#include <new>
 
+#include "lock_profiler.h"
+#include "metadata_allocator.h"
 #include "utils.h"
 
 namespace memory_pool
 {
+    // 一种大小的内存块在运行中学到的分配情况，用于下一次启动时直接恢复
+    struct size_class_profile
+    {
+        // 线程缓存一次向中心缓存申请的最大个数
+        size_t batch_count = 0;
+        // 中心缓存下一次申请页面的组数（只有release模式下有效）
+        size_t group_count = 0;
+        // 同时被线程持有（正在使用或缓存在线程中）的内存块的峰值
+        size_t peak_block_count = 0;
+    };
+
+    // 一种大小在中心缓存中的统计，持有对应的锁时更新，读取时不需要加锁
+    struct central_class_counters
+    {
+        // 空闲链表中的个数
+        std::atomic<size_t> free_block_count = 0;
+        // 交给线程缓存的个数（线程缓存中空闲的和正在使用的）
+        std::atomic<size_t> used_block_count = 0;
+        // 管理的span个数和字节数
+        std::atomic<size_t> span_count = 0;
+        std::atomic<size_t> span_bytes = 0;
+        // 线程缓存来申请和归还的次数
+        std::atomic<size_t> allocate_count = 0;
+        std::atomic<size_t> deallocate_count = 0;
+        // 这个大小的锁的争用情况
+        lock_counters lock;
+    };
+
+    // 一个线程缓存的统计，由线程缓存自己在慢路径中更新，读取时不需要加锁
+    // 线程退出时计数加到中心缓存的退出线程的合计中，记录清零以后留给之后创建的线程使用
+    struct thread_cache_counters
+    {
+        // 每一种大小空闲链表中的个数
+        std::array<std::atomic<size_t>, size_utils::CACHE_LINE_SIZE> free_block_count = {};
+        // 线程缓存处理的2KB以内每一种大小的申请次数（最后一项为更大的大小和大内存）和归还的总次数（包括没有进入慢路径的）
+        // 一种大小的申请次数在这个大小下一次进入慢路径时才更新，最多落后空闲链表中的个数
+        std::array<std::atomic<size_t>, size_utils::COUNTED_SIZE_CLASSES + 1> allocate_count = {};
+        std::atomic<size_t> deallocate_count = 0;
+        // 是否有线程缓存正在使用，没有时所有的计数都是0
+        std::atomic<bool> active = false;
+        // 同一个中心缓存的下一个记录
+        thread_cache_counters *next = nullptr;
+        // 没有线程缓存使用时，空闲记录链表中的下一个
+        thread_cache_counters *next_free = nullptr;
+    };
+
+    // 中心缓存中一个span的占用情况
+    struct span_occupancy
+    {
+        std::byte *data = nullptr;
+        size_t size = 0;
+        // 切分出的内存块个数，以及交给线程缓存的个数（正在使用的和缓存在线程中的）
+        size_t unit_count = 0;
+        size_t allocated_count = 0;
+    };
+
+    class page_cache;
+
     // 中心存储器
     class central_cache
     {
@@ -23,10 +80,26 @@ namespace memory_pool
         static constexpr size_t PAGE_SPAN = 8;
         static central_cache &GetInstance()
         {
-            static central_cache instance;
+#ifdef MEMORY_POOL_NO_DESTROY
+            // 替换malloc时，进程退出的最后阶段仍然可能有释放，所以永远不析构
+            alignas(central_cache) static std::byte storage[sizeof(central_cache)];
+            static central_cache *instance = new (storage) central_cache(default_page_cache());
+            return *instance;
+#else
+            static central_cache instance(default_page_cache());
             return instance;
+#endif
         }
 
+        // 参数：这个中心缓存向哪一个页缓存申请页面
+        explicit central_cache(page_cache &page_cache) : m_page_cache(page_cache) {}
+
+        // 把还在使用的页面从页表中清除，页面本身由页缓存统一归还
+        ~central_cache();
+
+        central_cache(const central_cache &) = delete;
+        central_cache &operator=(const central_cache &) = delete;
+
         // 用于分配指向个数的指向大小的空间
         // 参数：memory_size: 要申请的大小 block_count: 申请的个数
         // 返回值：返回一组相同大小的指定个数的内存块
@@ -37,15 +110,102 @@ namespace memory_pool
         // 注意点：这一个列表中，每一个内存块大小必须是一样的。
         void deallocate(std::byte *memory_list, size_t memory_size);
 
+        // 预先准备好指定个数的空闲内存块，用于预热
+        // 参数：memory_size: 内存块的大小 block_count: 空闲链表中至少要有的个数
+        // 返回值：是否成功，大内存不会在这一层缓存，返回false
+        bool reserve(size_t memory_size, size_t block_count);
+
+        // 获取一种大小目前学到的分配情况
+        // 参数：index: 大小对应的下标
+        size_class_profile get_profile(size_t index);
+
+        // 恢复一种大小的分配情况，并按照峰值预先准备好内存块
+        // 参数：index: 大小对应的下标 profile: 之前保存的分配情况
+        bool apply_profile(size_t index, const size_class_profile &profile);
+
+        // 线程缓存第一次申请时一次申请的个数，没有恢复过画像时为0
+        size_t get_initial_batch_count(size_t index) const
+        {
+            return m_initial_batch_count[index].load(std::memory_order_relaxed);
+        }
+
+#ifdef MEMORY_POOL_REMOTE_FREE
+        // 交给线程缓存的一个span的大小，不能比MAX_CACHED_UNIT_SIZE小
+        static constexpr size_t OWNED_SPAN_SIZE = 64 * 1024;
+        static_assert(OWNED_SPAN_SIZE >= size_utils::MAX_CACHED_UNIT_SIZE);
+
+        // 切好一个新的span整个交给线程缓存，span中所有的内存块都算作已经分配出去
+        // 参数：memory_size: 内存块的大小，不能超过MAX_CACHED_UNIT_SIZE owner: 拥有这个span的线程缓存的编号
+        // 返回值：新的span，失败时返回nullptr
+        page_span *allocate_owned_span(size_t memory_size, uint64_t owner);
+
+        // 线程缓存中的一个span全部空闲时，整个还给页缓存
+        // 调用前span中的内存块都要从线程缓存的空闲链表中摘掉，并且没有远程归还的内存块
+        void deallocate_owned_span(page_span *span);
+#endif
+
+        // 一种大小的统计
+        const central_class_counters &get_counters(size_t index) const
+        {
+            return m_counters[index];
+        }
+
+        // 复制一种大小的一批span的占用情况，按地址排列，每次只持有锁复制max_count个
+        // 参数：index: 大小对应的下标 start: 从不小于这个地址的span开始 output: 追加到这里，调用前至少要留出max_count个位置
+        // 返回值：复制的个数，小于max_count时说明已经复制到了最后一个
+        size_t copy_span_occupancy(size_t index, std::byte *start, size_t max_count,
+                                   metadata_vector<span_occupancy> &output);
+
+        // 为一个线程缓存取一个统计记录，优先复用已经退出的线程的记录，失败时返回nullptr
+        thread_cache_counters *register_thread_cache() noexcept;
+
+        // 线程缓存所在的线程退出时调用，把计数加到退出线程的合计中，记录清零后留给之后的线程复用
+        void unregister_thread_cache(thread_cache_counters *counters) noexcept;
+
+        // 所有线程缓存的统计记录，通过next连成链表，只会增加，个数不超过同时存在的线程缓存的峰值
+        // 没有在使用的记录计数都是0
+        const thread_cache_counters *get_thread_counters() const
+        {
+            return m_thread_counters.load(std::memory_order_acquire);
+        }
+
+        // 已经退出的线程的计数的合计，只使用申请和归还的次数
+        const thread_cache_counters &get_retired_thread_counters() const
+        {
+            return m_retired_thread_counters;
+        }
+
+        // fork之前按顺序锁住所有的桶，fork之后在父子进程中解锁
+        void prepare_fork();
+        void after_fork();
+
     private:
+        // 默认的页缓存，在cpp中定义，避免头文件互相包含
+        static page_cache &default_page_cache();
+
         size_t get_page_allocate_count(size_t memory_size);
 
+        // 一个page_span最多可以管理的页面数
+        size_t get_max_page_count(size_t memory_size);
+
+        // 从页缓存中申请一个新的页面，切分好以后全部放入空闲链表，调用前需要持有对应的锁
+        bool allocate_page_span(size_t memory_size, size_t page_count);
+
+        // 从页缓存中申请页面并记录为一个新的span，调用前需要持有对应的锁
+        // 返回值：新的span，失败时返回nullptr
+        page_span *create_page_span(size_t memory_size, size_t page_count);
+
+        // 把空闲链表的长度和交给线程缓存的个数发布到统计中，调用前需要持有对应的锁
+        void publish_counters(size_t index);
+
         // 将分配出去的内存块记录下来
         void record_allocated_memory_span(std::byte *memory, const size_t memory_size);
 
         // 从页缓存中获取页面
         std::optional<memory_span> get_page_from_page_cache(size_t page_allocate_count);
 
+        // 对应的页缓存
+        page_cache &m_page_cache;
         // 空闲链表
         std::array<std::byte *, size_utils::CACHE_LINE_SIZE> m_free_array = {};
         // 空闲链表的长度有多少
@@ -53,7 +213,26 @@ namespace memory_pool
         // 指定长度的锁
         std::array<std::atomic_flag, size_utils::CACHE_LINE_SIZE> m_status;
         // 用于页面的管理
-        std::array<std::map<std::byte *, page_span>, size_utils::CACHE_LINE_SIZE> m_page_set;
+        std::array<metadata_map<std::byte *, page_span>, size_utils::CACHE_LINE_SIZE> m_page_set;
+
+        // 线程缓存一次申请的最大个数
+        std::array<size_t, size_utils::CACHE_LINE_SIZE> m_max_batch_count = {};
+        // 目前被线程持有的内存块个数
+        std::array<size_t, size_utils::CACHE_LINE_SIZE> m_used_block_count = {};
+        // 被线程持有的内存块个数的峰值
+        std::array<size_t, size_utils::CACHE_LINE_SIZE> m_peak_used_block_count = {};
+        // 从画像中恢复的线程缓存初始申请个数，线程会不加锁地读取
+        std::array<std::atomic<size_t>, size_utils::CACHE_LINE_SIZE> m_initial_batch_count = {};
+        // 每一种大小的统计
+        std::array<central_class_counters, size_utils::CACHE_LINE_SIZE> m_counters = {};
+        // 线程缓存的统计记录
+        std::atomic<thread_cache_counters *> m_thread_counters = nullptr;
+        // 没有在使用的统计记录，通过next_free连成链表
+        thread_cache_counters *m_free_thread_counters = nullptr;
+        // 保护m_free_thread_counters
+        std::mutex m_thread_counters_mutex;
+        // 已经退出的线程的计数的合计
+        thread_cache_counters m_retired_thread_counters;
 
 #ifdef NDEBUG
         // 动态决定不同的内存长度要分配几个页面，与线程缓存相同的思路
@@ -0,0 +1,141 @@
+#include "event_tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "metadata_allocator.h"
+
+namespace memory_pool {
+    namespace {
+        constexpr std::array<std::string_view, TRACE_EVENT_TYPE_COUNT> EVENT_NAMES = {
+            "refill", "release", "span_create", "span_release", "page_split", "page_coalesce", "system_map",
+            "system_unmap",
+        };
+    }
+
+    std::string_view trace_event_name(trace_event_type type) {
+        return EVENT_NAMES[static_cast<size_t>(type)];
+    }
+
+    bool event_tracer::start() {
+#ifdef MEMORY_POOL_EVENT_TRACE
+        s_enabled.store(true, std::memory_order_relaxed);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void event_tracer::stop() {
+        s_enabled.store(false, std::memory_order_relaxed);
+    }
+
+    void event_tracer::record(trace_event_type type, uint64_t start, uint64_t end, uint64_t size,
+                              uint64_t count) noexcept {
+        thread_ring* ring = local_ring();
+        if (ring == nullptr) {
+            return;
+        }
+        const uint64_t index = ring->head.load(std::memory_order_relaxed);
+        event_slot& slot = ring->slots[index % RING_CAPACITY];
+        // 先让读取的一方知道这个位置正在被改写
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.end.store(end, std::memory_order_relaxed);
+        slot.size.store(size, std::memory_order_relaxed);
+        slot.count.store(count, std::memory_order_relaxed);
+        slot.type.store(type, std::memory_order_relaxed);
+        slot.sequence.store(index + 1, std::memory_order_release);
+        ring->head.store(index + 1, std::memory_order_release);
+    }
+
+    event_tracer::thread_ring* event_tracer::local_ring() noexcept {
+        static thread_local thread_ring* local_ring = nullptr;
+        if (local_ring != nullptr) {
+            return local_ring;
+        }
+        // 直接向元数据分配器申请，不会回到内存池，也不会在替换了malloc时递归
+        thread_ring* ring = nullptr;
+        try {
+            ring = new (metadata_arena::GetInstance().allocate(sizeof(thread_ring))) thread_ring();
+        } catch (...) {
+            return nullptr;
+        }
+        ring->thread_id = static_cast<uint64_t>(syscall(SYS_gettid));
+        ring->next = m_threads.load(std::memory_order_relaxed);
+        while (!m_threads.compare_exchange_weak(ring->next, ring, std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+        }
+        local_ring = ring;
+        return ring;
+    }
+
+    std::string event_tracer::flush_chrome_trace() {
+        // 用同一时刻的时间戳和steady_clock把周期数换算到CLOCK_MONOTONIC的时间轴上
+        const double ticks_per_us = latency_recorder::GetInstance().ticks_per_ns() * 1000;
+        const uint64_t now_ticks = latency_recorder::now();
+        const double now_us =
+            std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        auto to_us = [&](uint64_t ticks) {
+            return now_us - static_cast<double>(static_cast<int64_t>(now_ticks - ticks)) / ticks_per_us;
+        };
+
+        std::ostringstream output;
+        output.precision(3);
+        output << std::fixed << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        const long process_id = getpid();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (thread_ring* ring = m_threads.load(std::memory_order_acquire); ring != nullptr; ring = ring->next) {
+            const uint64_t head = ring->head.load(std::memory_order_acquire);
+            // 缓冲区写满以后更早的事件已经被覆盖了
+            uint64_t index = std::max(ring->flushed, head > RING_CAPACITY ? head - RING_CAPACITY : 0);
+            for (; index < head; index++) {
+                const event_slot& slot = ring->slots[index % RING_CAPACITY];
+                if (slot.sequence.load(std::memory_order_acquire) != index + 1) {
+                    continue;
+                }
+                const uint64_t start = slot.start.load(std::memory_order_relaxed);
+                const uint64_t end = slot.end.load(std::memory_order_relaxed);
+                const uint64_t size = slot.size.load(std::memory_order_relaxed);
+                const uint64_t count = slot.count.load(std::memory_order_relaxed);
+                const trace_event_type type = slot.type.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                // 读取的过程中被写入的线程覆盖了
+                if (slot.sequence.load(std::memory_order_relaxed) != index + 1) {
+                    continue;
+                }
+                output << (first ? "" : ",") << "\n{\"name\":\"" << trace_event_name(type)
+                       << "\",\"cat\":\"memory_pool\",\"pid\":" << process_id << ",\"tid\":" << ring->thread_id
+                       << ",\"ts\":" << to_us(start);
+                if (type == trace_event_type::page_split || type == trace_event_type::page_coalesce) {
+                    output << ",\"ph\":\"i\",\"s\":\"t\"";
+                } else {
+                    output << ",\"ph\":\"X\",\"dur\":" << static_cast<double>(end - start) / ticks_per_us;
+                }
+                output << ",\"args\":{\"size\":" << size << ",\"count\":" << count << "}}";
+                first = false;
+            }
+            ring->flushed = head;
+        }
+        output << "\n]}\n";
+        return output.str();
+    }
+
+    bool event_tracer::write_chrome_trace(const std::string& path) {
+        const std::string temporary_path = path + ".tmp";
+        {
+            std::ofstream output(temporary_path, std::ios::trunc);
+            if (!output || !(output << flush_chrome_trace()).flush()) {
+                return false;
+            }
+        }
+        return std::rename(temporary_path.c_str(), path.c_str()) == 0;
+    }
+} // memory_pool
@@ -0,0 +1,172 @@
+#ifndef EVENT_TRACER_H
+#define EVENT_TRACER_H
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+
+#include "latency.h"
+
+namespace memory_pool
+{
+
+    // 记录的慢路径事件
+    enum class trace_event_type : uint32_t
+    {
+        // 线程缓存向中心缓存申请一批内存块，size为内存块的大小，count为个数
+        refill,
+        // 线程缓存把多出来的内存块还给中心缓存，size为内存块的大小，count为归还前线程缓存中空闲的个数
+        release,
+        // 中心缓存向页缓存申请页面切分成一个span，size为span的字节数，count为内存块的大小
+        span_create,
+        // 中心缓存把一个全部空闲的span还给页缓存，size和count同上
+        span_release,
+        // 页缓存从一段空闲页面中切出一部分（瞬时事件），size为切出的字节数，count为剩下的字节数
+        page_split,
+        // 页缓存把归还的页面和相邻的空闲页面合并（瞬时事件），size为合并后的字节数，count为归还的字节数
+        page_coalesce,
+        // 向系统映射内存（mmap、mremap、在预留区域中mprotect）和解除映射，size为字节数
+        system_map,
+        system_unmap,
+        count,
+    };
+
+    inline constexpr size_t TRACE_EVENT_TYPE_COUNT = static_cast<size_t>(trace_event_type::count);
+
+    // 用于输出的名字
+    std::string_view trace_event_name(trace_event_type type);
+
+    // 慢路径的事件记录，输出成Chrome的trace_event JSON格式，可以直接用chrome://tracing或者Perfetto打开
+    // 每个线程把事件写到自己的环形缓冲区中，不加锁；缓冲区写满以后覆盖最旧的事件
+    // 只有定义了MEMORY_POOL_EVENT_TRACE时记录事件的代码才会编译进来，否则trace_scope和trace_instant什么也不做
+    // 编译进来以后默认不记录，调用start以后才开始，没有开始时每个记录点只多读一个原子变量
+    class event_tracer
+    {
+    public:
+        // 每个线程的缓冲区能保存的事件个数，2的幂
+        static constexpr size_t RING_CAPACITY = 4096;
+
+        static event_tracer &GetInstance()
+        {
+#ifdef MEMORY_POOL_NO_DESTROY
+            alignas(event_tracer) static std::byte storage[sizeof(event_tracer)];
+            static event_tracer *instance = new (storage) event_tracer();
+            return *instance;
+#else
+            static event_tracer instance;
+            return instance;
+#endif
+        }
+
+        // 开始记录
+        // 返回值：是否开始成功，没有定义MEMORY_POOL_EVENT_TRACE时返回false
+        bool start();
+
+        // 停止记录，已经记录的事件仍然可以输出
+        void stop();
+
+        // 是否正在记录
+        static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+        // 记录一个事件，只写当前线程的缓冲区
+        // 参数：start和end为latency_recorder::now()的时间戳，瞬时事件两个相同
+        void record(trace_event_type type, uint64_t start, uint64_t end, uint64_t size, uint64_t count) noexcept;
+
+        // 输出上一次输出以后记录的事件，每个线程最多RING_CAPACITY个
+        // 时间戳为CLOCK_MONOTONIC的微秒数，和其他使用steady_clock的追踪数据在同一个时间轴上
+        std::string flush_chrome_trace();
+
+        // 把flush_chrome_trace的结果写到文件中，先写临时文件再改名
+        // 返回值：是否写入成功
+        bool write_chrome_trace(const std::string &path);
+
+    private:
+        event_tracer() = default;
+
+        // 缓冲区中的一个事件，写入时先把序号清零，写完所有字段以后再写入序号，读取时前后两次序号一致才有效
+        struct event_slot
+        {
+            std::atomic<uint64_t> sequence = 0;
+            std::atomic<uint64_t> start = 0;
+            std::atomic<uint64_t> end = 0;
+            std::atomic<uint64_t> size = 0;
+            std::atomic<uint64_t> count = 0;
+            std::atomic<trace_event_type> type = trace_event_type::refill;
+        };
+
+        // 一个线程的缓冲区，只由这个线程写，线程退出以后仍然保留
+        struct thread_ring
+        {
+            std::array<event_slot, RING_CAPACITY> slots;
+            // 写入的事件总数，第i个事件在slots[i % RING_CAPACITY]中
+            std::atomic<uint64_t> head = 0;
+            // 已经输出过的事件总数，只在输出时持有m_mutex访问
+            uint64_t flushed = 0;
+            // 系统的线程号
+            uint64_t thread_id = 0;
+            thread_ring *next = nullptr;
+        };
+
+        // 当前线程的缓冲区，第一次记录时创建，申请失败时返回nullptr
+        thread_ring *local_ring() noexcept;
+
+        static inline std::atomic<bool> s_enabled = false;
+        std::atomic<thread_ring *> m_threads = nullptr;
+        // 保证同时只有一个输出
+        std::mutex m_mutex;
+    };
+
+#ifdef MEMORY_POOL_EVENT_TRACE
+    // 记录从构造到析构的一个事件，构造时没有开始记录的话什么也不做
+    class trace_scope
+    {
+    public:
+        trace_scope(trace_event_type type, uint64_t size, uint64_t count = 0)
+            : m_type(type), m_size(size), m_count(count),
+              m_start(event_tracer::enabled() ? latency_recorder::now() : 0)
+        {
+        }
+        ~trace_scope()
+        {
+            if (m_start != 0)
+            {
+                event_tracer::GetInstance().record(m_type, m_start, latency_recorder::now(), m_size, m_count);
+            }
+        }
+
+        trace_scope(const trace_scope &) = delete;
+        trace_scope &operator=(const trace_scope &) = delete;
+
+    private:
+        trace_event_type m_type;
+        uint64_t m_size;
+        uint64_t m_count;
+        uint64_t m_start;
+    };
+
+    // 记录一个瞬时事件
+    inline void trace_instant(trace_event_type type, uint64_t size, uint64_t count = 0)
+    {
+        if (event_tracer::enabled())
+        {
+            const uint64_t now = latency_recorder::now();
+            event_tracer::GetInstance().record(type, now, now, size, count);
+        }
+    }
+#else
+    class trace_scope
+    {
+    public:
+        constexpr trace_scope(trace_event_type, uint64_t, uint64_t = 0) noexcept {}
+    };
+
+    inline void trace_instant(trace_event_type, uint64_t, uint64_t = 0) noexcept {}
+#endif
+
+} // memory_pool
+
+#endif // EVENT_TRACER_H
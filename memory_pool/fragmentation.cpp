@@ -0,0 +1,165 @@
+#include "fragmentation.h"
+
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+#include <sstream>
+
+#include "central_cache.h"
+#include "metadata_allocator.h"
+#include "page_cache.h"
+
+namespace memory_pool {
+    namespace {
+        constexpr size_t FREE_RUN_BUCKET_COUNT = 12;
+
+        size_t free_run_bucket_index(size_t page_count) {
+            return std::min<size_t>(std::bit_width(page_count) - 1, FREE_RUN_BUCKET_COUNT - 1);
+        }
+
+        // 复制下一批之前留好位置，复制时持有锁，不能在锁中申请内存
+        // 容量按倍数增长，复制很多批时不会每一批都重新分配和搬移
+        template <typename T>
+        void reserve_batch(metadata_vector<T>& output) {
+            if (output.capacity() - output.size() < FRAGMENTATION_BATCH_SIZE) {
+                output.reserve(std::max(2 * output.capacity(), output.size() + FRAGMENTATION_BATCH_SIZE));
+            }
+        }
+    }
+
+    fragmentation_report collect_fragmentation(central_cache& central, page_cache& page) {
+        fragmentation_report report;
+
+        // 空闲页面按地址分批复制，下一批从上一批最后一段之后开始
+        metadata_vector<memory_span> free_pages;
+        while (true) {
+            std::byte* start = free_pages.empty() ? nullptr : free_pages.back().data() + 1;
+            reserve_batch(free_pages);
+            if (page.copy_free_pages(start, FRAGMENTATION_BATCH_SIZE, free_pages) < FRAGMENTATION_BATCH_SIZE) {
+                break;
+            }
+        }
+        metadata_vector<memory_span> chunks;
+        do {
+            reserve_batch(chunks);
+        } while (page.copy_chunks(chunks.size(), FRAGMENTATION_BATCH_SIZE, chunks) == FRAGMENTATION_BATCH_SIZE);
+
+        report.free_runs.resize(FREE_RUN_BUCKET_COUNT);
+        for (size_t i = 0; i < FREE_RUN_BUCKET_COUNT; i++) {
+            report.free_runs[i].min_pages = size_t{1} << i;
+            report.free_runs[i].max_pages = i + 1 < FREE_RUN_BUCKET_COUNT ? (size_t{2} << i) - 1 : 0;
+        }
+        for (const memory_span& run : free_pages) {
+            free_run_bucket& bucket = report.free_runs[free_run_bucket_index(run.size() / size_utils::PAGE_SIZE)];
+            bucket.run_count++;
+            bucket.bytes += run.size();
+            report.free_bytes += run.size();
+            report.largest_free_run = std::max(report.largest_free_run, run.size());
+        }
+
+        // 相邻的内存块中的空闲页面会合并成一段，所以按块的边界截断
+        std::sort(chunks.begin(), chunks.end());
+        auto run = free_pages.begin();
+        for (const memory_span& chunk : chunks) {
+            chunk_layout layout;
+            layout.data = chunk.data();
+            layout.size = chunk.size();
+            std::byte* chunk_end = chunk.data() + chunk.size();
+            while (run != free_pages.end() && run->data() + run->size() <= chunk.data()) {
+                ++run;
+            }
+            for (auto it = run; it != free_pages.end() && it->data() < chunk_end; ++it) {
+                std::byte* begin = std::max(it->data(), chunk.data());
+                std::byte* end = std::min(it->data() + it->size(), chunk_end);
+                layout.free_bytes += end - begin;
+                layout.largest_free_run = std::max<size_t>(layout.largest_free_run, end - begin);
+            }
+            report.chunks.push_back(layout);
+        }
+
+        // 每一种大小分批复制span，只有有span的大小才需要加锁
+        metadata_vector<span_occupancy> spans;
+        for (size_t index = 0; index < size_utils::CACHE_LINE_SIZE; index++) {
+            if (central.get_counters(index).span_count.load(std::memory_order_relaxed) == 0) {
+                continue;
+            }
+            spans.clear();
+            while (true) {
+                std::byte* start = spans.empty() ? nullptr : spans.back().data + 1;
+                reserve_batch(spans);
+                if (central.copy_span_occupancy(index, start, FRAGMENTATION_BATCH_SIZE, spans) <
+                    FRAGMENTATION_BATCH_SIZE) {
+                    break;
+                }
+            }
+            if (spans.empty()) {
+                continue;
+            }
+
+            size_class_layout layout;
+            layout.unit_size = (index + 1) * size_utils::ALIGNMENT;
+            for (const span_occupancy& span : spans) {
+                layout.span_count++;
+                layout.span_bytes += span.size;
+                layout.allocated_bytes += span.allocated_count * layout.unit_size;
+                layout.tail_bytes += span.size - span.unit_count * layout.unit_size;
+                const size_t decile = span.unit_count == 0 ? 0 : span.allocated_count * 10 / span.unit_count;
+                layout.occupancy_histogram[std::min<size_t>(decile, 9)]++;
+                if (span.allocated_count != 0 &&
+                    span.allocated_count < fragmentation_report::STRANDED_OCCUPANCY * span.unit_count) {
+                    layout.stranded_span_count++;
+                    layout.stranded_bytes += span.size - span.allocated_count * layout.unit_size;
+                }
+            }
+            report.stranded_bytes += layout.stranded_bytes;
+            report.size_classes.push_back(layout);
+        }
+        return report;
+    }
+
+    std::string format_fragmentation(const fragmentation_report& report) {
+        std::ostringstream output;
+        output << std::fixed << std::setprecision(1);
+        auto percent = [](size_t part, size_t total) { return total == 0 ? 0.0 : 100.0 * part / total; };
+
+        output << "Free pages: " << report.free_bytes / 1024 << " KB, largest run "
+               << report.largest_free_run / 1024 << " KB\n";
+        output << std::left << std::setw(16) << "  run (pages)" << std::right << std::setw(10) << "runs"
+               << std::setw(14) << "KB" << "\n";
+        for (const free_run_bucket& bucket : report.free_runs) {
+            if (bucket.run_count == 0) {
+                continue;
+            }
+            std::string range = std::to_string(bucket.min_pages) +
+                                (bucket.max_pages == 0 ? "+" : "-" + std::to_string(bucket.max_pages));
+            output << "  " << std::left << std::setw(14) << range << std::right << std::setw(10) << bucket.run_count
+                   << std::setw(14) << bucket.bytes / 1024 << "\n";
+        }
+
+        output << "\nChunks: " << report.chunks.size() << "\n"
+               << std::left << std::setw(20) << "  address" << std::right << std::setw(10) << "KB" << std::setw(12)
+               << "free KB" << std::setw(16) << "largest run KB" << "\n";
+        for (const chunk_layout& chunk : report.chunks) {
+            output << "  " << std::left << std::setw(18) << static_cast<const void*>(chunk.data) << std::right
+                   << std::setw(10) << chunk.size / 1024 << std::setw(12) << chunk.free_bytes / 1024 << std::setw(16)
+                   << chunk.largest_free_run / 1024 << "\n";
+        }
+
+        output << "\nSize classes (occupancy deciles are span counts, 0-10% first): stranded "
+               << report.stranded_bytes / 1024 << " KB\n"
+               << std::left << std::setw(10) << "  size" << std::right << std::setw(8) << "spans" << std::setw(12)
+               << "span KB" << std::setw(8) << "used%" << std::setw(10) << "tail KB" << std::setw(14) << "stranded KB"
+               << "  occupancy\n";
+        for (const size_class_layout& size_class : report.size_classes) {
+            output << "  " << std::left << std::setw(8) << size_class.unit_size << std::right << std::setw(8)
+                   << size_class.span_count << std::setw(12) << size_class.span_bytes / 1024 << std::setw(8)
+                   << percent(size_class.allocated_bytes, size_class.span_bytes) << std::setw(10)
+                   << size_class.tail_bytes / 1024 << std::setw(14) << size_class.stranded_bytes / 1024 << " ";
+            for (size_t count : size_class.occupancy_histogram) {
+                output << " " << count;
+            }
+            output << "\n";
+        }
+        return output.str();
+    }
+} // memory_pool
@@ -0,0 +1,80 @@
+#ifndef FRAGMENTATION_H
+#define FRAGMENTATION_H
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace memory_pool
+{
+    class central_cache;
+    class page_cache;
+
+    // 页缓存中一段长度范围内的空闲页面
+    struct free_run_bucket
+    {
+        // 页数的范围 [min_pages, max_pages]，最后一个桶没有上限，max_pages为0
+        size_t min_pages = 0;
+        size_t max_pages = 0;
+        size_t run_count = 0;
+        size_t bytes = 0;
+    };
+
+    // 一块向系统申请的内存（一般为8MB）的空闲情况
+    struct chunk_layout
+    {
+        std::byte *data = nullptr;
+        size_t size = 0;
+        // 在页缓存中空闲的字节数，以及其中最长的一段连续空闲页面
+        size_t free_bytes = 0;
+        size_t largest_free_run = 0;
+    };
+
+    // 一种大小的span的布局
+    struct size_class_layout
+    {
+        size_t unit_size = 0;
+        size_t span_count = 0;
+        size_t span_bytes = 0;
+        // 交给线程缓存的内存块的字节数
+        size_t allocated_bytes = 0;
+        // span末尾放不下一个内存块的字节数，和span的大小选得好不好有关
+        size_t tail_bytes = 0;
+        // 按占用率（交给线程缓存的个数 / 能切分出的个数）分成10档的span个数，第i档为 [10i%, 10(i+1)%)，最后一档包括100%
+        std::array<size_t, 10> occupancy_histogram = {};
+        // 占用率低于STRANDED_OCCUPANCY、但还有内存块没有归还的span，因为这几个内存块整个span都不能还给页缓存
+        size_t stranded_span_count = 0;
+        size_t stranded_bytes = 0;
+    };
+
+    // 页缓存和中心缓存的碎片情况
+    // 分批复制，每一批只短暂地持有一把锁，所以可以在线调用；各批之间内存池可能有变化，结果不是同一时刻的快照
+    // 开启MEMORY_POOL_REMOTE_FREE时，交给线程缓存的span中所有的内存块都算作已经分配出去，占用率总是100%
+    struct fragmentation_report
+    {
+        // 占用率低于这个值的span算作几乎是空的
+        static constexpr double STRANDED_OCCUPANCY = 0.25;
+
+        // 空闲页面按页数分为 1, 2-3, 4-7, ..., 1024-2047, 2048以上
+        std::vector<free_run_bucket> free_runs;
+        size_t free_bytes = 0;
+        size_t largest_free_run = 0;
+        // 按地址排列
+        std::vector<chunk_layout> chunks;
+        // 有span的大小，按大小排列
+        std::vector<size_class_layout> size_classes;
+        size_t stranded_bytes = 0;
+    };
+
+    // 每一批复制的个数，决定了生成报告时一次持有锁的最长时间
+    inline constexpr size_t FRAGMENTATION_BATCH_SIZE = 256;
+
+    // 遍历一个中心缓存的所有span和它的页缓存中的空闲页面
+    fragmentation_report collect_fragmentation(central_cache &central, page_cache &page);
+
+    // 转换成便于阅读的文本
+    std::string format_fragmentation(const fragmentation_report &report);
+
+} // memory_pool
+
+#endif // FRAGMENTATION_H
@@ -0,0 +1,52 @@
+#include "heap.h"
+
+#include <atomic>
+#include <new>
+#include <stdexcept>
+
+namespace memory_pool {
+    namespace {
+        // 每一个下标是不是已经被某一个堆占用了
+        std::array<std::atomic_flag, heap::MAX_HEAP_COUNT> heap_index_used;
+        // 下一个堆的编号，从1开始，0表示线程还没有在这个下标上创建线程缓存
+        std::atomic<size_t> next_heap_generation = 1;
+    }
+
+    heap::heap() : m_generation(next_heap_generation.fetch_add(1, std::memory_order_relaxed)) {
+        for (m_index = 0; m_index < MAX_HEAP_COUNT; m_index++) {
+            if (!heap_index_used[m_index].test_and_set(std::memory_order_acquire)) {
+                return;
+            }
+        }
+        throw std::runtime_error("heap::heap too many heaps");
+    }
+
+    heap::~heap() {
+        // 线程缓存中的内存块都在这个堆的页面中，不需要一个一个归还
+        for (thread_cache* cache : m_thread_caches) {
+            cache->~thread_cache();
+            metadata_arena::GetInstance().deallocate(cache, sizeof(thread_cache));
+        }
+        m_thread_caches.clear();
+        // 旧的线程槽位的编号和之后的堆都不一样，所以不需要清除
+        heap_index_used[m_index].clear(std::memory_order_release);
+        // 成员析构时，中心缓存清除页表，页缓存把所有的页面一次还给系统
+    }
+
+    thread_cache& heap::create_local_cache(local_slot& slot) {
+        void* memory = metadata_arena::GetInstance().allocate(sizeof(thread_cache));
+        auto* cache = new (memory) thread_cache(m_central_cache);
+        {
+            std::unique_lock<std::mutex> guard(m_mutex);
+            try {
+                m_thread_caches.push_back(cache);
+            } catch (...) {
+                metadata_arena::GetInstance().deallocate(memory, sizeof(thread_cache));
+                throw;
+            }
+        }
+        slot.generation = m_generation;
+        slot.cache = cache;
+        return *cache;
+    }
+} // memory_pool
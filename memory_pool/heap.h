@@ -0,0 +1,124 @@
+#ifndef HEAP_H
+#define HEAP_H
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+
+#include "central_cache.h"
+#include "fragmentation.h"
+#include "metadata_allocator.h"
+#include "page_cache.h"
+#include "page_map.h"
+#include "stats.h"
+#include "thread_cache.h"
+
+namespace memory_pool
+{
+
+    // 独立的堆，拥有自己的页缓存、中心缓存和每个线程的线程缓存，和默认的堆（memory_pool的静态接口）互不影响
+    // 析构时把这个堆向系统申请的所有内存一次归还，堆中分配出去的内存全部失效
+    // 析构时不能有其他线程还在使用这个堆
+    class heap
+    {
+    public:
+        // 同时存在的独立的堆的最大个数
+        static constexpr size_t MAX_HEAP_COUNT = 64;
+
+        // 已经有MAX_HEAP_COUNT个堆时抛出std::runtime_error
+        heap();
+        ~heap();
+
+        heap(const heap &) = delete;
+        heap &operator=(const heap &) = delete;
+
+        // 向这个堆申请一块空间
+        // 参数：要申请的大小
+        // 返回值：指向空间的指针，可能会申请失败
+        std::optional<void *> allocate(size_t memory_size)
+        {
+            return local_cache().allocate(memory_size);
+        }
+
+        // 向这个堆归还一片空间，必须是这个堆分配出去的
+        // 参数： start_p:内存开始的地址, size_t：这片地址的大小
+        void deallocate(void *start_p, size_t memory_size)
+        {
+            local_cache().deallocate(start_p, memory_size);
+        }
+
+        // 向这个堆归还一片空间，大小从page_map中查出来
+        void deallocate(void *start_p)
+        {
+            if (start_p == nullptr)
+            {
+                return;
+            }
+            page_span *span = page_map::GetInstance().get(start_p);
+            assert(span != nullptr);
+            local_cache().deallocate(start_p, span->unit_size());
+        }
+
+        // 在启动时为这个堆预留一段连续的虚拟地址空间
+        bool reserve_address_space(size_t size = page_cache::DEFAULT_RESERVE_SIZE)
+        {
+            return m_page_cache.reserve_address_space(size);
+        }
+
+        // 这个堆的统计快照
+        pool_stats stats()
+        {
+            return collect_stats(m_central_cache, m_page_cache);
+        }
+
+        // 这个堆的碎片报告
+        fragmentation_report fragmentation()
+        {
+            return collect_fragmentation(m_central_cache, m_page_cache);
+        }
+
+    private:
+        // 每个线程记录自己在每一个堆中的线程缓存
+        struct local_slot
+        {
+            // 创建这个线程缓存的堆的编号，堆的下标会被复用，编号不会
+            size_t generation = 0;
+            thread_cache *cache = nullptr;
+        };
+
+        static std::array<local_slot, MAX_HEAP_COUNT> &local_slots()
+        {
+            static thread_local std::array<local_slot, MAX_HEAP_COUNT> slots = {};
+            return slots;
+        }
+
+        // 当前线程在这个堆中的线程缓存
+        thread_cache &local_cache()
+        {
+            local_slot &slot = local_slots()[m_index];
+            if (slot.generation == m_generation)
+            {
+                return *slot.cache;
+            }
+            return create_local_cache(slot);
+        }
+
+        // 第一次在这个线程中使用这个堆时创建线程缓存
+        thread_cache &create_local_cache(local_slot &slot);
+
+        page_cache m_page_cache;
+        central_cache m_central_cache{m_page_cache};
+        // 在所有堆中的下标
+        size_t m_index = 0;
+        // 这个堆的编号，每一个堆都不一样
+        size_t m_generation = 0;
+        // 保护m_thread_caches
+        std::mutex m_mutex;
+        // 所有线程在这个堆中的线程缓存，析构时统一释放
+        metadata_vector<thread_cache *> m_thread_caches = {};
+    };
+
+} // memory_pool
+
+#endif // HEAP_H
@@ -0,0 +1,226 @@
+#include "heap_profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <execinfo.h>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <utility>
+
+#include "page_map.h"
+
+namespace memory_pool {
+    namespace {
+        // 获取当前的调用栈，去掉这个函数自己，剩下的位置填nullptr
+        // backtrace第一次调用时会加载libgcc，里面可能会调用malloc，所以不能在持有锁的时候调用
+        __attribute__((noinline)) std::array<void*, heap_profiler::MAX_STACK_DEPTH> capture_stack() {
+            std::array<void*, heap_profiler::MAX_STACK_DEPTH + 1> frames = {};
+            const int depth = backtrace(frames.data(), static_cast<int>(frames.size()));
+            std::array<void*, heap_profiler::MAX_STACK_DEPTH> stack = {};
+            for (int i = 1; i < depth; i++) {
+                stack[i - 1] = frames[i];
+            }
+            return stack;
+        }
+    }
+
+    bool heap_profiler::start(size_t sample_period) {
+        // 先调用一次，让backtrace在开始采样之前就加载好需要的库
+        capture_stack();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (s_region_size.load(std::memory_order_relaxed) == 0) {
+            const size_t region_size = SLOT_SIZE * SLOT_COUNT;
+            void* region = mmap(nullptr, region_size, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (region == MAP_FAILED) {
+                return false;
+            }
+            s_region_begin.store(reinterpret_cast<std::uintptr_t>(region), std::memory_order_relaxed);
+            s_region_size.store(region_size, std::memory_order_relaxed);
+            s_region_mapped.store(true, std::memory_order_release);
+        }
+        m_sample_period.store(std::max<size_t>(sample_period, 1), std::memory_order_relaxed);
+        m_enabled.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    void heap_profiler::stop() {
+        m_enabled.store(false, std::memory_order_relaxed);
+    }
+
+    size_t heap_profiler::next_sample_interval(uint64_t& random_state) const {
+        if (random_state == 0) {
+            // 用线程缓存的地址作为种子，每个线程都不一样
+            random_state = reinterpret_cast<std::uintptr_t>(&random_state) | 1;
+        }
+        // xorshift64*
+        random_state ^= random_state >> 12;
+        random_state ^= random_state << 25;
+        random_state ^= random_state >> 27;
+        const uint64_t value = random_state * 2685821657736338717ULL;
+        // (0, 1] 之间的均匀分布，转换成均值为sample_period的指数分布
+        const double uniform = static_cast<double>((value >> 11) + 1) / static_cast<double>(uint64_t{1} << 53);
+        const double interval = -std::log(uniform) * static_cast<double>(m_sample_period.load(std::memory_order_relaxed));
+        return static_cast<size_t>(std::clamp(interval, 1.0, static_cast<double>(MAX_SAMPLE_INTERVAL)));
+    }
+
+    std::byte* heap_profiler::allocate_small_sample(size_t memory_size) noexcept {
+        const stack_trace stack = capture_stack();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        try {
+            size_t slot = 0;
+            if (!m_free_slots.empty()) {
+                slot = m_free_slots.back();
+                m_free_slots.pop_back();
+            } else if (m_next_slot < SLOT_COUNT) {
+                slot = m_next_slot++;
+            } else {
+                return nullptr;
+            }
+            std::byte* memory = reinterpret_cast<std::byte*>(s_region_begin.load(std::memory_order_relaxed)) +
+                                slot * SLOT_SIZE;
+            stack_bucket& bucket = get_bucket(stack);
+            live_sample& sample = m_samples[memory];
+            sample.bucket = &bucket;
+            sample.size = memory_size;
+            // 在page_map中记录大小，不带大小的释放和malloc_usable_size都能查到
+            sample.span.emplace(memory_span(memory, size_utils::align(memory_size, size_utils::PAGE_SIZE)),
+                                memory_size);
+            page_map::GetInstance().set(sample.span->get_memory_span(), &*sample.span);
+            bucket.allocate_count++;
+            bucket.allocate_bytes += memory_size;
+            return memory;
+        } catch (...) {
+            // 记录采样的元数据申请失败时不采样这一次
+            return nullptr;
+        }
+    }
+
+    void heap_profiler::deallocate_small_sample(void* ptr) noexcept {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto sample = m_samples.find(static_cast<std::byte*>(ptr));
+        assert(sample != m_samples.end() && "not a live sampled block");
+        if (sample == m_samples.end()) {
+            return;
+        }
+        page_map::GetInstance().clear(sample->second.span->get_memory_span());
+        const size_t slot = (reinterpret_cast<std::uintptr_t>(ptr) - s_region_begin.load(std::memory_order_relaxed)) /
+                            SLOT_SIZE;
+        remove_sample(sample);
+        try {
+            m_free_slots.push_back(slot);
+        } catch (...) {
+            // 记不下这个槽时只是少了一个可以复用的槽
+        }
+    }
+
+    void heap_profiler::record_large_sample(void* ptr, size_t memory_size) noexcept {
+        const stack_trace stack = capture_stack();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        try {
+            stack_bucket& bucket = get_bucket(stack);
+            live_sample& sample = m_samples[static_cast<std::byte*>(ptr)];
+            sample.bucket = &bucket;
+            sample.size = memory_size;
+            bucket.allocate_count++;
+            bucket.allocate_bytes += memory_size;
+            m_large_sample_count.fetch_add(1, std::memory_order_relaxed);
+        } catch (...) {
+        }
+    }
+
+    void heap_profiler::deallocate_large_sample(void* ptr) noexcept {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto sample = m_samples.find(static_cast<std::byte*>(ptr));
+        if (sample == m_samples.end()) {
+            return;
+        }
+        remove_sample(sample);
+        m_large_sample_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void heap_profiler::move_large_sample(void* old_ptr, void* new_ptr, size_t new_size) noexcept {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto sample = m_samples.find(static_cast<std::byte*>(old_ptr));
+        if (sample == m_samples.end()) {
+            return;
+        }
+        // 调整大小看作释放旧的、申请新的，调用栈仍然记在最初申请的地方
+        stack_bucket* bucket = sample->second.bucket;
+        bucket->deallocate_count++;
+        bucket->deallocate_bytes += sample->second.size;
+        bucket->allocate_count++;
+        bucket->allocate_bytes += new_size;
+        auto node = m_samples.extract(sample);
+        node.key() = static_cast<std::byte*>(new_ptr);
+        node.mapped().size = new_size;
+        m_samples.insert(std::move(node));
+    }
+
+    heap_profiler::stack_bucket& heap_profiler::get_bucket(const stack_trace& stack) {
+        return m_buckets[stack];
+    }
+
+    void heap_profiler::remove_sample(metadata_map<std::byte*, live_sample>::iterator sample) {
+        sample->second.bucket->deallocate_count++;
+        sample->second.bucket->deallocate_bytes += sample->second.size;
+        m_samples.erase(sample);
+    }
+
+    std::string heap_profiler::format_profile() {
+        // 先在锁中复制一份，格式化时用到的std::string可能会申请到内存池中并被采样
+        metadata_vector<std::pair<stack_trace, stack_bucket>> buckets;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            buckets.assign(m_buckets.begin(), m_buckets.end());
+        }
+
+        stack_bucket total;
+        for (const auto& [stack, bucket] : buckets) {
+            total.allocate_count += bucket.allocate_count;
+            total.allocate_bytes += bucket.allocate_bytes;
+            total.deallocate_count += bucket.deallocate_count;
+            total.deallocate_bytes += bucket.deallocate_bytes;
+        }
+
+        // 第一行是总数和采样的间隔，pprof按照heap_v2的间隔把采样的个数还原成估计的总数
+        std::ostringstream output;
+        auto write_counts = [&output](const stack_bucket& bucket) {
+            output << bucket.allocate_count - bucket.deallocate_count << ": "
+                   << bucket.allocate_bytes - bucket.deallocate_bytes << " [" << bucket.allocate_count << ": "
+                   << bucket.allocate_bytes << "]";
+        };
+        output << "heap profile: ";
+        write_counts(total);
+        output << " @ heap_v2/" << m_sample_period.load(std::memory_order_relaxed) << "\n";
+        for (const auto& [stack, bucket] : buckets) {
+            write_counts(bucket);
+            output << " @";
+            for (void* frame : stack) {
+                if (frame == nullptr) {
+                    break;
+                }
+                output << " " << frame;
+            }
+            output << "\n";
+        }
+
+        output << "\nMAPPED_LIBRARIES:\n";
+        std::ifstream maps("/proc/self/maps");
+        output << maps.rdbuf();
+        return output.str();
+    }
+
+    bool heap_profiler::write_profile(const std::string& path) {
+        const std::string temporary_path = path + ".tmp";
+        {
+            std::ofstream output(temporary_path, std::ios::trunc);
+            if (!output || !(output << format_profile()).flush()) {
+                return false;
+            }
+        }
+        return std::rename(temporary_path.c_str(), path.c_str()) == 0;
+    }
+} // memory_pool
@@ -0,0 +1,158 @@
+#ifndef HEAP_PROFILER_H
+#define HEAP_PROFILER_H
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <string>
+
+#include "metadata_allocator.h"
+#include "utils.h"
+
+namespace memory_pool
+{
+
+    // 采样的堆分析器，记录哪些调用栈持有内存池中的内存
+    // 每个线程缓存维护一个字节数的倒数，每次申请减去申请的大小，减到负数时采样这一次申请：
+    // 记录调用栈，直到对应的释放时才移除，平均每sample_period个字节采样一次
+    // 小内存的采样单独放在分析器预留的一段地址空间中，每一个采样占一个槽，
+    // 这样线程缓存归还时只需要比较地址的范围，就能知道是不是采样过的内存块
+    // 大块内存本来就走慢路径，采样时照常分配，释放时在慢路径中查表
+    // 结果可以输出成pprof的旧版堆分析格式（heap_v2），用 pprof --inuse_space 等方式查看
+    class heap_profiler
+    {
+    public:
+        // 默认平均每512KB采样一次
+        static constexpr size_t DEFAULT_SAMPLE_PERIOD = 512 * 1024;
+        // 记录的调用栈的最大深度
+        static constexpr size_t MAX_STACK_DEPTH = 32;
+        // 小内存采样的槽的大小和个数，一共预留1GB的地址空间，槽用完以后不再采样小内存
+        static constexpr size_t SLOT_SIZE = size_utils::MAX_CACHED_UNIT_SIZE;
+        static constexpr size_t SLOT_COUNT = 64 * 1024;
+        // 没有开启采样时，线程缓存每申请这么多字节进一次慢路径，检查是不是开启了采样
+        static constexpr size_t DISABLED_CHECK_BYTES = 1024 * 1024;
+        // 采样间隔和一次申请计入倒数的字节数的上限，保证倒数不会溢出
+        static constexpr size_t MAX_SAMPLE_INTERVAL = size_t{1} << 40;
+
+        static heap_profiler &GetInstance()
+        {
+#ifdef MEMORY_POOL_NO_DESTROY
+            alignas(heap_profiler) static std::byte storage[sizeof(heap_profiler)];
+            static heap_profiler *instance = new (storage) heap_profiler();
+            return *instance;
+#else
+            static heap_profiler instance;
+            return instance;
+#endif
+        }
+
+        // 开始采样，第一次开始时预留小内存采样用的地址空间
+        // 参数：sample_period:平均每多少个字节采样一次
+        // 返回值：是否开始成功，预留地址空间失败时返回false
+        bool start(size_t sample_period = DEFAULT_SAMPLE_PERIOD);
+
+        // 停止采样，已经采样的内存块仍然会在释放时移除，之后仍然可以输出
+        void stop();
+
+        // 是否正在采样
+        bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+        // 距离下一次采样的字节数，按指数分布随机，平均值为sample_period
+        // 参数：random_state:每个线程自己的随机数状态
+        size_t next_sample_interval(uint64_t &random_state) const;
+
+        // 判断一个地址是不是小内存的采样，线程缓存归还的快速路径中调用，没有开始过采样时总是false
+        static bool is_small_sample(const void *ptr)
+        {
+            // 没有开始过采样时只有这一次读取和判断
+            if (!s_region_mapped.load(std::memory_order_relaxed)) [[likely]]
+            {
+                return false;
+            }
+            return reinterpret_cast<std::uintptr_t>(ptr) - s_region_begin.load(std::memory_order_relaxed) <
+                   s_region_size.load(std::memory_order_relaxed);
+        }
+
+        // 为一次采样的小内存申请分配一个槽并记录调用栈
+        // 返回值：槽的起始地址，槽用完时返回nullptr，这时照常分配，不采样这一次
+        std::byte *allocate_small_sample(size_t memory_size) noexcept;
+
+        // 释放一个小内存的采样
+        void deallocate_small_sample(void *ptr) noexcept;
+
+        // 记录一次采样的大块内存申请，内存照常分配
+        void record_large_sample(void *ptr, size_t memory_size) noexcept;
+
+        // 是否有还没有释放的大块内存采样，没有时大块内存的释放不需要查表
+        bool has_large_samples() const { return m_large_sample_count.load(std::memory_order_relaxed) != 0; }
+
+        // 释放一块大块内存时移除它的采样，不是采样的内存块时什么也不做
+        void deallocate_large_sample(void *ptr) noexcept;
+
+        // 大块内存原地调整了大小或者被mremap移动了，更新它的采样
+        void move_large_sample(void *old_ptr, void *new_ptr, size_t new_size) noexcept;
+
+        // 以pprof旧版堆分析的文本格式输出：每一个调用栈一行，包括还在使用的和累计申请的采样，
+        // 最后附上/proc/self/maps，让pprof能把地址对应到函数
+        std::string format_profile();
+
+        // 把format_profile的结果写到文件中，先写临时文件再改名
+        // 返回值：是否写入成功
+        bool write_profile(const std::string &path);
+
+        // fork之前加锁，fork之后在父子进程中解锁
+        void prepare_fork() { m_mutex.lock(); }
+        void after_fork() { m_mutex.unlock(); }
+
+    private:
+        heap_profiler() = default;
+
+        using stack_trace = std::array<void *, MAX_STACK_DEPTH>;
+
+        // 同一个调用栈的采样汇总
+        struct stack_bucket
+        {
+            size_t allocate_count = 0;
+            size_t allocate_bytes = 0;
+            size_t deallocate_count = 0;
+            size_t deallocate_bytes = 0;
+        };
+
+        // 一个还没有释放的采样
+        struct live_sample
+        {
+            stack_bucket *bucket = nullptr;
+            size_t size = 0;
+            // 小内存的槽在page_map中对应的span，不带大小的释放可以查到大小
+            std::optional<page_span> span;
+        };
+
+        // 获取调用栈对应的汇总，调用前需要持有锁
+        stack_bucket &get_bucket(const stack_trace &stack);
+
+        // 移除一个采样，调用前需要持有锁
+        void remove_sample(metadata_map<std::byte *, live_sample>::iterator sample);
+
+        // 小内存采样的区域，第一次开始采样时设置，之后不再改变
+        static inline std::atomic<std::uintptr_t> s_region_begin = 0;
+        static inline std::atomic<std::uintptr_t> s_region_size = 0;
+        // 小内存采样的区域已经映射，在区域的地址和大小设置好以后设置
+        static inline std::atomic<bool> s_region_mapped = false;
+
+        std::atomic<bool> m_enabled = false;
+        std::atomic<size_t> m_sample_period = DEFAULT_SAMPLE_PERIOD;
+        std::atomic<size_t> m_large_sample_count = 0;
+        // 空闲的槽，以及从来没有用过的第一个槽
+        metadata_vector<size_t> m_free_slots = {};
+        size_t m_next_slot = 0;
+        metadata_map<stack_trace, stack_bucket> m_buckets = {};
+        metadata_map<std::byte *, live_sample> m_samples = {};
+        std::mutex m_mutex;
+    };
+
+} // memory_pool
+
+#endif // HEAP_PROFILER_H
@@ -0,0 +1,181 @@
+#include "latency.h"
+
+#include <algorithm>
+#include <pthread.h>
+
+#include "metadata_allocator.h"
+
+namespace memory_pool {
+    namespace {
+        constexpr std::array<std::string_view, LATENCY_SITE_COUNT> SITE_NAMES = {
+            "central_refill", "central_release", "page_allocate", "page_deallocate", "system_map", "system_unmap",
+        };
+    }
+
+    std::string_view latency_site_name(latency_site site) {
+        return SITE_NAMES[static_cast<size_t>(site)];
+    }
+
+    latency_recorder::latency_recorder() : m_start_ticks(now()), m_start_time(std::chrono::steady_clock::now()) {}
+
+    void latency_recorder::record(latency_site site, uint64_t ticks) noexcept {
+        thread_histograms* histograms = local_histograms();
+        if (histograms == nullptr) {
+            return;
+        }
+        // 只有当前线程会写，不需要原子的加法
+        const size_t index = static_cast<size_t>(site);
+        auto& count = histograms->counts[index][bucket_index(ticks)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        auto& total = histograms->total_ticks[index];
+        total.store(total.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+    }
+
+    latency_recorder::thread_histograms*& latency_recorder::local_record() noexcept {
+        static thread_local thread_histograms* record = nullptr;
+        return record;
+    }
+
+    latency_recorder::thread_histograms* latency_recorder::local_histograms() noexcept {
+        thread_histograms*& record = local_record();
+        if (record != nullptr) {
+            return record;
+        }
+        thread_histograms* histograms = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            histograms = m_free_threads;
+            if (histograms != nullptr) {
+                m_free_threads = histograms->next_free;
+                histograms->next_free = nullptr;
+            }
+        }
+        if (histograms == nullptr) {
+            // 直接向元数据分配器申请，不会回到内存池，也不会在替换了malloc时递归
+            try {
+                histograms = new (metadata_arena::GetInstance().allocate(sizeof(thread_histograms)))
+                    thread_histograms();
+            } catch (...) {
+                return nullptr;
+            }
+            histograms->next = m_threads.load(std::memory_order_relaxed);
+            while (!m_threads.compare_exchange_weak(histograms->next, histograms, std::memory_order_release,
+                                                    std::memory_order_relaxed)) {
+            }
+        }
+        // thread_local对象的析构会在每次访问时检查有没有注册过，所以使用pthread的线程局部数据，
+        // 线程退出时交还直方图；退出过程中再次记录时会重新设置，pthread会再调用一次
+        static pthread_key_t key;
+        static const bool key_created = pthread_key_create(&key, on_thread_exit) == 0;
+        if (key_created) {
+            pthread_setspecific(key, histograms);
+        }
+        record = histograms;
+        return histograms;
+    }
+
+    void latency_recorder::on_thread_exit(void* histograms) noexcept {
+        local_record() = nullptr;
+        GetInstance().retire(static_cast<thread_histograms*>(histograms));
+    }
+
+    void latency_recorder::retire(thread_histograms* histograms) noexcept {
+        // 和读取互斥，计数要么还在直方图中，要么已经在合计中
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t site = 0; site < LATENCY_SITE_COUNT; site++) {
+            for (size_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+                m_retired_counts[site][bucket] +=
+                    histograms->counts[site][bucket].exchange(0, std::memory_order_relaxed);
+            }
+            m_retired_ticks[site] += histograms->total_ticks[site].exchange(0, std::memory_order_relaxed);
+        }
+        histograms->next_free = m_free_threads;
+        m_free_threads = histograms;
+    }
+
+    void latency_recorder::prepare_fork() {
+        m_mutex.lock();
+    }
+
+    void latency_recorder::after_fork() {
+        m_mutex.unlock();
+    }
+
+    double latency_recorder::ticks_per_ns() {
+        // 创建以后时间太短时估计不准，至少等10ms
+        auto elapsed = std::chrono::steady_clock::now() - m_start_time;
+        while (elapsed < std::chrono::milliseconds(10)) {
+            elapsed = std::chrono::steady_clock::now() - m_start_time;
+        }
+        const uint64_t ticks = now() - m_start_ticks;
+        const double elapsed_ns = std::chrono::duration<double, std::nano>(elapsed).count();
+        return std::max(static_cast<double>(ticks) / elapsed_ns, 1e-9);
+    }
+
+    std::array<latency_stats, LATENCY_SITE_COUNT> latency_recorder::collect(bool reset) {
+        // 同时有两个读取时，保证基准值按读取的先后更新
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::array<std::array<uint64_t, BUCKET_COUNT>, LATENCY_SITE_COUNT> counts = m_retired_counts;
+        std::array<uint64_t, LATENCY_SITE_COUNT> total_ticks = m_retired_ticks;
+        for (thread_histograms* histograms = m_threads.load(std::memory_order_acquire); histograms != nullptr;
+             histograms = histograms->next) {
+            for (size_t site = 0; site < LATENCY_SITE_COUNT; site++) {
+                for (size_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+                    counts[site][bucket] += histograms->counts[site][bucket].load(std::memory_order_relaxed);
+                }
+                total_ticks[site] += histograms->total_ticks[site].load(std::memory_order_relaxed);
+            }
+        }
+
+        // 减去上一次重置时的值，得到这个窗口中的记录
+        for (size_t site = 0; site < LATENCY_SITE_COUNT; site++) {
+            for (size_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+                const uint64_t current = counts[site][bucket];
+                counts[site][bucket] -= std::min(current, m_baseline_counts[site][bucket]);
+                if (reset) {
+                    m_baseline_counts[site][bucket] = current;
+                }
+            }
+            const uint64_t current = total_ticks[site];
+            total_ticks[site] -= std::min(current, m_baseline_ticks[site]);
+            if (reset) {
+                m_baseline_ticks[site] = current;
+            }
+        }
+        lock.unlock();
+
+        const double scale = 1 / ticks_per_ns();
+        std::array<latency_stats, LATENCY_SITE_COUNT> result;
+        for (size_t site = 0; site < LATENCY_SITE_COUNT; site++) {
+            latency_stats& stats = result[site];
+            for (size_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+                if (counts[site][bucket] != 0) {
+                    stats.count += counts[site][bucket];
+                    stats.buckets.emplace_back(bucket_upper_bound(bucket) * scale, counts[site][bucket]);
+                }
+            }
+            stats.total_ns = total_ticks[site] * scale;
+            if (stats.count == 0) {
+                continue;
+            }
+            // 分位数取累计个数第一次达到的桶的上界
+            auto quantile = [&stats](double q) {
+                const size_t rank = std::max<size_t>(1, static_cast<size_t>(q * stats.count + 0.5));
+                size_t seen = 0;
+                for (const auto& [upper_bound, count] : stats.buckets) {
+                    seen += count;
+                    if (seen >= rank) {
+                        return upper_bound;
+                    }
+                }
+                return stats.buckets.back().first;
+            };
+            stats.p50_ns = quantile(0.5);
+            stats.p90_ns = quantile(0.9);
+            stats.p99_ns = quantile(0.99);
+            stats.p999_ns = quantile(0.999);
+            stats.max_ns = stats.buckets.back().first;
+        }
+        return result;
+    }
+} // memory_pool
@@ -0,0 +1,200 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace memory_pool
+{
+
+    // 记录延迟的慢路径
+    enum class latency_site : size_t
+    {
+        // 线程缓存向中心缓存申请一批内存块
+        central_refill,
+        // 线程缓存把内存块还给中心缓存
+        central_release,
+        // 页缓存分配和回收页面（包括等锁的时间）
+        page_allocate,
+        page_deallocate,
+        // 向系统映射内存（mmap，或者在预留区域中mprotect）和解除映射
+        system_map,
+        system_unmap,
+        count,
+    };
+
+    inline constexpr size_t LATENCY_SITE_COUNT = static_cast<size_t>(latency_site::count);
+
+    // 用于输出的名字
+    std::string_view latency_site_name(latency_site site);
+
+    // 一个慢路径在一个统计窗口中的延迟分布，单位为纳秒
+    struct latency_stats
+    {
+        size_t count = 0;
+        double total_ns = 0;
+        // 分位数取所在桶的上界，误差不超过一个桶的宽度（12.5%）
+        double p50_ns = 0;
+        double p90_ns = 0;
+        double p99_ns = 0;
+        double p999_ns = 0;
+        double max_ns = 0;
+        // 非空的桶，每一项为（桶的上界，个数），按上界排列
+        std::vector<std::pair<double, size_t>> buckets;
+    };
+
+    // 慢路径的延迟直方图，整个进程共用一份，所有的堆都记录在这里
+    // 每个线程写自己的直方图，不需要加锁也不会和其他线程争用缓存行；读取时把所有线程的加起来
+    // 线程退出时把它的直方图加到已退出线程的合计中，清零以后留给之后创建的线程使用
+    // 桶按对数线性划分：每一个2的幂的区间再平分成8个桶，用TSC的周期数计数，读取时换算成纳秒
+    // 重置时不清零计数器（其他线程可能正在写），而是记下当前的值，之后的读取减去这个值
+    class latency_recorder
+    {
+    public:
+        // 每一个2的幂的区间分成 2^SUB_BUCKET_BITS 个桶
+        static constexpr size_t SUB_BUCKET_BITS = 3;
+        static constexpr size_t SUB_BUCKET_COUNT = size_t{1} << SUB_BUCKET_BITS;
+        // 超过 2^MAX_EXPONENT 个周期的都记在最后一个桶中
+        static constexpr size_t MAX_EXPONENT = 40;
+        static constexpr size_t BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKET_COUNT;
+
+        static latency_recorder &GetInstance()
+        {
+#ifdef MEMORY_POOL_NO_DESTROY
+            alignas(latency_recorder) static std::byte storage[sizeof(latency_recorder)];
+            static latency_recorder *instance = new (storage) latency_recorder();
+            return *instance;
+#else
+            static latency_recorder instance;
+            return instance;
+#endif
+        }
+
+        // 当前的时间戳，x86上使用rdtsc，其他平台使用纳秒
+        static uint64_t now()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+#endif
+        }
+
+        // 周期数对应的桶
+        static constexpr size_t bucket_index(uint64_t ticks)
+        {
+            if (ticks < SUB_BUCKET_COUNT)
+            {
+                return ticks;
+            }
+            const size_t exponent = 63 - __builtin_clzll(ticks);
+            if (exponent > MAX_EXPONENT)
+            {
+                return BUCKET_COUNT - 1;
+            }
+            const size_t sub_bucket = (ticks >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+            return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + sub_bucket;
+        }
+
+        // 桶的上界（不包括），单位为周期
+        static constexpr uint64_t bucket_upper_bound(size_t index)
+        {
+            if (index < SUB_BUCKET_COUNT)
+            {
+                return index + 1;
+            }
+            const size_t exponent = index / SUB_BUCKET_COUNT + SUB_BUCKET_BITS - 1;
+            const size_t sub_bucket = index % SUB_BUCKET_COUNT;
+            return (SUB_BUCKET_COUNT + sub_bucket + 1) << (exponent - SUB_BUCKET_BITS);
+        }
+
+        // 记录一次延迟，只写当前线程的直方图
+        void record(latency_site site, uint64_t ticks) noexcept;
+
+        // 读取上一次重置以后的延迟分布
+        // 参数：reset:读取以后开始一个新的统计窗口，读到的记录不会再出现在下一次读取中
+        std::array<latency_stats, LATENCY_SITE_COUNT> collect(bool reset);
+
+        // 每纳秒的周期数，用创建时和现在的时间戳估计，创建以后不到10ms时会等到10ms
+        double ticks_per_ns();
+
+        // fork前锁住，fork后在父进程和子进程中解锁，避免子进程中的锁停在加锁的状态
+        // 记录延迟时可能持有其他的锁，这个锁要在其他的锁之后加
+        void prepare_fork();
+        void after_fork();
+
+    private:
+        latency_recorder();
+
+        // 一个线程的直方图，只由这个线程写
+        struct thread_histograms
+        {
+            std::array<std::array<std::atomic<uint64_t>, BUCKET_COUNT>, LATENCY_SITE_COUNT> counts;
+            std::array<std::atomic<uint64_t>, LATENCY_SITE_COUNT> total_ticks;
+            thread_histograms *next = nullptr;
+            // 空闲链表中的下一个，只在m_mutex下访问
+            thread_histograms *next_free = nullptr;
+        };
+
+        // 当前线程的直方图，第一次记录时取一个空闲的或者创建一个新的
+        thread_histograms *local_histograms() noexcept;
+
+        // 当前线程正在使用的直方图
+        static thread_histograms *&local_record() noexcept;
+
+        // 线程退出时调用，参数为这个线程的直方图
+        static void on_thread_exit(void *histograms) noexcept;
+
+        // 把直方图加到已退出线程的合计中，清零以后放入空闲链表
+        void retire(thread_histograms *histograms) noexcept;
+
+        // 所有创建过的直方图，只会在头部插入，不会删除
+        std::atomic<thread_histograms *> m_threads = nullptr;
+        // 已经退出的线程的直方图，可以给之后的线程使用
+        thread_histograms *m_free_threads = nullptr;
+        // 已经退出的线程的合计
+        std::array<std::array<uint64_t, BUCKET_COUNT>, LATENCY_SITE_COUNT> m_retired_counts = {};
+        std::array<uint64_t, LATENCY_SITE_COUNT> m_retired_ticks = {};
+        // 上一次重置时的累计值
+        std::array<std::array<uint64_t, BUCKET_COUNT>, LATENCY_SITE_COUNT> m_baseline_counts = {};
+        std::array<uint64_t, LATENCY_SITE_COUNT> m_baseline_ticks = {};
+        // 创建时的时间戳和时间，用于换算
+        uint64_t m_start_ticks = 0;
+        std::chrono::steady_clock::time_point m_start_time;
+        // 保护空闲链表、已退出线程的合计和基准值，读取时持有它，退出的线程的计数不会被算两次或者漏掉
+        std::mutex m_mutex;
+    };
+
+    // 在作用域结束时记录经过的时间
+    class latency_timer
+    {
+    public:
+        explicit latency_timer(latency_site site) : m_site(site), m_start(latency_recorder::now()) {}
+        ~latency_timer()
+        {
+            latency_recorder::GetInstance().record(m_site, latency_recorder::now() - m_start);
+        }
+
+        latency_timer(const latency_timer &) = delete;
+        latency_timer &operator=(const latency_timer &) = delete;
+
+    private:
+        latency_site m_site;
+        uint64_t m_start;
+    };
+
+} // memory_pool
+
+#endif // LATENCY_H
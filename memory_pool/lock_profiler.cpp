@@ -0,0 +1,17 @@
+#include "lock_profiler.h"
+
+namespace memory_pool {
+    lock_stats lock_counters::get_stats() const {
+        lock_stats stats;
+        stats.acquire_count = acquire_count.load(std::memory_order_relaxed);
+        stats.contended_count = contended_count.load(std::memory_order_relaxed);
+        const uint64_t total_ticks = wait_ticks.load(std::memory_order_relaxed);
+        const uint64_t max_ticks = max_wait_ticks.load(std::memory_order_relaxed);
+        if (stats.contended_count != 0) {
+            const double scale = 1 / latency_recorder::GetInstance().ticks_per_ns();
+            stats.total_wait_ns = total_ticks * scale;
+            stats.max_wait_ns = max_ticks * scale;
+        }
+        return stats;
+    }
+} // memory_pool
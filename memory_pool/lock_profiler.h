@@ -0,0 +1,125 @@
+#ifndef LOCK_PROFILER_H
+#define LOCK_PROFILER_H
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "latency.h"
+
+namespace memory_pool
+{
+
+    // 一把锁的争用情况，等待时间的单位为纳秒
+    struct lock_stats
+    {
+        // 加锁的次数
+        size_t acquire_count = 0;
+        // 第一次尝试没有拿到锁、需要等待的次数
+        size_t contended_count = 0;
+        // 等待的总时间和最长的一次
+        double total_wait_ns = 0;
+        double max_wait_ns = 0;
+    };
+
+    // 一把锁的计数器，只在持有这把锁时更新，所以不需要原子的加法；读取时不需要加锁
+    // 没有争用时只增加加锁的次数，只有第一次尝试失败时才读取时间戳计算等待的时间
+    struct lock_counters
+    {
+        std::atomic<uint64_t> acquire_count = 0;
+        std::atomic<uint64_t> contended_count = 0;
+        std::atomic<uint64_t> wait_ticks = 0;
+        std::atomic<uint64_t> max_wait_ticks = 0;
+
+        // 没有等待就拿到了锁，持有锁时调用
+        void record_acquire() noexcept
+        {
+            acquire_count.store(acquire_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        // 等待以后拿到了锁，持有锁时调用
+        // 参数：ticks:从第一次尝试失败到拿到锁经过的周期数
+        void record_contended(uint64_t ticks) noexcept
+        {
+            record_acquire();
+            contended_count.store(contended_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            wait_ticks.store(wait_ticks.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+            if (ticks > max_wait_ticks.load(std::memory_order_relaxed))
+            {
+                max_wait_ticks.store(ticks, std::memory_order_relaxed);
+            }
+        }
+
+        // 读取并换算成纳秒，各项不是同一时刻的值
+        lock_stats get_stats() const;
+    };
+
+    // 记录争用情况的互斥锁，可以直接用于std::unique_lock和std::lock_guard
+    class profiled_mutex
+    {
+    public:
+        void lock()
+        {
+            if (m_mutex.try_lock())
+            {
+                m_counters.record_acquire();
+                return;
+            }
+            const uint64_t start = latency_recorder::now();
+            m_mutex.lock();
+            m_counters.record_contended(latency_recorder::now() - start);
+        }
+
+        bool try_lock()
+        {
+            if (!m_mutex.try_lock())
+            {
+                return false;
+            }
+            m_counters.record_acquire();
+            return true;
+        }
+
+        void unlock() { m_mutex.unlock(); }
+
+        const lock_counters &counters() const { return m_counters; }
+
+    private:
+        std::mutex m_mutex;
+        lock_counters m_counters;
+    };
+
+    // 和atomic_flag_guard一样的自旋锁，同时把争用情况记录到计数器中
+    class profiled_flag_guard
+    {
+    public:
+        profiled_flag_guard(std::atomic_flag &flag, lock_counters &counters) : m_flag(flag)
+        {
+            if (!m_flag.test_and_set(std::memory_order_acquire))
+            {
+                counters.record_acquire();
+                return;
+            }
+            const uint64_t start = latency_recorder::now();
+            while (m_flag.test_and_set(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            counters.record_contended(latency_recorder::now() - start);
+        }
+        ~profiled_flag_guard()
+        {
+            m_flag.clear(std::memory_order_release);
+        }
+
+        profiled_flag_guard(const profiled_flag_guard &) = delete;
+        profiled_flag_guard &operator=(const profiled_flag_guard &) = delete;
+
+    private:
+        std::atomic_flag &m_flag;
+    };
+
+} // memory_pool
+
+#endif // LOCK_PROFILER_H
@@ -1,4 +1,191 @@
 #include "memory_pool.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+
+#include "central_cache.h"
+#include "page_cache.h"
+
 namespace memory_pool {
-} // memory_pool
\ No newline at end of file
+    std::optional<void*> memory_pool::reallocate(void* start_p, size_t old_size, size_t new_size) {
+        if (start_p == nullptr) {
+            return allocate(new_size);
+        }
+        if (new_size == 0) {
+            deallocate(start_p, old_size);
+            return std::nullopt;
+        }
+
+        const size_t old_unit_size = size_utils::align_unit(old_size);
+        const size_t new_unit_size = size_utils::align_unit(new_size);
+        // 还在同一个分级中，原来的内存块就够用
+        if (old_unit_size == new_unit_size) {
+            return start_p;
+        }
+        // 新旧大小都是大块内存时，先尝试不拷贝地调整
+        if (old_unit_size > size_utils::MAX_CACHED_UNIT_SIZE && new_unit_size > size_utils::MAX_CACHED_UNIT_SIZE) {
+            auto ret = page_cache::GetInstance().reallocate_unit(
+                memory_span(static_cast<std::byte*>(start_p), old_size), new_size);
+            if (ret.has_value()) {
+                if (heap_profiler::GetInstance().has_large_samples()) {
+                    heap_profiler::GetInstance().move_large_sample(start_p, ret->data(), new_size);
+                }
+                record_deallocate(start_p, old_size);
+                record_allocate(ret->data(), new_size);
+                return ret->data();
+            }
+        }
+
+        // 否则重新申请一块，拷贝以后再释放原来的
+        return allocate(new_size).transform([start_p, old_size, new_size](void* memory) {
+            copy_memory(memory, start_p, std::min(old_size, new_size));
+            deallocate(start_p, old_size);
+            return memory;
+        });
+    }
+
+    bool memory_pool::try_expand(void* start_p, size_t old_size, size_t new_size) {
+        if (start_p == nullptr || new_size == 0) {
+            return false;
+        }
+        const size_t old_unit_size = size_utils::align_unit(old_size);
+        const size_t new_unit_size = size_utils::align_unit(new_size);
+        if (old_unit_size == new_unit_size) {
+            return true;
+        }
+        if (old_unit_size <= size_utils::MAX_CACHED_UNIT_SIZE || new_unit_size <= size_utils::MAX_CACHED_UNIT_SIZE) {
+            return false;
+        }
+        if (!page_cache::GetInstance()
+                 .reallocate_unit(memory_span(static_cast<std::byte*>(start_p), old_size), new_size, false)
+                 .has_value()) {
+            return false;
+        }
+        if (heap_profiler::GetInstance().has_large_samples()) {
+            heap_profiler::GetInstance().move_large_sample(start_p, start_p, new_size);
+        }
+        record_deallocate(start_p, old_size);
+        record_allocate(start_p, new_size);
+        return true;
+    }
+
+    std::optional<void*> memory_pool::allocate_aligned(size_t memory_size, size_t alignment) {
+        if (memory_size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+            return std::nullopt;
+        }
+        // 对齐以后的大小不能溢出
+        if (memory_size > SIZE_MAX - alignment - size_utils::PAGE_SIZE) {
+            return std::nullopt;
+        }
+        if (alignment <= size_utils::PAGE_SIZE) {
+            return allocate(size_utils::align(memory_size, alignment));
+        }
+        // 大小至少要超过缓存的上限，保证释放时能回到page_cache
+        return page_cache::GetInstance()
+            .allocate_unit(std::max(memory_size, size_utils::MAX_CACHED_UNIT_SIZE + 1), alignment)
+            .transform([memory_size](memory_span memory) {
+                record_allocate(memory.data(), memory_size);
+                return static_cast<void*>(memory.data());
+            });
+    }
+
+    void memory_pool::deallocate_aligned(void* start_p, size_t memory_size, size_t alignment) {
+        if (start_p == nullptr) {
+            return;
+        }
+        if (alignment <= size_utils::PAGE_SIZE) {
+            deallocate(start_p, size_utils::align(memory_size, alignment));
+            return;
+        }
+        record_deallocate(start_p, memory_size);
+        // 申请时放大过，以page_cache记录的大小为准
+        page_cache::GetInstance().deallocate_unit(memory_span(static_cast<std::byte*>(start_p), 0));
+    }
+
+    bool memory_pool::prewarm(const prewarm_spec& spec) {
+        bool succeed = page_cache::GetInstance().prefault_page(spec.page_count);
+        // 先填充当前线程，再把中心缓存补满，这样其他线程第一次申请时也能直接拿到
+        succeed = prewarm_thread(spec) && succeed;
+        for (const auto& [memory_size, block_count] : spec.size_counts) {
+            // 大内存不在中心缓存中缓存，预先映射的页面已经覆盖了
+            if (size_utils::align(memory_size) > size_utils::MAX_CACHED_UNIT_SIZE) {
+                continue;
+            }
+            succeed = central_cache::GetInstance().reserve(memory_size, block_count) && succeed;
+        }
+        return succeed;
+    }
+
+    bool memory_pool::prewarm_thread(const prewarm_spec& spec) {
+        bool succeed = true;
+        for (const auto& [memory_size, block_count] : spec.size_counts) {
+            if (size_utils::align(memory_size) > size_utils::MAX_CACHED_UNIT_SIZE) {
+                continue;
+            }
+            succeed = thread_cache::GetInstance().reserve(memory_size, block_count) && succeed;
+        }
+        return succeed;
+    }
+
+    namespace {
+        // 画像文件的第一行，用于判断文件格式
+        constexpr std::string_view PROFILE_HEADER = "# memory_pool profile v1";
+    }
+
+    pool_stats memory_pool::stats(bool reset_latency) {
+        pool_stats result = collect_stats(central_cache::GetInstance(), page_cache::GetInstance());
+        result.latencies = latency_recorder::GetInstance().collect(reset_latency);
+        return result;
+    }
+
+    bool memory_pool::write_stats(const std::string& path, bool reset_latency) {
+        return write_prometheus(stats(reset_latency), path);
+    }
+
+    fragmentation_report memory_pool::fragmentation() {
+        return collect_fragmentation(central_cache::GetInstance(), page_cache::GetInstance());
+    }
+
+    bool memory_pool::save_profile(const std::string& path) {
+        std::ofstream output(path, std::ios::trunc);
+        if (!output) {
+            return false;
+        }
+        // 每一行：大小 线程批量个数 中心缓存组数 峰值个数，只保存用到过的大小
+        output << PROFILE_HEADER << "\n";
+        for (size_t index = 0; index < size_utils::CACHE_LINE_SIZE; index++) {
+            size_class_profile profile = central_cache::GetInstance().get_profile(index);
+            if (profile.batch_count == 0 && profile.peak_block_count == 0) {
+                continue;
+            }
+            output << (index + 1) * size_utils::ALIGNMENT << " " << profile.batch_count << " "
+                   << profile.group_count << " " << profile.peak_block_count << "\n";
+        }
+        return static_cast<bool>(output.flush());
+    }
+
+    bool memory_pool::load_profile(const std::string& path) {
+        std::ifstream input(path);
+        std::string line;
+        if (!input || !std::getline(input, line) || line != PROFILE_HEADER) {
+            return false;
+        }
+        bool succeed = true;
+        while (std::getline(input, line)) {
+            std::istringstream fields(line);
+            size_t memory_size = 0;
+            size_class_profile profile;
+            if (!(fields >> memory_size >> profile.batch_count >> profile.group_count >> profile.peak_block_count)) {
+                return false;
+            }
+            if (memory_size == 0 || memory_size > size_utils::MAX_CACHED_UNIT_SIZE) {
+                return false;
+            }
+            succeed = central_cache::GetInstance().apply_profile(size_utils::get_index(memory_size), profile) && succeed;
+        }
+        return succeed;
+    }
+} // memory_pool
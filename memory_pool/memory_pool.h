@@ -3,28 +3,214 @@
 #ifndef MEMORY_POOL_H
 #define MEMORY_POOL_H
 #include <optional>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "allocation_recorder.h"
+#include "event_tracer.h"
+#include "fragmentation.h"
+#include "heap_profiler.h"
+#include "page_cache.h"
+#include "page_map.h"
+#include "stats.h"
+#include "stats_segment.h"
 #include "thread_cache.h"
 
 namespace memory_pool
 {
 
+    // 预热的配置
+    struct prewarm_spec
+    {
+        // 预先映射并触碰的页面数
+        size_t page_count = 0;
+        // 需要预先填充的内存块，每一项为（大小，个数）
+        std::vector<std::pair<size_t, size_t>> size_counts = {};
+    };
+
     class memory_pool
     {
     public:
+        // 在启动时预留一段连续的虚拟地址空间，之后按需提交，用完以后会自动再预留
+        // 参数：预留的字节数
+        // 返回值：是否预留成功
+        static bool reserve_address_space(size_t size = page_cache::DEFAULT_RESERVE_SIZE)
+        {
+            return page_cache::GetInstance().reserve_address_space(size);
+        }
+
+        // 预热内存池：预先映射并触碰spec.page_count个页面，
+        // 为每一种大小填充中心缓存和当前线程的线程缓存，让之后的分配不再走慢路径
+        // 返回值：是否全部成功
+        static bool prewarm(const prewarm_spec &spec);
+
+        // 只预热当前线程的线程缓存，给线程池的线程初始化时使用
+        static bool prewarm_thread(const prewarm_spec &spec);
+
+        // 把每一种大小学到的批量大小和峰值保存到文件中，一般在程序退出前调用
+        // 返回值：是否保存成功
+        static bool save_profile(const std::string &path);
+
+        // 从文件中恢复之前保存的画像，预先设置批量大小并按照峰值准备好内存块
+        // 应该在程序启动、开始分配之前调用
+        // 返回值：是否恢复成功
+        static bool load_profile(const std::string &path);
+
+        // 获取各层的统计快照，只读取计数器，不会让正在申请和归还的线程等待
+        // 参数：reset_latency:读取以后开始一个新的延迟统计窗口，按采集周期读取时使用
+        static pool_stats stats(bool reset_latency = false);
+
+        // 把统计快照以Prometheus的文本格式写到文件中，给采集程序读取
+        // 参数：reset_latency:同stats，每次采集写一次文件时设为true，延迟只包括两次采集之间的记录
+        // 返回值：是否写入成功
+        static bool write_stats(const std::string &path, bool reset_latency = false);
+
+        // 定期把统计发布到共享内存 /dev/shm/memory_pool.<pid> 中，可以用 mempool_top <pid> 查看
+        // 返回值：是否开始成功，已经开始或者创建共享内存失败时返回false
+        static bool start_stats_segment(std::chrono::milliseconds interval = stats_segment::DEFAULT_INTERVAL)
+        {
+            return stats_segment::GetInstance().start(interval);
+        }
+
+        // 停止发布统计并删除共享内存
+        static void stop_stats_segment()
+        {
+            stats_segment::GetInstance().stop();
+        }
+
+        // 遍历默认的堆的空闲页面和所有span，生成碎片报告
+        // 每一批只短暂地持有一把锁，可以在运行中调用，用于决定什么时候重启进程、调整span的大小
+        static fragmentation_report fragmentation();
+
+        // 开始记录慢路径事件，编译时没有定义MEMORY_POOL_EVENT_TRACE时返回false
+        static bool start_event_trace()
+        {
+            return event_tracer::GetInstance().start();
+        }
+
+        // 停止记录慢路径事件
+        static void stop_event_trace()
+        {
+            event_tracer::GetInstance().stop();
+        }
+
+        // 把上一次写出以后记录的事件以Chrome的trace_event JSON格式写到文件中
+        // 返回值：是否写入成功
+        static bool write_event_trace(const std::string &path)
+        {
+            return event_tracer::GetInstance().write_chrome_trace(path);
+        }
+
+        // 开始记录每一次申请和归还，写到path中，给回放工具使用
+        // 返回值：是否开始成功，编译时没有定义MEMORY_POOL_ALLOCATION_TRACE时返回false
+        static bool start_allocation_trace(const std::string &path)
+        {
+            return allocation_recorder::GetInstance().start(path);
+        }
+
+        // 停止记录申请和归还，写出剩下的记录并关闭文件
+        // 返回值：是否所有的记录都写入成功
+        static bool stop_allocation_trace()
+        {
+            return allocation_recorder::GetInstance().stop();
+        }
+
+        // 开始采样的堆分析，平均每sample_period个字节的申请记录一次调用栈，只采样默认的堆
+        // 返回值：是否开始成功
+        static bool start_heap_profiler(size_t sample_period = heap_profiler::DEFAULT_SAMPLE_PERIOD)
+        {
+            return heap_profiler::GetInstance().start(sample_period);
+        }
+
+        // 停止采样，已经记录的采样仍然保留到对应的释放
+        static void stop_heap_profiler()
+        {
+            heap_profiler::GetInstance().stop();
+        }
+
+        // 以pprof旧版堆分析的格式把采样写到文件中，可以用 pprof <程序> <文件> 查看
+        // 返回值：是否写入成功
+        static bool write_heap_profile(const std::string &path)
+        {
+            return heap_profiler::GetInstance().write_profile(path);
+        }
+
+        // 判断一个地址是不是内存池分配出去的
+        static bool owns(const void *ptr)
+        {
+            return page_cache::GetInstance().owns(ptr);
+        }
+
         // 向内存池申请一块空间
         // 参数：要申请的大小
         // 返回值：指向空间的指针，可能会申请失败
         static std::optional<void *> allocate(size_t memory_size)
         {
-            return thread_cache::GetInstance().allocate(memory_size);
+            void *result = allocate_raw(memory_size);
+            if (result == nullptr)
+            {
+                return std::nullopt;
+            }
+            return result;
         }
 
         // 向内存池归还一片空间
         // 参数： start_p:内存开始的地址, size_t：这片地址的大小
         static void deallocate(void *start_p, size_t memory_size)
         {
-            thread_cache::GetInstance().deallocate(start_p, memory_size);
+            deallocate_raw(start_p, memory_size);
+        }
+
+        // 不抛出异常、直接返回指针的申请，线程缓存命中时的路径都在头文件中，可以内联到调用的地方
+        // 参数：要申请的大小
+        // 返回值：指向空间的指针，大小为0或申请失败时返回nullptr
+        static void *allocate_raw(size_t memory_size) noexcept
+        {
+            return thread_cache::GetInstance().allocate_raw(memory_size);
+        }
+
+        // 归还allocate_raw申请的空间，也可以归还allocate申请的空间
+        // 参数： start_p:内存开始的地址，可以为nullptr, size_t：这片地址的大小
+        static void deallocate_raw(void *start_p, size_t memory_size) noexcept
+        {
+            thread_cache::GetInstance().deallocate_raw(start_p, memory_size);
+        }
+
+        // 申请一块起始地址按alignment对齐的空间
+        // 不超过一页的对齐把大小向上取整到对齐的整数倍，由大小分级保证对齐：页面按页对齐，内存块的间隔是大小的整数倍
+        // 超过一页的对齐直接从page_cache申请按对齐切好的页面
+        // 参数：memory_size:要申请的大小 alignment:对齐，必须是2的幂
+        // 返回值：指向空间的指针，对齐不合法或申请失败时返回nullopt
+        static std::optional<void *> allocate_aligned(size_t memory_size, size_t alignment);
+
+        // 归还allocate_aligned申请的空间，大小和对齐必须与申请时一样
+        static void deallocate_aligned(void *start_p, size_t memory_size, size_t alignment);
+
+        // 调整一块空间的大小，内容会保留 min(old_size, new_size) 个字节
+        // 新的大小还在同一个分级中时直接返回原来的地址
+        // 大块内存会先尝试原地调整（吞并后面相邻的空闲页面，超大块使用mremap），失败时才重新申请并拷贝
+        // 参数：start_p:原来的地址，为nullptr时等同于allocate, old_size:原来的大小, new_size:新的大小
+        // 返回值：新的地址，失败时返回nullopt，原来的空间不会被释放；new_size为0时释放原来的空间并返回nullopt
+        static std::optional<void *> reallocate(void *start_p, size_t old_size, size_t new_size);
+
+        // 不移动地调整一块空间的大小，给vector一类的容器在扩容前尝试
+        // 小内存只有新旧大小在同一个分级中才能成功，大块内存会尝试吞并后面相邻的空闲页面，超大块使用不移动的mremap
+        // 成功以后必须用new_size归还
+        // 返回值：是否调整成功，失败时原来的空间保持不变
+        static bool try_expand(void *start_p, size_t old_size, size_t new_size);
+
+        // 向内存池归还一片空间，大小从page_map中查出来
+        // 参数： start_p:内存开始的地址，必须是allocate返回的地址
+        static void deallocate(void *start_p)
+        {
+            if (start_p == nullptr)
+            {
+                return;
+            }
+            page_span *span = page_map::GetInstance().get(start_p);
+            assert(span != nullptr);
+            deallocate_raw(start_p, span->unit_size());
         }
     };
 
@@ -0,0 +1,240 @@
+// 用内存池替换 malloc/free 等函数，编译成动态库以后可以通过 LD_PRELOAD 直接用在已有的程序上
+// 这里的函数会在进程初始化的很早阶段被调用（甚至早于这个库自己的全局构造函数），
+// 所以只能依赖按需初始化的单例，并且内存池内部的容器都使用 metadata_allocator，不会再回到malloc
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <pthread.h>
+#include <string>
+#include <unistd.h>
+
+#include "allocation_recorder.h"
+#include "central_cache.h"
+#include "heap_profiler.h"
+#include "latency.h"
+#include "memory_pool.h"
+#include "metadata_allocator.h"
+#include "page_cache.h"
+#include "page_map.h"
+
+namespace {
+    using memory_pool::size_utils;
+
+    // malloc返回的地址至少要满足 max_align_t 的对齐
+    constexpr size_t MALLOC_ALIGNMENT = alignof(std::max_align_t);
+
+    bool is_power_of_two(size_t value) {
+        return value != 0 && (value & (value - 1)) == 0;
+    }
+
+    // 申请满足对齐要求的内存，失败时返回nullptr
+    void* allocate_aligned(size_t size, size_t alignment) {
+        if (size == 0) {
+            size = 1;
+        }
+        alignment = std::max(alignment, MALLOC_ALIGNMENT);
+        try {
+            auto ret = memory_pool::memory_pool::allocate_aligned(size, alignment);
+            return ret.has_value() ? ret.value() : nullptr;
+        } catch (...) {
+            return nullptr;
+        }
+    }
+
+    // 获取一块内存实际可用的大小，不是内存池的地址返回0
+    size_t usable_size(void* ptr) {
+        memory_pool::page_span* span = memory_pool::page_map::GetInstance().get(ptr);
+        return span != nullptr ? span->unit_size() : 0;
+    }
+
+    void prepare_fork() {
+        // 加锁的顺序与内存池内部嵌套加锁的顺序一致
+        memory_pool::allocation_recorder::GetInstance().prepare_fork();
+        memory_pool::heap_profiler::GetInstance().prepare_fork();
+        memory_pool::central_cache::GetInstance().prepare_fork();
+        memory_pool::page_cache::GetInstance().prepare_fork();
+        memory_pool::page_map::GetInstance().prepare_fork();
+        memory_pool::metadata_arena::GetInstance().prepare_fork();
+        memory_pool::latency_recorder::GetInstance().prepare_fork();
+    }
+
+    void after_fork() {
+        memory_pool::latency_recorder::GetInstance().after_fork();
+        memory_pool::metadata_arena::GetInstance().after_fork();
+        memory_pool::page_map::GetInstance().after_fork();
+        memory_pool::page_cache::GetInstance().after_fork();
+        memory_pool::central_cache::GetInstance().after_fork();
+        memory_pool::heap_profiler::GetInstance().after_fork();
+    }
+
+    void after_fork_parent() {
+        after_fork();
+        memory_pool::allocation_recorder::GetInstance().after_fork();
+    }
+
+    // 子进程不继续记录申请和归还，否则会和父进程写同一个文件
+    void after_fork_child() {
+        after_fork();
+        memory_pool::allocation_recorder::GetInstance().after_fork_child();
+    }
+
+    __attribute__((constructor)) void register_fork_handlers() {
+        pthread_atfork(prepare_fork, after_fork_parent, after_fork_child);
+    }
+
+    // 设置了环境变量 MEMORY_POOL_ALLOCATION_TRACE_FILE 时，从启动开始记录每一次申请和归还，直到进程退出
+    // 文件名中的 %p 替换成进程号，这样exec出来的子进程不会覆盖同一个文件；需要编译时打开 MEMORY_POOL_ALLOCATION_TRACE
+    __attribute__((constructor)) void start_allocation_trace() {
+        const char* value = std::getenv("MEMORY_POOL_ALLOCATION_TRACE_FILE");
+        if (value == nullptr) {
+            return;
+        }
+        std::string path = value;
+        if (size_t position = path.find("%p"); position != std::string::npos) {
+            path.replace(position, 2, std::to_string(getpid()));
+        }
+        memory_pool::allocation_recorder::GetInstance().start(path);
+    }
+
+    __attribute__((destructor)) void stop_allocation_trace() {
+        if (memory_pool::allocation_recorder::enabled()) {
+            memory_pool::allocation_recorder::GetInstance().stop();
+        }
+    }
+
+    // 设置了环境变量 MEMORY_POOL_STATS_SEGMENT 时，每隔这么多毫秒把统计发布到共享内存中，可以用 mempool_top <pid> 查看
+    // 设为空或者不是正数时使用默认的间隔
+    __attribute__((constructor)) void start_stats_segment() {
+        const char* value = std::getenv("MEMORY_POOL_STATS_SEGMENT");
+        if (value == nullptr) {
+            return;
+        }
+        const long interval = std::strtol(value, nullptr, 10);
+        memory_pool::stats_segment::GetInstance().start(
+            interval > 0 ? std::chrono::milliseconds(interval) : memory_pool::stats_segment::DEFAULT_INTERVAL);
+    }
+
+    __attribute__((destructor)) void stop_stats_segment() {
+        memory_pool::stats_segment::GetInstance().stop();
+    }
+}
+
+extern "C" {
+    void* malloc(size_t size) noexcept {
+        void* result = allocate_aligned(size, MALLOC_ALIGNMENT);
+        if (result == nullptr) {
+            errno = ENOMEM;
+        }
+        return result;
+    }
+
+    void free(void* ptr) noexcept {
+        if (ptr == nullptr) {
+            return;
+        }
+        const size_t size = usable_size(ptr);
+        // 不是内存池分配的地址（比如在替换之前就已经分配好的），直接忽略
+        if (size == 0) {
+            return;
+        }
+        memory_pool::thread_cache::GetInstance().deallocate(ptr, size);
+    }
+
+    void* calloc(size_t count, size_t size) noexcept {
+        size_t total_size = 0;
+        if (__builtin_mul_overflow(count, size, &total_size)) {
+            errno = ENOMEM;
+            return nullptr;
+        }
+        void* result = malloc(total_size);
+        if (result != nullptr) {
+            // 内存池中复用的内存块不一定是清零过的
+            std::memset(result, 0, total_size);
+        }
+        return result;
+    }
+
+    void* realloc(void* ptr, size_t size) noexcept {
+        if (ptr == nullptr) {
+            return malloc(size);
+        }
+        if (size == 0) {
+            free(ptr);
+            return nullptr;
+        }
+        const size_t old_size = usable_size(ptr);
+        if (old_size == 0) {
+            // 不知道原来的大小，无法拷贝
+            errno = ENOMEM;
+            return nullptr;
+        }
+        const size_t new_size = size_utils::align(size, MALLOC_ALIGNMENT);
+        // 还在同一个内存块里面，直接返回
+        if (new_size <= old_size && new_size > old_size / 2) {
+            return ptr;
+        }
+        try {
+            auto ret = memory_pool::memory_pool::reallocate(ptr, old_size, new_size);
+            if (ret.has_value()) {
+                return ret.value();
+            }
+        } catch (...) {
+        }
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    int posix_memalign(void** memptr, size_t alignment, size_t size) noexcept {
+        if (!is_power_of_two(alignment) || alignment % sizeof(void*) != 0) {
+            return EINVAL;
+        }
+        void* result = allocate_aligned(size, alignment);
+        if (result == nullptr) {
+            return ENOMEM;
+        }
+        *memptr = result;
+        return 0;
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size) noexcept {
+        if (!is_power_of_two(alignment)) {
+            errno = EINVAL;
+            return nullptr;
+        }
+        void* result = allocate_aligned(size, alignment);
+        if (result == nullptr) {
+            errno = ENOMEM;
+        }
+        return result;
+    }
+
+    void* memalign(size_t alignment, size_t size) noexcept {
+        // 与glibc一致，不是2的幂的对齐向上取整
+        if (!is_power_of_two(alignment)) {
+            alignment = std::bit_ceil(alignment);
+        }
+        void* result = allocate_aligned(size, alignment);
+        if (result == nullptr) {
+            errno = ENOMEM;
+        }
+        return result;
+    }
+
+    void* valloc(size_t size) noexcept {
+        return memalign(size_utils::PAGE_SIZE, size);
+    }
+
+    void* pvalloc(size_t size) noexcept {
+        return memalign(size_utils::PAGE_SIZE, size_utils::align(size, size_utils::PAGE_SIZE));
+    }
+
+    size_t malloc_usable_size(void* ptr) noexcept {
+        return ptr == nullptr ? 0 : usable_size(ptr);
+    }
+}
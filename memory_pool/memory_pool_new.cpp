@@ -0,0 +1,96 @@
+// 用内存池替换全局的 operator new/delete，链接这个静态库以后整个程序的new/delete都会走内存池
+// 带大小的delete直接把大小交给线程缓存，不需要再从page_map中查找
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+
+#include "memory_pool.h"
+
+namespace {
+    // 申请内存，失败时返回nullptr，不调用new_handler
+    void* try_allocate(size_t size, size_t alignment) noexcept {
+        if (size == 0) {
+            size = 1;
+        }
+        try {
+            auto ret = memory_pool::memory_pool::allocate_aligned(size, alignment);
+            return ret.has_value() ? ret.value() : nullptr;
+        } catch (...) {
+            return nullptr;
+        }
+    }
+
+    // 与标准库的行为一致：失败时调用new_handler，没有new_handler时抛出std::bad_alloc
+    void* allocate_or_throw(size_t size, size_t alignment) {
+        while (true) {
+            void* result = try_allocate(size, alignment);
+            if (result != nullptr) {
+                return result;
+            }
+            std::new_handler handler = std::get_new_handler();
+            if (handler == nullptr) {
+                throw std::bad_alloc();
+            }
+            handler();
+        }
+    }
+
+    void* allocate_nothrow(size_t size, size_t alignment) noexcept {
+        try {
+            return allocate_or_throw(size, alignment);
+        } catch (...) {
+            return nullptr;
+        }
+    }
+
+    // 不知道大小时从page_map中查出来
+    void deallocate(void* ptr) noexcept {
+        memory_pool::memory_pool::deallocate(ptr);
+    }
+
+    // 带大小的释放，不需要再查找大小
+    void deallocate(void* ptr, size_t size, size_t alignment) noexcept {
+        memory_pool::memory_pool::deallocate_aligned(ptr, std::max(size, size_t{1}), alignment);
+    }
+
+    constexpr size_t DEFAULT_ALIGNMENT = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+}
+
+// 普通版本
+void* operator new(size_t size) { return allocate_or_throw(size, DEFAULT_ALIGNMENT); }
+void* operator new[](size_t size) { return allocate_or_throw(size, DEFAULT_ALIGNMENT); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate_nothrow(size, DEFAULT_ALIGNMENT); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate_nothrow(size, DEFAULT_ALIGNMENT); }
+
+void operator delete(void* ptr) noexcept { deallocate(ptr); }
+void operator delete[](void* ptr) noexcept { deallocate(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { deallocate(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { deallocate(ptr); }
+void operator delete(void* ptr, size_t size) noexcept { deallocate(ptr, size, DEFAULT_ALIGNMENT); }
+void operator delete[](void* ptr, size_t size) noexcept { deallocate(ptr, size, DEFAULT_ALIGNMENT); }
+
+// 对齐版本
+void* operator new(size_t size, std::align_val_t alignment) {
+    return allocate_or_throw(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return allocate_or_throw(size, static_cast<size_t>(alignment));
+}
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate_nothrow(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate_nothrow(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept { deallocate(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { deallocate(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { deallocate(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { deallocate(ptr); }
+void operator delete(void* ptr, size_t size, std::align_val_t alignment) noexcept {
+    deallocate(ptr, size, static_cast<size_t>(alignment));
+}
+void operator delete[](void* ptr, size_t size, std::align_val_t alignment) noexcept {
+    deallocate(ptr, size, static_cast<size_t>(alignment));
+}
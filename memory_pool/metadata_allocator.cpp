@@ -0,0 +1,62 @@
+#include "metadata_allocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <sys/mman.h>
+
+namespace memory_pool {
+    void* metadata_arena::allocate(size_t memory_size) {
+        memory_size = size_utils::align(std::max(memory_size, static_cast<size_t>(1)), ALIGNMENT);
+        if (memory_size > MAX_SMALL_SIZE) {
+            // 大块内存直接向系统申请
+            void* ptr = mmap(nullptr, size_utils::align(memory_size, size_utils::PAGE_SIZE), PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            m_mapped_bytes.fetch_add(size_utils::align(memory_size, size_utils::PAGE_SIZE), std::memory_order_relaxed);
+            return ptr;
+        }
+
+        const size_t index = memory_size / ALIGNMENT - 1;
+        atomic_flag_guard guard(m_status);
+        // 先从空闲链表中取
+        if (m_free_list[index] != nullptr) {
+            std::byte* result = m_free_list[index];
+            m_free_list[index] = *(reinterpret_cast<std::byte**>(result));
+            return result;
+        }
+        // 当前块不够了，申请一个新的块，剩下的部分直接丢弃
+        if (m_remaining < memory_size) {
+            void* ptr = mmap(nullptr, CHUNK_SIZE, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            m_current = static_cast<std::byte*>(ptr);
+            m_remaining = CHUNK_SIZE;
+            m_mapped_bytes.fetch_add(CHUNK_SIZE, std::memory_order_relaxed);
+        }
+        std::byte* result = m_current;
+        m_current += memory_size;
+        m_remaining -= memory_size;
+        return result;
+    }
+
+    void metadata_arena::deallocate(void* memory, size_t memory_size) {
+        if (memory == nullptr) {
+            return;
+        }
+        memory_size = size_utils::align(std::max(memory_size, static_cast<size_t>(1)), ALIGNMENT);
+        if (memory_size > MAX_SMALL_SIZE) {
+            munmap(memory, size_utils::align(memory_size, size_utils::PAGE_SIZE));
+            m_mapped_bytes.fetch_sub(size_utils::align(memory_size, size_utils::PAGE_SIZE), std::memory_order_relaxed);
+            return;
+        }
+
+        const size_t index = memory_size / ALIGNMENT - 1;
+        atomic_flag_guard guard(m_status);
+        *(reinterpret_cast<std::byte**>(memory)) = m_free_list[index];
+        m_free_list[index] = static_cast<std::byte*>(memory);
+    }
+} // memory_pool
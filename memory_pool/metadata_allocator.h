@@ -0,0 +1,101 @@
+#ifndef METADATA_ALLOCATOR_H
+#define METADATA_ALLOCATOR_H
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <new>
+#include <set>
+#include <vector>
+
+#include "utils.h"
+
+namespace memory_pool
+{
+
+    // 内存池内部数据结构（map、set、vector）使用的内存
+    // 直接向系统申请，不经过malloc/new，这样内存池替换了malloc以后也不会递归调用到自己
+    // 小块内存按16字节分级，用空闲链表复用，只会增长不会还给系统；大块内存直接mmap/munmap
+    class metadata_arena
+    {
+    public:
+        static constexpr size_t ALIGNMENT = 16;
+        static constexpr size_t MAX_SMALL_SIZE = 4096;
+        static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+        // 所有成员都可以在编译期初始化，也不需要析构，所以在进程最早和最晚的时候都可以使用
+        static metadata_arena &GetInstance()
+        {
+            static metadata_arena instance;
+            return instance;
+        }
+
+        // 申请内存，失败时抛出std::bad_alloc
+        void *allocate(size_t memory_size);
+
+        // 归还内存，大小必须和申请时一样
+        void deallocate(void *memory, size_t memory_size);
+
+        // 向系统申请的字节数，用于统计
+        size_t mapped_bytes() const { return m_mapped_bytes.load(std::memory_order_relaxed); }
+
+        // fork之前加锁，fork之后在父子进程中解锁
+        void prepare_fork()
+        {
+            while (m_status.test_and_set(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+        }
+        void after_fork() { m_status.clear(std::memory_order_release); }
+
+    private:
+        constexpr metadata_arena() = default;
+
+        // 每一级的空闲链表
+        std::array<std::byte *, MAX_SMALL_SIZE / ALIGNMENT> m_free_list = {};
+        // 当前正在切分的块
+        std::byte *m_current = nullptr;
+        // 当前块剩余的长度
+        size_t m_remaining = 0;
+        std::atomic_flag m_status;
+        // 向系统申请的字节数
+        std::atomic<size_t> m_mapped_bytes = 0;
+    };
+
+    // 满足 Allocator 要求的分配器，所有内部容器都使用这个分配器
+    template <typename T>
+    class metadata_allocator
+    {
+    public:
+        using value_type = T;
+
+        metadata_allocator() = default;
+        template <typename U>
+        metadata_allocator(const metadata_allocator<U> &) noexcept {}
+
+        T *allocate(size_t n)
+        {
+            return static_cast<T *>(metadata_arena::GetInstance().allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T *p, size_t n)
+        {
+            metadata_arena::GetInstance().deallocate(p, n * sizeof(T));
+        }
+
+        template <typename U>
+        bool operator==(const metadata_allocator<U> &) const noexcept { return true; }
+    };
+
+    // 使用内部分配器的容器
+    template <typename Key, typename Value>
+    using metadata_map = std::map<Key, Value, std::less<Key>, metadata_allocator<std::pair<const Key, Value>>>;
+    template <typename Key>
+    using metadata_set = std::set<Key, std::less<Key>, metadata_allocator<Key>>;
+    template <typename T>
+    using metadata_vector = std::vector<T, metadata_allocator<T>>;
+
+} // memory_pool
+
+#endif // METADATA_ALLOCATOR_H
@@ -0,0 +1,60 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+#include <cstddef>
+#include <new>
+#include <utility>
+
+#include "pool_allocator.h"
+#include "thread_cache.h"
+#include "utils.h"
+
+namespace memory_pool
+{
+
+    // 某一种类型的对象池，大小对应的分级在编译期确定，创建和销毁都是常数时间
+    // 对象池本身不保存状态，所有的实例共享同一个内存池，可以在一个线程中创建，在另一个线程中销毁
+    template <typename T>
+    class object_pool
+    {
+    public:
+        // 在内存池中创建一个对象，申请失败或者构造函数抛出异常时抛出对应的异常
+        template <typename... Args>
+        [[nodiscard]] T *create(Args &&...args)
+        {
+            T *memory = m_allocator.allocate(1);
+            try
+            {
+                return ::new (static_cast<void *>(memory)) T(std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                m_allocator.deallocate(memory, 1);
+                throw;
+            }
+        }
+
+        // 析构并归还一个create创建的对象，nullptr直接忽略
+        void destroy(T *object) noexcept
+        {
+            if (object == nullptr)
+            {
+                return;
+            }
+            object->~T();
+            m_allocator.deallocate(object, 1);
+        }
+
+        // 预先在当前线程的线程缓存中准备好object_count个空闲的内存块，之后的create不会再走慢路径
+        // 个数不会超过线程缓存一个列表的上限，大对象不在线程缓存中缓存，返回false
+        bool reserve(size_t object_count)
+        {
+            return thread_cache::GetInstance().reserve(sizeof(T), object_count);
+        }
+
+    private:
+        [[no_unique_address]] pool_allocator<T> m_allocator;
+    };
+
+} // memory_pool
+
+#endif // OBJECT_POOL_H
@@ -1,8 +1,13 @@
 // created by wei on 2025-5-26
 
 #include "page_cache.h"
+#include "event_tracer.h"
+#include "latency.h"
+#include "page_map.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <mutex>
@@ -14,7 +19,9 @@ namespace memory_pool {
         if (page_count == 0) {
             return std::nullopt;
         }
-        std::unique_lock<std::mutex> guard(m_mutex);
+        latency_timer timer(latency_site::page_allocate);
+        std::unique_lock<profiled_mutex> guard(m_mutex);
+        m_page_allocate_count.fetch_add(1, std::memory_order_relaxed);
 
         auto it = free_page_store.lower_bound(page_count);
         while (it != free_page_store.end()) {
@@ -29,7 +36,9 @@ namespace memory_pool {
                 size_t memory_to_use = page_count * size_utils::PAGE_SIZE;
                 memory_span memory = free_memory.subspan(0, memory_to_use);
                 free_memory = free_memory.subspan(memory_to_use);
+                m_free_bytes.fetch_sub(memory_to_use, std::memory_order_relaxed);
                 if (free_memory.size()) {
+                    trace_instant(trace_event_type::page_split, memory_to_use, free_memory.size());
                     // 如果还有空间，则插回到缓存中
                     free_page_store[free_memory.size() / size_utils::PAGE_SIZE].emplace(free_memory);
                     free_page_map.emplace(free_memory.data(), free_memory);
@@ -49,9 +58,11 @@ namespace memory_pool {
             memory_span result = memory.subspan(0, memory_to_use);
             memory_span free_memory = memory.subspan(memory_to_use);
             if (free_memory.size()) {
+                trace_instant(trace_event_type::page_split, memory_to_use, free_memory.size());
                 size_t index = free_memory.size() / size_utils::PAGE_SIZE;
                 free_page_store[index].emplace(free_memory);
                 free_page_map.emplace(free_memory.data(), free_memory);
+                m_free_bytes.fetch_add(free_memory.size(), std::memory_order_relaxed);
             }
             return result;
         });
@@ -61,8 +72,41 @@ namespace memory_pool {
 
         // 应该是一页一页的回收的，所以大小一定是会被整除的
         assert(page.size() % size_utils::PAGE_SIZE == 0);
-        std::unique_lock<std::mutex> guard(m_mutex);
+        latency_timer timer(latency_site::page_deallocate);
+        std::unique_lock<profiled_mutex> guard(m_mutex);
+        m_page_deallocate_count.fetch_add(1, std::memory_order_relaxed);
+        insert_free_page(page);
+    }
+
+    void page_cache::deallocate_pages(std::span<const memory_span> pages) {
+        latency_timer timer(latency_site::page_deallocate);
+        std::unique_lock<profiled_mutex> guard(m_mutex);
+        m_page_deallocate_count.fetch_add(pages.size(), std::memory_order_relaxed);
+        for (const memory_span& page : pages) {
+            assert(page.size() % size_utils::PAGE_SIZE == 0);
+            insert_free_page(page);
+        }
+    }
+
+    bool page_cache::prefault_page(size_t page_count) {
+        if (page_count == 0) {
+            return true;
+        }
+        std::unique_lock<profiled_mutex> guard(m_mutex);
+        // system_allocate_memory会把整块内存清零，每一页都会被触碰到
+        auto ret = system_allocate_memory(page_count);
+        if (!ret.has_value()) {
+            return false;
+        }
+        page_vector.push_back(ret.value());
+        insert_free_page(ret.value());
+        return true;
+    }
 
+    void page_cache::insert_free_page(memory_span page) {
+        // 合并进来的相邻页面已经计算过了
+        m_free_bytes.fetch_add(page.size(), std::memory_order_relaxed);
+        const size_t inserted_size = page.size();
         // 检查前面相邻的span
         // 只有在集合不空的时候才会考虑合并
         while (!free_page_map.empty()) {
@@ -101,30 +145,260 @@ namespace memory_pool {
                 break;
             }
         }
+        if (page.size() != inserted_size) {
+            trace_instant(trace_event_type::page_coalesce, page.size(), inserted_size);
+        }
         size_t index = page.size() / size_utils::PAGE_SIZE;
         free_page_store[index].emplace(page);
         free_page_map.emplace(page.data(), page);
     }
 
-    std::optional<memory_span> page_cache::allocate_unit(size_t memory_size) {
-        auto ret = malloc(memory_size);
-        if (ret != nullptr) {
-            return memory_span { static_cast<std::byte*>(ret), memory_size};
+    std::optional<memory_span> page_cache::allocate_unit(size_t memory_size, size_t alignment) {
+        if (memory_size == 0) {
+            return std::nullopt;
         }
-        return std::nullopt;
+        // 对齐必须是2的幂，页面本身就是按页对齐的
+        assert((alignment & (alignment - 1)) == 0);
+        alignment = std::max(alignment, size_utils::PAGE_SIZE);
+        const size_t page_count = size_utils::align(memory_size, size_utils::PAGE_SIZE) / size_utils::PAGE_SIZE;
+        // 需要更大的对齐时多申请一些页面，再把前后多出来的部分还回去
+        const size_t extra_page_count = alignment / size_utils::PAGE_SIZE - 1;
+        // 超大块内存单独向系统申请，普通的大块内存从页面缓存中切分
+        const bool is_huge = memory_size > HUGE_UNIT_SIZE;
+        auto ret = is_huge ? system_map_memory(page_count + extra_page_count)
+                           : allocate_page(page_count + extra_page_count);
+        if (!ret.has_value()) {
+            return std::nullopt;
+        }
+        memory_span memory = ret.value();
+
+        std::unique_lock<profiled_mutex> guard(m_mutex);
+        if (extra_page_count != 0) {
+            const auto address = reinterpret_cast<std::uintptr_t>(memory.data());
+            const size_t head_size = size_utils::align(address, alignment) - address;
+            memory_span head = memory.subspan(0, head_size);
+            memory_span tail = memory.subspan(head_size + page_count * size_utils::PAGE_SIZE);
+            memory = memory.subspan(head_size, page_count * size_utils::PAGE_SIZE);
+            for (memory_span rest : {head, tail}) {
+                if (rest.size() == 0) {
+                    continue;
+                }
+                if (is_huge) {
+                    system_deallocate_memory(rest);
+                } else {
+                    insert_free_page(rest);
+                }
+            }
+        }
+
+        insert_unit(memory);
+        m_large_unit_count.fetch_add(1, std::memory_order_relaxed);
+        m_large_unit_bytes.fetch_add(memory.size(), std::memory_order_relaxed);
+        return memory;
+    }
+
+    void page_cache::insert_unit(memory_span memory) {
+        // 一个大块内存就是只有一个单元的page_span
+        auto [it, succeed] = m_unit_map.try_emplace(memory.data(), memory, memory.size());
+        assert(succeed == true);
+        it->second.allocate(memory);
+        // 大块内存只会以起始地址归还，所以只需要记录第一页
+        page_map::GetInstance().set(memory.subspan(0, size_utils::PAGE_SIZE), &it->second);
     }
 
     void page_cache::deallocate_unit(memory_span memories) {
-        free(memories.data());
+        std::unique_lock<profiled_mutex> guard(m_mutex);
+        auto it = m_unit_map.find(memories.data());
+        // 如果找不到，说明释放了不是从这里分配的内存
+        assert(it != m_unit_map.end());
+        memory_span memory = it->second.get_memory_span();
+        assert(memories.size() <= memory.size());
+        page_map::GetInstance().clear(memory.subspan(0, size_utils::PAGE_SIZE));
+        m_unit_map.erase(it);
+        m_large_unit_count.fetch_sub(1, std::memory_order_relaxed);
+        m_large_unit_bytes.fetch_sub(memory.size(), std::memory_order_relaxed);
+        guard.unlock();
+
+        if (memory.size() > HUGE_UNIT_SIZE) {
+            system_deallocate_memory(memory);
+        } else {
+            deallocate_page(memory);
+        }
+    }
+
+    std::optional<memory_span> page_cache::reallocate_unit(memory_span unit, size_t new_size, bool may_move) {
+        if (new_size == 0) {
+            return std::nullopt;
+        }
+        const size_t new_page_count = size_utils::align(new_size, size_utils::PAGE_SIZE) / size_utils::PAGE_SIZE;
+        const size_t new_memory_size = new_page_count * size_utils::PAGE_SIZE;
+
+        std::unique_lock<profiled_mutex> guard(m_mutex);
+        auto it = m_unit_map.find(unit.data());
+        assert(it != m_unit_map.end());
+        memory_span memory = it->second.get_memory_span();
+        // 超大块和普通大块之间的转换需要换一种管理方式，交给调用者拷贝
+        if ((memory.size() > HUGE_UNIT_SIZE) != (new_size > HUGE_UNIT_SIZE)) {
+            return std::nullopt;
+        }
+        if (new_memory_size == memory.size()) {
+            return memory;
+        }
+
+        // 先把这个单元从记录中移除，调整以后再按新的地址和大小记录
+        page_map::GetInstance().clear(memory.subspan(0, size_utils::PAGE_SIZE));
+        m_unit_map.erase(it);
+
+        std::optional<memory_span> result;
+        if (memory.size() > HUGE_UNIT_SIZE) {
+            // 超大块内存是单独映射的，直接让内核调整页表，必要时搬到新的地址，不需要拷贝数据
+            // mremap在很大的内存上可能要很久，不持有锁调用，否则所有的页面申请和归还都要等它
+            // 这个单元只属于调用者，移出记录以后不会有其他线程访问它
+            guard.unlock();
+            void* ptr = nullptr;
+            {
+                latency_timer timer(latency_site::system_map);
+                trace_scope trace(trace_event_type::system_map, new_memory_size);
+                ptr = mremap(memory.data(), memory.size(), new_memory_size, may_move ? MREMAP_MAYMOVE : 0);
+            }
+            guard.lock();
+            if (ptr != MAP_FAILED) {
+                m_mapped_bytes.fetch_add(new_memory_size, std::memory_order_relaxed);
+                m_mapped_bytes.fetch_sub(memory.size(), std::memory_order_relaxed);
+                result = memory_span{static_cast<std::byte*>(ptr), new_memory_size};
+            }
+        } else if (new_memory_size < memory.size()) {
+            // 缩小时把尾部的页面还回去
+            insert_free_page(memory.subspan(new_memory_size));
+            result = memory.subspan(0, new_memory_size);
+        } else {
+            // 扩大时只能吞并紧挨着的空闲页面
+            auto next = free_page_map.find(memory.data() + memory.size());
+            if (next != free_page_map.end() && memory.size() + next->second.size() >= new_memory_size) {
+                memory_span next_memory = next->second;
+                free_page_store[next_memory.size() / size_utils::PAGE_SIZE].erase(next_memory);
+                free_page_map.erase(next);
+                m_free_bytes.fetch_sub(new_memory_size - memory.size(), std::memory_order_relaxed);
+                // 多出来的部分再放回去，它的后面一定不是空闲页面（否则早就合并了），所以不需要再合并
+                memory_span rest = next_memory.subspan(new_memory_size - memory.size());
+                if (rest.size()) {
+                    free_page_store[rest.size() / size_utils::PAGE_SIZE].emplace(rest);
+                    free_page_map.emplace(rest.data(), rest);
+                }
+                result = memory_span{memory.data(), new_memory_size};
+            }
+        }
+
+        // 重新记录这个单元，调整失败时按原来的地址和大小记录
+        if (!result.has_value()) {
+            insert_unit(memory);
+            return std::nullopt;
+        }
+        m_large_unit_bytes.fetch_add(result->size(), std::memory_order_relaxed);
+        m_large_unit_bytes.fetch_sub(memory.size(), std::memory_order_relaxed);
+        insert_unit(*result);
+        return result;
+    }
+
+    bool page_cache::reserve_address_space(size_t size) {
+        size = size_utils::align(size, size_utils::PAGE_SIZE);
+        std::unique_lock<profiled_mutex> guard(m_mutex);
+        // 至少要能放下一次向系统申请的页面
+        if (size < PAGE_ALLOCATE_COUNT * size_utils::PAGE_SIZE) {
+            return false;
+        }
+        if (!reserve_region(size)) {
+            return false;
+        }
+        m_region_size = size;
+        return true;
+    }
+
+    bool page_cache::owns(const void* ptr) const {
+        return in_reserved_region(ptr) || page_map::GetInstance().get(ptr) != nullptr;
+    }
+
+    bool page_cache::in_reserved_region(const void* ptr) const {
+        const size_t region_count = m_region_count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < region_count; i++) {
+            const memory_span& reserved = m_regions[i].reserved;
+            if (ptr >= reserved.data() && ptr < reserved.data() + reserved.size()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool page_cache::reserve_region(size_t size) {
+        const size_t region_count = m_region_count.load(std::memory_order_relaxed);
+        if (region_count == MAX_REGION_COUNT) {
+            return false;
+        }
+        // 只预留地址，不占用物理内存，也不计入提交的内存
+        void* ptr = mmap(nullptr, size, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return false;
+        }
+        m_regions[region_count] = address_region{memory_span{static_cast<std::byte*>(ptr), size}, 0};
+        m_reserved_bytes.fetch_add(size, std::memory_order_relaxed);
+        m_region_count.store(region_count + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::optional<memory_span> page_cache::commit_reserved_memory(size_t page_count) {
+        const size_t size = page_count * size_utils::PAGE_SIZE;
+        const size_t region_count = m_region_count.load(std::memory_order_relaxed);
+        if (region_count == 0 || size > m_region_size) {
+            return std::nullopt;
+        }
+        address_region* region = &m_regions[region_count - 1];
+        if (region->committed_size + size > region->reserved.size()) {
+            // 当前的区域用完了，再预留一个新的区域
+            if (!reserve_region(m_region_size)) {
+                return std::nullopt;
+            }
+            region = &m_regions[region_count];
+        }
+        memory_span memory = region->reserved.subspan(region->committed_size, size);
+        {
+            latency_timer timer(latency_site::system_map);
+            trace_scope trace(trace_event_type::system_map, memory.size());
+            if (mprotect(memory.data(), memory.size(), PROT_READ | PROT_WRITE) != 0) {
+                return std::nullopt;
+            }
+        }
+        region->committed_size += size;
+        m_mapped_bytes.fetch_add(size, std::memory_order_relaxed);
+        return memory;
     }
 
     void page_cache::stop() {
-        std::unique_lock<std::mutex> guard(m_mutex);
+        std::unique_lock<profiled_mutex> guard(m_mutex);
         if (m_stop == false) {
             m_stop = true;
             for (auto& i : page_vector) {
-                system_deallocate_memory(i);
+                // 预留区域中的内存最后整体归还
+                if (!in_reserved_region(i.data())) {
+                    system_deallocate_memory(i);
+                }
+            }
+            for (size_t i = 0; i < m_region_count.load(std::memory_order_relaxed); i++) {
+                system_deallocate_memory(m_regions[i].reserved);
+            }
+            // 超大块内存不在page_vector中，需要单独归还
+            for (auto& [_, unit] : m_unit_map) {
+                page_map::GetInstance().clear(unit.get_memory_span().subspan(0, size_utils::PAGE_SIZE));
+                if (unit.size() > HUGE_UNIT_SIZE) {
+                    system_deallocate_memory(unit.get_memory_span());
+                }
             }
+            m_unit_map.clear();
+            m_mapped_bytes.store(0, std::memory_order_relaxed);
+            m_reserved_bytes.store(0, std::memory_order_relaxed);
+            m_free_bytes.store(0, std::memory_order_relaxed);
+            m_large_unit_count.store(0, std::memory_order_relaxed);
+            m_large_unit_bytes.store(0, std::memory_order_relaxed);
         }
     }
 
@@ -133,19 +407,104 @@ namespace memory_pool {
     }
 
     std::optional<memory_span> page_cache::system_allocate_memory(size_t page_count) {
+        // 如果预留了地址空间，则优先从预留的区域中提交
+        auto ret = commit_reserved_memory(page_count);
+        if (!ret.has_value()) {
+            ret = system_map_memory(page_count);
+        }
+        return ret.transform([](memory_span memory) {
+            // 清零内存
+            memset(memory.data(), 0, memory.size());
+            return memory;
+        });
+    }
+
+    std::optional<memory_span> page_cache::system_map_memory(size_t page_count) {
         const size_t size = page_count * size_utils::PAGE_SIZE;
 
         // 使用mmap分配内存
+        latency_timer timer(latency_site::system_map);
+        trace_scope trace(trace_event_type::system_map, size);
         void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
         if (ptr == MAP_FAILED) return std::nullopt;
-
-        // 清零内存
-        memset(ptr, 0, size);
+        m_mapped_bytes.fetch_add(size, std::memory_order_relaxed);
+        m_system_map_count.fetch_add(1, std::memory_order_relaxed);
         return memory_span{static_cast<std::byte*>(ptr), size};
     }
 
     void page_cache::system_deallocate_memory(memory_span page) {
+        latency_timer timer(latency_site::system_unmap);
+        trace_scope trace(trace_event_type::system_unmap, page.size());
         munmap(page.data(), page.size());
+        m_mapped_bytes.fetch_sub(page.size(), std::memory_order_relaxed);
+        m_system_unmap_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t page_cache::copy_free_pages(std::byte* start, size_t max_count, metadata_vector<memory_span>& output) {
+        // 调用的一方已经留好了位置，持有锁时不再申请内存
+        assert(output.capacity() - output.size() >= max_count);
+        std::unique_lock<profiled_mutex> guard(m_mutex);
+        size_t copied = 0;
+        for (auto it = free_page_map.lower_bound(start); it != free_page_map.end() && copied < max_count;
+             ++it, ++copied) {
+            output.push_back(it->second);
+        }
+        return copied;
+    }
+
+    size_t page_cache::copy_chunks(size_t start_index, size_t max_count, metadata_vector<memory_span>& output) {
+        assert(output.capacity() - output.size() >= max_count);
+        std::unique_lock<profiled_mutex> guard(m_mutex);
+        // page_vector只会在末尾追加，按下标分批读取不会漏掉或重复
+        size_t copied = 0;
+        for (size_t i = start_index; i < page_vector.size() && copied < max_count; i++, copied++) {
+            output.push_back(page_vector[i]);
+        }
+        return copied;
+    }
+
+    page_cache_stats page_cache::get_stats() {
+        page_cache_stats stats;
+        stats.mapped_bytes = m_mapped_bytes.load(std::memory_order_relaxed);
+        stats.reserved_bytes = m_reserved_bytes.load(std::memory_order_relaxed);
+        stats.free_bytes = m_free_bytes.load(std::memory_order_relaxed);
+        stats.large_unit_count = m_large_unit_count.load(std::memory_order_relaxed);
+        stats.large_unit_bytes = m_large_unit_bytes.load(std::memory_order_relaxed);
+        stats.page_allocate_count = m_page_allocate_count.load(std::memory_order_relaxed);
+        stats.page_deallocate_count = m_page_deallocate_count.load(std::memory_order_relaxed);
+        stats.system_map_count = m_system_map_count.load(std::memory_order_relaxed);
+        stats.system_unmap_count = m_system_unmap_count.load(std::memory_order_relaxed);
+        stats.lock = m_mutex.counters().get_stats();
+
+        // 只在锁中复制映射的范围，查询驻留情况的系统调用放在锁外
+        metadata_vector<memory_span> mappings;
+        {
+            std::unique_lock<profiled_mutex> guard(m_mutex);
+            mappings.reserve(page_vector.size() + m_unit_map.size());
+            mappings.insert(mappings.end(), page_vector.begin(), page_vector.end());
+            for (auto& [_, unit] : m_unit_map) {
+                // 超大块内存不在page_vector中
+                if (unit.size() > HUGE_UNIT_SIZE) {
+                    mappings.push_back(unit.get_memory_span());
+                }
+            }
+        }
+        std::array<unsigned char, PAGE_ALLOCATE_COUNT> residency;
+        for (const memory_span& mapping : mappings) {
+            for (size_t offset = 0; offset < mapping.size(); offset += residency.size() * size_utils::PAGE_SIZE) {
+                const size_t length = std::min(mapping.size() - offset, residency.size() * size_utils::PAGE_SIZE);
+                // 超大块内存可能已经被其他线程释放了，这时跳过
+                if (mincore(mapping.data() + offset, length, residency.data()) != 0) {
+                    break;
+                }
+                for (size_t i = 0; i < length / size_utils::PAGE_SIZE; i++) {
+                    if (residency[i] & 1) {
+                        stats.resident_bytes += size_utils::PAGE_SIZE;
+                    }
+                }
+            }
+        }
+        return stats;
     }
 } // memory_pool
\ No newline at end of file
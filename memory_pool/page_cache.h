@@ -2,27 +2,68 @@
 
 #ifndef PAGE_CACHE_H
 #define PAGE_CACHE_H
+#include <array>
 #include <atomic>
 #include <cstddef>
-#include <map>
+#include <mutex>
+#include <new>
 #include <span>
 #include <optional>
-#include <set>
-#include <vector>
 
+#include "lock_profiler.h"
+#include "metadata_allocator.h"
 #include "utils.h"
 
 namespace memory_pool
 {
 
+    // 页缓存的统计
+    struct page_cache_stats
+    {
+        // 从系统映射并提交的字节数（不包括只预留的地址空间）
+        size_t mapped_bytes = 0;
+        // 映射的内存中实际驻留在物理内存中的字节数
+        size_t resident_bytes = 0;
+        // 预留的地址空间
+        size_t reserved_bytes = 0;
+        // 空闲页面的字节数
+        size_t free_bytes = 0;
+        // 分配出去的大块内存
+        size_t large_unit_count = 0;
+        size_t large_unit_bytes = 0;
+        // 累计的操作次数
+        size_t page_allocate_count = 0;
+        size_t page_deallocate_count = 0;
+        size_t system_map_count = 0;
+        size_t system_unmap_count = 0;
+        // 页缓存的锁的争用情况
+        lock_stats lock;
+    };
+
     class page_cache
     {
+        // 独立的堆拥有自己的页缓存
+        friend class heap;
+
     public:
         static constexpr size_t PAGE_ALLOCATE_COUNT = 2048;
+        // 超过这个大小的内存单独向系统申请，释放时直接还给系统，避免把8MB的块切得太碎
+        static constexpr size_t HUGE_UNIT_SIZE = PAGE_ALLOCATE_COUNT * size_utils::PAGE_SIZE / 2;
+        // 预留地址空间时默认的大小，64GB
+        static constexpr size_t DEFAULT_RESERVE_SIZE = size_t{64} * 1024 * 1024 * 1024;
+        // 最多预留的区域个数，全部用完以后退回到直接mmap
+        static constexpr size_t MAX_REGION_COUNT = 16;
         static page_cache &GetInstance()
         {
+#ifdef MEMORY_POOL_NO_DESTROY
+            // 替换malloc时，进程退出的最后阶段仍然可能有释放，所以永远不析构
+            alignas(page_cache) static std::byte storage[sizeof(page_cache)];
+            static page_cache *instance = new (storage) page_cache();
+            return *instance;
+#else
             static page_cache instance;
             return instance;
+#endif
         }
 
         // 申请指定页数的内存
@@ -32,32 +73,118 @@ namespace memory_pool
         // 回收指定页数的内存
         void deallocate_page(memory_span page);
 
-        // 分配一个单元的内存，用于处理超大块内存
-        std::optional<memory_span> allocate_unit(size_t memory_size);
-        // 回收一个单元的内存，用于回收超大块内存
+        // 一次回收多段页面，只加一次锁，用于arena整体释放
+        void deallocate_pages(std::span<const memory_span> pages);
+
+        // 预先向系统申请指定页数的内存并触碰每一页，放入空闲页面中，用于预热
+        // 之后的申请直接使用这些页面，不会再有系统调用和缺页
+        bool prefault_page(size_t page_count);
+
+        // 分配一个单元的内存，用于处理大块内存，按页分配并记录到page_map中
+        // 超过HUGE_UNIT_SIZE的内存单独mmap
+        // 参数：memory_size:大小 alignment:起始地址的对齐，2的幂，不超过一页时不需要额外处理
+        std::optional<memory_span> allocate_unit(size_t memory_size, size_t alignment = size_utils::PAGE_SIZE);
+        // 回收一个单元的内存，只需要起始地址正确，大小以分配时记录的为准
         void deallocate_unit(memory_span memories);
 
-        // 关闭内存池
+        // 不拷贝数据地调整一个单元的大小
+        // 超大块内存使用mremap，普通大块内存缩小时归还尾部页面，扩大时吞并后面相邻的空闲页面
+        // 参数：may_move:超大块内存是否允许mremap搬到新的地址
+        // 返回值：调整后的内存，无法原地调整时返回nullopt，原来的内存保持不变
+        std::optional<memory_span> reallocate_unit(memory_span unit, size_t new_size, bool may_move = true);
+
+        // 预留一段连续的虚拟地址空间（PROT_NONE, MAP_NORESERVE），之后向系统申请的页面都从这里按需提交
+        // 一个区域用完以后会再预留一个同样大小的区域，应当在程序启动、开始分配之前调用
+        // 参数：要预留的字节数，会按页面对齐
+        // 返回值：是否预留成功，失败时继续使用原来的方式向系统申请
+        bool reserve_address_space(size_t size = DEFAULT_RESERVE_SIZE);
+
+        // 判断一个地址是不是内存池分配出去的
+        // 预留区域内的地址只需要比较范围，其他的地址再查页表
+        bool owns(const void *ptr) const;
+
+        // 获取统计，计数器不加锁地读取，驻留的字节数需要在锁中复制一次映射的范围，再用mincore查询
+        page_cache_stats get_stats();
+
+        // 复制一批空闲页面，按地址排列，每次只持有锁复制max_count段，用于在线生成碎片报告
+        // 参数：start: 从起始地址不小于这个地址的空闲页面开始 output: 追加到这里，调用前至少要留出max_count个位置
+        // 返回值：复制的个数，小于max_count时说明已经复制到了最后一段
+        size_t copy_free_pages(std::byte *start, size_t max_count, metadata_vector<memory_span> &output);
+
+        // 复制一批向系统申请的内存块（一般为8MB），不包括超大块内存
+        // 参数：start_index: 从第几块开始 output: 追加到这里，调用前至少要留出max_count个位置
+        // 返回值：复制的个数，小于max_count时说明已经复制到了最后一块
+        size_t copy_chunks(size_t start_index, size_t max_count, metadata_vector<memory_span> &output);
+
+        // 关闭内存池，所有向系统申请的内存一次归还
         void stop();
 
+        // fork之前加锁，fork之后在父子进程中解锁，避免子进程继承一把被其他线程持有的锁
+        void prepare_fork() { m_mutex.lock(); }
+        void after_fork() { m_mutex.unlock(); }
+
         ~page_cache();
 
     private:
         // 只申请，不回收，只有在销毁时回收
         std::optional<memory_span> system_allocate_memory(size_t page_count);
 
-        // 回收内存，只有在析构函数中调用
+        // 回收内存，只有在析构函数和释放超大块内存时调用
         void system_deallocate_memory(memory_span page);
 
+        // 预留的一段地址空间
+        struct address_region
+        {
+            // 整个预留的范围
+            memory_span reserved = {nullptr, 0};
+            // 已经提交了的长度，提交是从前往后进行的
+            size_t committed_size = 0;
+        };
+
+        // 从预留区域中提交指定页数的内存，没有预留或者预留的区域已经用完时返回nullopt
+        std::optional<memory_span> commit_reserved_memory(size_t page_count);
+
+        // 预留一个新的区域，调用前需要持有锁
+        bool reserve_region(size_t size);
+
+        // 判断地址是不是在预留区域中
+        bool in_reserved_region(const void *ptr) const;
+
+        // 将页面放回空闲页面中，并与前后相邻的空闲页面合并，调用前需要持有锁
+        void insert_free_page(memory_span page);
+
+        // 记录一个大块内存单元，并在页面映射中登记它的第一页，调用前需要持有锁
+        void insert_unit(memory_span memory);
+
+        // 向系统申请指定页数的内存，不做清零
+        std::optional<memory_span> system_map_memory(size_t page_count);
+
         page_cache() = default;
-        std::map<size_t, std::set<memory_span>> free_page_store = {};
-        std::map<std::byte *, memory_span> free_page_map = {};
+        metadata_map<size_t, metadata_set<memory_span>> free_page_store = {};
+        metadata_map<std::byte *, memory_span> free_page_map = {};
         // 用于回收时 munmap
-        std::vector<memory_span> page_vector = {};
+        metadata_vector<memory_span> page_vector = {};
+        // 分配出去的大块内存，key为起始地址
+        metadata_map<std::byte *, page_span> m_unit_map = {};
+        // 预留的区域，只会追加，不会移除，所以可以不加锁地读取前m_region_count个
+        std::array<address_region, MAX_REGION_COUNT> m_regions = {};
+        std::atomic<size_t> m_region_count = 0;
+        // 每一个区域的大小
+        size_t m_region_size = 0;
+        // 统计用的计数器，在锁中更新，读取时不需要加锁
+        std::atomic<size_t> m_mapped_bytes = 0;
+        std::atomic<size_t> m_reserved_bytes = 0;
+        std::atomic<size_t> m_free_bytes = 0;
+        std::atomic<size_t> m_large_unit_count = 0;
+        std::atomic<size_t> m_large_unit_bytes = 0;
+        std::atomic<size_t> m_page_allocate_count = 0;
+        std::atomic<size_t> m_page_deallocate_count = 0;
+        std::atomic<size_t> m_system_map_count = 0;
+        std::atomic<size_t> m_system_unmap_count = 0;
         // 表示当前的内存池是不是已经关闭了
         bool m_stop = false;
-        // 并发控制
-        std::mutex m_mutex;
+        // 并发控制，同时记录争用情况
+        profiled_mutex m_mutex;
     };
 
 } // memory_pool
@@ -0,0 +1,64 @@
+#include "page_map.h"
+
+#include <cassert>
+#include <new>
+#include <sys/mman.h>
+
+namespace memory_pool {
+    namespace {
+        // 直接向系统申请不提交的内存，不可以走malloc，否则可能会回到内存池本身
+        void* map_noreserve(size_t size) {
+            void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            return ptr == MAP_FAILED ? nullptr : ptr;
+        }
+    }
+
+    page_map::page_map() {
+        m_root = static_cast<std::atomic<page_span**>*>(map_noreserve(ROOT_LENGTH * sizeof(std::atomic<page_span**>)));
+        if (m_root == nullptr) {
+            throw std::bad_alloc();
+        }
+    }
+
+    void page_map::set(memory_span span, page_span* owner) {
+        assert(span.size() % size_utils::PAGE_SIZE == 0);
+        const size_t first_page = reinterpret_cast<std::uintptr_t>(span.data()) >> PAGE_SHIFT;
+        const size_t page_count = span.size() / size_utils::PAGE_SIZE;
+        for (size_t page_number = first_page; page_number < first_page + page_count; ++page_number) {
+            get_or_create_leaf(page_number)[page_number & (LEAF_LENGTH - 1)] = owner;
+        }
+    }
+
+    void page_map::clear(memory_span span) {
+        assert(span.size() % size_utils::PAGE_SIZE == 0);
+        const size_t first_page = reinterpret_cast<std::uintptr_t>(span.data()) >> PAGE_SHIFT;
+        const size_t page_count = span.size() / size_utils::PAGE_SIZE;
+        for (size_t page_number = first_page; page_number < first_page + page_count; ++page_number) {
+            page_span** leaf = m_root[page_number >> LEAF_BITS].load(std::memory_order_acquire);
+            // 只有被set过的页面才需要清除，叶子一定已经存在
+            assert(leaf != nullptr);
+            leaf[page_number & (LEAF_LENGTH - 1)] = nullptr;
+        }
+    }
+
+    page_span** page_map::get_or_create_leaf(size_t page_number) {
+        assert(page_number >> (ADDRESS_BITS - PAGE_SHIFT) == 0);
+        auto& slot = m_root[page_number >> LEAF_BITS];
+        page_span** leaf = slot.load(std::memory_order_acquire);
+        if (leaf != nullptr) {
+            return leaf;
+        }
+        std::unique_lock<std::mutex> guard(m_mutex);
+        leaf = slot.load(std::memory_order_acquire);
+        if (leaf == nullptr) {
+            // 叶子一旦创建就不会再释放，一个叶子只占用虚拟地址，写到的部分才会占用物理内存
+            leaf = static_cast<page_span**>(map_noreserve(LEAF_LENGTH * sizeof(page_span*)));
+            if (leaf == nullptr) {
+                throw std::bad_alloc();
+            }
+            slot.store(leaf, std::memory_order_release);
+        }
+        return leaf;
+    }
+} // memory_pool
@@ -0,0 +1,77 @@
+#ifndef PAGE_MAP_H
+#define PAGE_MAP_H
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "utils.h"
+
+namespace memory_pool
+{
+
+    // 页号到page_span的映射表，用于只拿到一个指针时找到它所属的span（不带大小的释放）
+    // 使用两层基数树：第一层覆盖48位地址空间，第二层每一个叶子覆盖 2^18 个页面（1GB）
+    // 根节点和叶子节点都直接向系统申请，并且不预先提交物理内存，只有被写到的页面才会占用内存
+    class page_map
+    {
+    public:
+        static constexpr size_t ADDRESS_BITS = 48;
+        static constexpr size_t PAGE_SHIFT = 12;
+        static constexpr size_t LEAF_BITS = 18;
+        static constexpr size_t ROOT_BITS = ADDRESS_BITS - PAGE_SHIFT - LEAF_BITS;
+        static constexpr size_t LEAF_LENGTH = size_t{1} << LEAF_BITS;
+        static constexpr size_t ROOT_LENGTH = size_t{1} << ROOT_BITS;
+        static_assert((size_t{1} << PAGE_SHIFT) == size_utils::PAGE_SIZE);
+
+        static page_map &GetInstance()
+        {
+            static page_map instance;
+            return instance;
+        }
+
+        // 将span中的每一页都指向owner
+        void set(memory_span span, page_span *owner);
+
+        // 清除span中每一页的记录
+        void clear(memory_span span);
+
+        // 查找指针所在页面所属的page_span，不是内存池的地址返回nullptr
+        page_span *get(const void *ptr) const
+        {
+            const auto address = reinterpret_cast<std::uintptr_t>(ptr);
+            if (address >> ADDRESS_BITS)
+            {
+                return nullptr;
+            }
+            const size_t page_number = address >> PAGE_SHIFT;
+            page_span **leaf = m_root[page_number >> LEAF_BITS].load(std::memory_order_acquire);
+            if (leaf == nullptr)
+            {
+                return nullptr;
+            }
+            return leaf[page_number & (LEAF_LENGTH - 1)];
+        }
+
+        // fork之前加锁，fork之后在父子进程中解锁
+        void prepare_fork() { m_mutex.lock(); }
+        void after_fork() { m_mutex.unlock(); }
+
+        page_map(const page_map &) = delete;
+        page_map &operator=(const page_map &) = delete;
+
+    private:
+        page_map();
+
+        // 获取页号对应的叶子，不存在时创建
+        page_span **get_or_create_leaf(size_t page_number);
+
+        // 根节点，每一项都指向一个叶子
+        std::atomic<page_span **> *m_root = nullptr;
+        // 只在创建叶子的时候使用
+        std::mutex m_mutex;
+    };
+
+} // memory_pool
+
+#endif // PAGE_MAP_H
@@ -0,0 +1,145 @@
+#ifndef POOL_ALLOCATOR_H
+#define POOL_ALLOCATOR_H
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "memory_pool.h"
+#include "thread_cache.h"
+#include "utils.h"
+
+namespace memory_pool
+{
+
+    // 满足 Allocator 要求的分配器，所有的实例共享同一个内存池
+    // 一次只申请一个对象时（map、list、unordered_map的结点），大小对应的下标在编译期就已经算好，
+    // 直接访问线程缓存中对应的空闲链表
+    // 内存块的起始地址是大小的整数倍（相对于按页对齐的页面），sizeof(T)一定是alignof(T)的整数倍，所以对齐是满足的
+    template <typename T>
+    class pool_allocator
+    {
+    public:
+        using value_type = T;
+        using size_type = size_t;
+        using difference_type = std::ptrdiff_t;
+        using propagate_on_container_move_assignment = std::true_type;
+        using is_always_equal = std::true_type;
+
+        template <typename U>
+        struct rebind
+        {
+            using other = pool_allocator<U>;
+        };
+
+        static_assert(alignof(T) <= size_utils::PAGE_SIZE, "pool_allocator不支持超过一页的对齐");
+
+        pool_allocator() noexcept = default;
+        template <typename U>
+        pool_allocator(const pool_allocator<U> &) noexcept {}
+
+        // 申请失败时抛出std::bad_alloc
+        [[nodiscard]] T *allocate(size_t n)
+        {
+            if (n == 1)
+            {
+                if constexpr (UNIT_SIZE <= size_utils::MAX_CACHED_UNIT_SIZE)
+                {
+                    return checked(thread_cache::GetInstance().allocate_by_index(UNIT_INDEX));
+                }
+            }
+            if (n > std::numeric_limits<size_t>::max() / sizeof(T))
+            {
+                throw std::bad_array_new_length();
+            }
+            return checked(memory_pool::allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T *p, size_t n) noexcept
+        {
+            if (n == 1)
+            {
+                if constexpr (UNIT_SIZE <= size_utils::MAX_CACHED_UNIT_SIZE)
+                {
+                    thread_cache::GetInstance().deallocate_by_index(p, UNIT_INDEX);
+                    return;
+                }
+            }
+            memory_pool::deallocate(p, n * sizeof(T));
+        }
+
+        template <typename U>
+        bool operator==(const pool_allocator<U> &) const noexcept { return true; }
+
+    private:
+        // 一个对象对齐以后的大小和对应的下标，在编译期算好
+        static constexpr size_t UNIT_SIZE = size_utils::align_unit(sizeof(T));
+        static constexpr size_t UNIT_INDEX = size_utils::get_index(sizeof(T));
+
+        static T *checked(std::optional<void *> memory)
+        {
+            if (!memory.has_value())
+            {
+                throw std::bad_alloc();
+            }
+            return static_cast<T *>(memory.value());
+        }
+    };
+
+    // 配合 std::unique_ptr 使用的删除器，记录对象的大小，释放时不需要再查找
+    // 可以从派生类的删除器转换过来，这时记录的是派生类的大小
+    template <typename T>
+    class pool_delete
+    {
+    public:
+        pool_delete() noexcept = default;
+        template <typename U>
+        pool_delete(const pool_delete<U> &other) noexcept : m_size(other.size()) {}
+
+        void operator()(T *p) const noexcept
+        {
+            if (p == nullptr)
+            {
+                return;
+            }
+            p->~T();
+            memory_pool::deallocate(const_cast<std::remove_cv_t<T> *>(p), m_size);
+        }
+
+        size_t size() const noexcept { return m_size; }
+
+    private:
+        size_t m_size = sizeof(T);
+    };
+
+    template <typename T>
+    using pool_unique_ptr = std::unique_ptr<T, pool_delete<T>>;
+
+    // 在内存池中创建一个对象，返回带有大小的unique_ptr
+    template <typename T, typename... Args>
+    pool_unique_ptr<T> make_pool_unique(Args &&...args)
+    {
+        pool_allocator<T> allocator;
+        T *memory = allocator.allocate(1);
+        try
+        {
+            return pool_unique_ptr<T>(::new (static_cast<void *>(memory)) T(std::forward<Args>(args)...));
+        }
+        catch (...)
+        {
+            allocator.deallocate(memory, 1);
+            throw;
+        }
+    }
+
+    // 在内存池中创建一个shared_ptr，控制块和对象一起分配，释放时由分配器带着大小归还
+    template <typename T, typename... Args>
+    std::shared_ptr<T> allocate_pool_shared(Args &&...args)
+    {
+        return std::allocate_shared<T>(pool_allocator<T>(), std::forward<Args>(args)...);
+    }
+
+} // memory_pool
+
+#endif // POOL_ALLOCATOR_H
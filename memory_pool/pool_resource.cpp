@@ -0,0 +1,20 @@
+#include "pool_resource.h"
+
+#include <algorithm>
+#include <new>
+
+#include "memory_pool.h"
+
+namespace memory_pool {
+    void* pool_resource::do_allocate(size_t bytes, size_t alignment) {
+        auto ret = memory_pool::allocate_aligned(std::max(bytes, size_t{1}), alignment);
+        if (!ret.has_value()) {
+            throw std::bad_alloc();
+        }
+        return ret.value();
+    }
+
+    void pool_resource::do_deallocate(void* ptr, size_t bytes, size_t alignment) {
+        memory_pool::deallocate_aligned(ptr, std::max(bytes, size_t{1}), alignment);
+    }
+} // memory_pool
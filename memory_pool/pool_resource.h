@@ -0,0 +1,36 @@
+#ifndef POOL_RESOURCE_H
+#define POOL_RESOURCE_H
+#include <cstddef>
+#include <memory_resource>
+
+namespace memory_pool
+{
+
+    // 把内存池包装成 std::pmr::memory_resource，可以直接用在 std::pmr 的容器中
+    // pmr在释放时会带上大小和对齐，所以直接交给线程缓存，不需要再查找大小
+    // 所有的实例共享同一个内存池，互相之间可以释放对方申请的内存
+    class pool_resource : public std::pmr::memory_resource
+    {
+    public:
+        // 进程内共享的实例
+        static pool_resource &GetInstance()
+        {
+            static pool_resource instance;
+            return instance;
+        }
+
+    protected:
+        // 申请失败时抛出std::bad_alloc
+        void *do_allocate(size_t bytes, size_t alignment) override;
+
+        void do_deallocate(void *ptr, size_t bytes, size_t alignment) override;
+
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+        {
+            return dynamic_cast<const pool_resource *>(&other) != nullptr;
+        }
+    };
+
+} // memory_pool
+
+#endif // POOL_RESOURCE_H
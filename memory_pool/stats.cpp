@@ -0,0 +1,246 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+#include <utility>
+
+#include "central_cache.h"
+#include "metadata_allocator.h"
+#include "page_cache.h"
+
+namespace memory_pool {
+    pool_stats collect_stats(const central_cache& central, page_cache& page) {
+        pool_stats stats;
+
+        // 所有线程缓存中每一种大小的空闲个数和申请次数，申请次数只统计到COUNTED_SIZE_CLASSES，最后一项为更大的
+        std::vector<size_t> thread_blocks(size_utils::CACHE_LINE_SIZE, 0);
+        std::vector<size_t> thread_allocations(size_utils::COUNTED_SIZE_CLASSES + 1, 0);
+        // 已经退出的线程的计数在合计中，它们的记录可能已经被新的线程复用
+        const thread_cache_counters& retired = central.get_retired_thread_counters();
+        for (size_t index = 0; index <= size_utils::COUNTED_SIZE_CLASSES; index++) {
+            const size_t count = retired.allocate_count[index].load(std::memory_order_relaxed);
+            thread_allocations[index] += count;
+            stats.allocate_count += count;
+        }
+        stats.deallocate_count += retired.deallocate_count.load(std::memory_order_relaxed);
+        for (const thread_cache_counters* counters = central.get_thread_counters(); counters != nullptr;
+             counters = counters->next) {
+            if (!counters->active.load(std::memory_order_relaxed)) {
+                continue;
+            }
+            for (size_t index = 0; index < size_utils::CACHE_LINE_SIZE; index++) {
+                thread_blocks[index] += counters->free_block_count[index].load(std::memory_order_relaxed);
+            }
+            for (size_t index = 0; index <= size_utils::COUNTED_SIZE_CLASSES; index++) {
+                const size_t count = counters->allocate_count[index].load(std::memory_order_relaxed);
+                thread_allocations[index] += count;
+                stats.allocate_count += count;
+            }
+            stats.deallocate_count += counters->deallocate_count.load(std::memory_order_relaxed);
+            stats.thread_cache_count++;
+        }
+
+        for (size_t index = 0; index < size_utils::CACHE_LINE_SIZE; index++) {
+            const central_class_counters& counters = central.get_counters(index);
+            size_class_stats size_class;
+            size_class.unit_size = (index + 1) * size_utils::ALIGNMENT;
+            size_class.thread_cache_blocks = thread_blocks[index];
+            size_class.allocate_count = index < size_utils::COUNTED_SIZE_CLASSES ? thread_allocations[index] : 0;
+            size_class.central_free_blocks = counters.free_block_count.load(std::memory_order_relaxed);
+            size_class.span_count = counters.span_count.load(std::memory_order_relaxed);
+            size_class.span_bytes = counters.span_bytes.load(std::memory_order_relaxed);
+            size_class.central_allocate_count = counters.allocate_count.load(std::memory_order_relaxed);
+            size_class.central_deallocate_count = counters.deallocate_count.load(std::memory_order_relaxed);
+            if (size_class.central_allocate_count == 0 && size_class.span_count == 0) {
+                continue;
+            }
+            size_class.lock = counters.lock.get_stats();
+            // 两个值不是同时读取的，线程缓存中的值也可能比较旧
+            const size_t used_blocks = counters.used_block_count.load(std::memory_order_relaxed);
+            size_class.in_use_blocks = used_blocks - std::min(used_blocks, size_class.thread_cache_blocks);
+
+            stats.thread_cache_bytes += size_class.thread_cache_blocks * size_class.unit_size;
+            stats.central_free_bytes += size_class.central_free_blocks * size_class.unit_size;
+            stats.in_use_bytes += size_class.in_use_blocks * size_class.unit_size;
+            stats.span_count += size_class.span_count;
+            stats.span_bytes += size_class.span_bytes;
+            stats.central_allocate_count += size_class.central_allocate_count;
+            stats.central_deallocate_count += size_class.central_deallocate_count;
+            stats.central_lock.acquire_count += size_class.lock.acquire_count;
+            stats.central_lock.contended_count += size_class.lock.contended_count;
+            stats.central_lock.total_wait_ns += size_class.lock.total_wait_ns;
+            stats.central_lock.max_wait_ns = std::max(stats.central_lock.max_wait_ns, size_class.lock.max_wait_ns);
+            stats.size_classes.push_back(size_class);
+        }
+
+        page_cache_stats page_stats = page.get_stats();
+        stats.mapped_bytes = page_stats.mapped_bytes;
+        stats.resident_bytes = page_stats.resident_bytes;
+        stats.reserved_bytes = page_stats.reserved_bytes;
+        stats.page_free_bytes = page_stats.free_bytes;
+        stats.large_unit_count = page_stats.large_unit_count;
+        stats.large_unit_bytes = page_stats.large_unit_bytes;
+        stats.page_allocate_count = page_stats.page_allocate_count;
+        stats.page_deallocate_count = page_stats.page_deallocate_count;
+        stats.system_map_count = page_stats.system_map_count;
+        stats.system_unmap_count = page_stats.system_unmap_count;
+        stats.page_lock = page_stats.lock;
+        stats.metadata_bytes = metadata_arena::GetInstance().mapped_bytes();
+
+        if (stats.mapped_bytes != 0) {
+            const double used_ratio = static_cast<double>(stats.in_use_bytes + stats.large_unit_bytes) / stats.mapped_bytes;
+            stats.fragmentation_ratio = 1.0 - std::min(used_ratio, 1.0);
+        }
+        return stats;
+    }
+
+    std::vector<size_class_stats> top_contended_size_classes(const pool_stats& stats, size_t count) {
+        std::vector<size_class_stats> result;
+        for (const size_class_stats& size_class : stats.size_classes) {
+            if (size_class.lock.contended_count != 0) {
+                result.push_back(size_class);
+            }
+        }
+        std::sort(result.begin(), result.end(), [](const size_class_stats& left, const size_class_stats& right) {
+            return left.lock.total_wait_ns > right.lock.total_wait_ns;
+        });
+        result.resize(std::min(result.size(), count));
+        return result;
+    }
+
+    std::string format_prometheus(const pool_stats& stats) {
+        std::ostringstream output;
+        auto header = [&output](const char* name, const char* type, const char* help) {
+            output << "# HELP " << name << " " << help << "\n"
+                   << "# TYPE " << name << " " << type << "\n";
+        };
+
+        header("memory_pool_bytes", "gauge", "Bytes held in each tier of the pool.");
+        for (auto [tier, bytes] : std::array<std::pair<const char*, size_t>, 6>{{
+                 {"thread_cache", stats.thread_cache_bytes},
+                 {"central_free", stats.central_free_bytes},
+                 {"in_use", stats.in_use_bytes},
+                 {"page_free", stats.page_free_bytes},
+                 {"large_unit", stats.large_unit_bytes},
+                 {"metadata", stats.metadata_bytes},
+             }}) {
+            output << "memory_pool_bytes{tier=\"" << tier << "\"} " << bytes << "\n";
+        }
+        header("memory_pool_mapped_bytes", "gauge", "Bytes mapped and committed from the system.");
+        output << "memory_pool_mapped_bytes " << stats.mapped_bytes << "\n";
+        header("memory_pool_resident_bytes", "gauge", "Mapped bytes resident in physical memory.");
+        output << "memory_pool_resident_bytes " << stats.resident_bytes << "\n";
+        header("memory_pool_reserved_bytes", "gauge", "Address space reserved but not necessarily committed.");
+        output << "memory_pool_reserved_bytes " << stats.reserved_bytes << "\n";
+        header("memory_pool_spans", "gauge", "Spans managed by the central cache.");
+        output << "memory_pool_spans " << stats.span_count << "\n";
+        header("memory_pool_large_units", "gauge", "Large blocks allocated directly from the page cache.");
+        output << "memory_pool_large_units " << stats.large_unit_count << "\n";
+        header("memory_pool_thread_caches", "gauge", "Thread caches of live threads that have registered their counters.");
+        output << "memory_pool_thread_caches " << stats.thread_cache_count << "\n";
+        header("memory_pool_fragmentation_ratio", "gauge", "Share of mapped bytes not holding live objects.");
+        output << "memory_pool_fragmentation_ratio " << stats.fragmentation_ratio << "\n";
+
+        header("memory_pool_operations_total", "counter", "Lifetime operation counts per tier.");
+        for (auto [tier, op, count] : std::array<std::tuple<const char*, const char*, size_t>, 8>{{
+                 {"thread_cache", "allocate", stats.allocate_count},
+                 {"thread_cache", "deallocate", stats.deallocate_count},
+                 {"central_cache", "allocate", stats.central_allocate_count},
+                 {"central_cache", "deallocate", stats.central_deallocate_count},
+                 {"page_cache", "allocate", stats.page_allocate_count},
+                 {"page_cache", "deallocate", stats.page_deallocate_count},
+                 {"system", "map", stats.system_map_count},
+                 {"system", "unmap", stats.system_unmap_count},
+             }}) {
+            output << "memory_pool_operations_total{tier=\"" << tier << "\",op=\"" << op << "\"} " << count << "\n";
+        }
+
+        header("memory_pool_size_class_blocks", "gauge", "Blocks of each size class in each tier.");
+        for (const size_class_stats& size_class : stats.size_classes) {
+            for (auto [tier, blocks] : std::array<std::pair<const char*, size_t>, 3>{{
+                     {"thread_cache", size_class.thread_cache_blocks},
+                     {"central_free", size_class.central_free_blocks},
+                     {"in_use", size_class.in_use_blocks},
+                 }}) {
+                output << "memory_pool_size_class_blocks{size=\"" << size_class.unit_size << "\",tier=\"" << tier
+                       << "\"} " << blocks << "\n";
+            }
+        }
+        header("memory_pool_size_class_allocations_total", "counter",
+               "Allocations of each size class up to 2 KiB handled by thread caches (including hits).");
+        for (const size_class_stats& size_class : stats.size_classes) {
+            if (size_class.unit_size > size_utils::COUNTED_SIZE_CLASSES * size_utils::ALIGNMENT) {
+                continue;
+            }
+            output << "memory_pool_size_class_allocations_total{size=\"" << size_class.unit_size << "\"} "
+                   << size_class.allocate_count << "\n";
+        }
+        header("memory_pool_size_class_span_bytes", "gauge", "Bytes of spans cut for each size class.");
+        for (const size_class_stats& size_class : stats.size_classes) {
+            output << "memory_pool_size_class_span_bytes{size=\"" << size_class.unit_size << "\"} "
+                   << size_class.span_bytes << "\n";
+        }
+
+        // 锁的争用：页缓存的锁一条，中心缓存只输出有过争用的大小，避免几千条全是0的序列
+        std::vector<std::pair<std::string, const lock_stats*>> locks = {{"lock=\"page_cache\"", &stats.page_lock}};
+        for (const size_class_stats& size_class : stats.size_classes) {
+            if (size_class.lock.contended_count != 0) {
+                locks.emplace_back("lock=\"central_cache\",size=\"" + std::to_string(size_class.unit_size) + "\"",
+                                   &size_class.lock);
+            }
+        }
+        header("memory_pool_lock_acquisitions_total", "counter", "Lock acquisitions.");
+        for (const auto& [labels, lock] : locks) {
+            output << "memory_pool_lock_acquisitions_total{" << labels << "} " << lock->acquire_count << "\n";
+        }
+        header("memory_pool_lock_contended_total", "counter", "Lock acquisitions that had to wait.");
+        for (const auto& [labels, lock] : locks) {
+            output << "memory_pool_lock_contended_total{" << labels << "} " << lock->contended_count << "\n";
+        }
+        header("memory_pool_lock_wait_seconds_total", "counter", "Time spent waiting for the lock.");
+        for (const auto& [labels, lock] : locks) {
+            output << "memory_pool_lock_wait_seconds_total{" << labels << "} " << lock->total_wait_ns / 1e9 << "\n";
+        }
+        header("memory_pool_lock_max_wait_seconds", "gauge", "Longest single wait for the lock.");
+        for (const auto& [labels, lock] : locks) {
+            output << "memory_pool_lock_max_wait_seconds{" << labels << "} " << lock->max_wait_ns / 1e9 << "\n";
+        }
+
+        // 延迟按统计窗口输出，采集程序每次读取时重置，所以使用summary而不是累计的histogram
+        header("memory_pool_slow_path_latency_seconds", "summary",
+               "Slow-path latency in the current scrape window (bucket upper bounds, 12.5% resolution).");
+        for (size_t site = 0; site < LATENCY_SITE_COUNT; site++) {
+            const latency_stats& latency = stats.latencies[site];
+            const std::string_view name = latency_site_name(static_cast<latency_site>(site));
+            for (auto [quantile, value] : std::array<std::pair<const char*, double>, 5>{{
+                     {"0.5", latency.p50_ns},
+                     {"0.9", latency.p90_ns},
+                     {"0.99", latency.p99_ns},
+                     {"0.999", latency.p999_ns},
+                     {"1", latency.max_ns},
+                 }}) {
+                output << "memory_pool_slow_path_latency_seconds{site=\"" << name << "\",quantile=\"" << quantile
+                       << "\"} " << value / 1e9 << "\n";
+            }
+            output << "memory_pool_slow_path_latency_seconds_sum{site=\"" << name << "\"} " << latency.total_ns / 1e9
+                   << "\n"
+                   << "memory_pool_slow_path_latency_seconds_count{site=\"" << name << "\"} " << latency.count << "\n";
+        }
+        return output.str();
+    }
+
+    bool write_prometheus(const pool_stats& stats, const std::string& path) {
+        const std::string temporary_path = path + ".tmp";
+        {
+            std::ofstream output(temporary_path, std::ios::trunc);
+            if (!output || !(output << format_prometheus(stats)).flush()) {
+                return false;
+            }
+        }
+        return std::rename(temporary_path.c_str(), path.c_str()) == 0;
+    }
+} // memory_pool
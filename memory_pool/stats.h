@@ -0,0 +1,102 @@
+#ifndef STATS_H
+#define STATS_H
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "latency.h"
+#include "lock_profiler.h"
+
+namespace memory_pool
+{
+    class central_cache;
+    class page_cache;
+
+    // 一种大小在各层中的情况
+    struct size_class_stats
+    {
+        // 内存块的大小
+        size_t unit_size = 0;
+        // 线程缓存空闲链表中的个数（每个线程最近一次进入慢路径时的值）
+        size_t thread_cache_blocks = 0;
+        // 中心缓存空闲链表中的个数
+        size_t central_free_blocks = 0;
+        // 正在被使用的个数：交给线程缓存的个数减去线程缓存中空闲的个数
+        size_t in_use_blocks = 0;
+        // 中心缓存为这个大小管理的span个数和字节数
+        size_t span_count = 0;
+        size_t span_bytes = 0;
+        // 线程缓存处理的这个大小的申请次数，减去向中心缓存申请的次数就是线程缓存直接命中的次数
+        // 只统计2KB以内的大小（size_utils::COUNTED_SIZE_CLASSES），更大的为0
+        size_t allocate_count = 0;
+        // 线程缓存向中心缓存申请和归还的次数
+        size_t central_allocate_count = 0;
+        size_t central_deallocate_count = 0;
+        // 中心缓存中这个大小的锁的争用情况
+        lock_stats lock;
+    };
+
+    // 内存池的统计快照
+    // 各项计数器是分别读取的，并不是同一时刻的值，所以之间可能有少量的出入
+    struct pool_stats
+    {
+        // 用到过的大小，按大小排列
+        std::vector<size_class_stats> size_classes;
+
+        // 小内存各层的字节数
+        size_t thread_cache_bytes = 0;
+        size_t central_free_bytes = 0;
+        size_t in_use_bytes = 0;
+        size_t span_count = 0;
+        size_t span_bytes = 0;
+
+        // 页缓存
+        size_t mapped_bytes = 0;
+        size_t resident_bytes = 0;
+        size_t reserved_bytes = 0;
+        size_t page_free_bytes = 0;
+        size_t large_unit_count = 0;
+        size_t large_unit_bytes = 0;
+        // 内部数据结构（span的记录、空闲页面的索引等）向系统申请的字节数
+        size_t metadata_bytes = 0;
+        // 映射的内存中没有被使用的比例：1 - (小内存正在使用的字节数 + 大块内存的字节数) / 映射的字节数
+        double fragmentation_ratio = 0;
+
+        // 还没有退出的线程的线程缓存个数
+        size_t thread_cache_count = 0;
+        // 累计的操作次数，包括已经退出的线程
+        size_t allocate_count = 0;
+        size_t deallocate_count = 0;
+        size_t central_allocate_count = 0;
+        size_t central_deallocate_count = 0;
+        size_t page_allocate_count = 0;
+        size_t page_deallocate_count = 0;
+        size_t system_map_count = 0;
+        size_t system_unmap_count = 0;
+
+        // 锁的争用情况：中心缓存所有大小的锁的合计（最长等待取最大值），以及页缓存的锁
+        lock_stats central_lock;
+        lock_stats page_lock;
+
+        // 各个慢路径在当前统计窗口中的延迟，整个进程共用，只有memory_pool::stats会填写
+        std::array<latency_stats, LATENCY_SITE_COUNT> latencies = {};
+    };
+
+    // 读取一个中心缓存和它的页缓存的统计
+    // 线程缓存和中心缓存只读取计数器，不加锁；页缓存只在复制映射范围时短暂加锁
+    pool_stats collect_stats(const central_cache &central, page_cache &page);
+
+    // 按中心缓存的锁的总等待时间从多到少排列，取出前count个有过争用的大小
+    std::vector<size_class_stats> top_contended_size_classes(const pool_stats &stats, size_t count);
+
+    // 转换成Prometheus的文本格式
+    std::string format_prometheus(const pool_stats &stats);
+
+    // 以Prometheus的文本格式写到文件中，先写临时文件再改名，读取的一方不会读到写了一半的内容
+    // 返回值：是否写入成功
+    bool write_prometheus(const pool_stats &stats, const std::string &path);
+
+} // memory_pool
+
+#endif // STATS_H
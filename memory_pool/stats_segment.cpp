@@ -0,0 +1,274 @@
+#include "stats_segment.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "central_cache.h"
+#include "metadata_allocator.h"
+#include "page_cache.h"
+#include "stats.h"
+
+namespace memory_pool {
+    namespace {
+        // 读取时重试的次数，写入只需要几微秒，一直读不到说明发布的进程在写的过程中停住了
+        constexpr size_t READ_RETRY_COUNT = 1000;
+
+        // 顺序锁保护的内容按8字节的原子操作逐个复制，避免读写同时进行时的数据竞争
+        constexpr size_t STATS_HEADER_WORDS = offsetof(shared_stats, size_classes) / sizeof(uint64_t);
+        constexpr size_t SIZE_CLASS_WORDS = sizeof(shared_size_class_stats) / sizeof(uint64_t);
+        static_assert(offsetof(shared_stats, size_classes) % sizeof(uint64_t) == 0);
+        static_assert(sizeof(shared_size_class_stats) % sizeof(uint64_t) == 0);
+
+        void store_words(uint64_t* destination, const uint64_t* source, size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                std::atomic_ref<uint64_t>(destination[i]).store(source[i], std::memory_order_relaxed);
+            }
+        }
+
+        void load_words(uint64_t* destination, const uint64_t* source, size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                destination[i] = std::atomic_ref<uint64_t>(const_cast<uint64_t&>(source[i])).load(std::memory_order_relaxed);
+            }
+        }
+
+        // 需要发布的项的字数：固定的部分加上有效的大小
+        size_t stats_words(const shared_stats& stats) {
+            return STATS_HEADER_WORDS + stats.size_class_count * SIZE_CLASS_WORDS;
+        }
+
+        uint64_t monotonic_ns() {
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+        }
+
+        shared_lock_stats to_shared(const lock_stats& lock) {
+            return {lock.acquire_count, lock.contended_count, static_cast<uint64_t>(lock.total_wait_ns),
+                    static_cast<uint64_t>(lock.max_wait_ns)};
+        }
+    }
+
+    stats_segment::stats_segment() {
+        // 后台线程会用到这些单例，先创建它们，让它们比这个单例晚析构
+        central_cache::GetInstance();
+        page_cache::GetInstance();
+        metadata_arena::GetInstance();
+    }
+
+    bool stats_segment::start(std::chrono::milliseconds interval) {
+        {
+            std::lock_guard<std::mutex> lock(m_publish_mutex);
+            if (m_segment != nullptr) {
+                return false;
+            }
+            // /dev/shm所有人都可以写，先删掉可能留下的旧文件，再用O_EXCL创建，不会跟随别人放的符号链接
+            const std::string path = stats_segment_path(getpid());
+            unlink(path.c_str());
+            const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC | O_NOFOLLOW, 0644);
+            if (fd < 0) {
+                return false;
+            }
+            void* memory = MAP_FAILED;
+            if (ftruncate(fd, sizeof(stats_segment_layout)) == 0) {
+                memory = mmap(nullptr, sizeof(stats_segment_layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            ::close(fd);
+            if (memory == MAP_FAILED) {
+                unlink(path.c_str());
+                return false;
+            }
+            m_segment = new (memory) stats_segment_layout();
+            m_segment->pid = static_cast<uint64_t>(getpid());
+            m_segment->interval_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count();
+            m_path = path;
+            m_interval = interval;
+        }
+
+        static std::once_flag fork_handlers;
+        std::call_once(fork_handlers, [] { pthread_atfork(prepare_fork, after_fork_parent, after_fork_child); });
+
+        publish();
+        m_stopping = false;
+        m_thread = std::thread([this] { run(); });
+        return true;
+    }
+
+    void stats_segment::stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wakeup.notify_all();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        std::lock_guard<std::mutex> lock(m_publish_mutex);
+        if (m_segment == nullptr) {
+            return;
+        }
+        unlink(m_path.c_str());
+        munmap(m_segment, sizeof(stats_segment_layout));
+        m_segment = nullptr;
+    }
+
+    void stats_segment::publish() {
+        std::lock_guard<std::mutex> lock(m_publish_mutex);
+        if (m_segment == nullptr) {
+            return;
+        }
+        const pool_stats stats = collect_stats(central_cache::GetInstance(), page_cache::GetInstance());
+
+        shared_stats snapshot;
+        snapshot.publish_ns = monotonic_ns();
+        snapshot.publish_count = m_segment->stats.publish_count + 1;
+        snapshot.thread_cache_bytes = stats.thread_cache_bytes;
+        snapshot.central_free_bytes = stats.central_free_bytes;
+        snapshot.in_use_bytes = stats.in_use_bytes;
+        snapshot.page_free_bytes = stats.page_free_bytes;
+        snapshot.large_unit_bytes = stats.large_unit_bytes;
+        snapshot.metadata_bytes = stats.metadata_bytes;
+        snapshot.mapped_bytes = stats.mapped_bytes;
+        snapshot.resident_bytes = stats.resident_bytes;
+        snapshot.reserved_bytes = stats.reserved_bytes;
+        snapshot.thread_cache_count = stats.thread_cache_count;
+        snapshot.allocate_count = stats.allocate_count;
+        snapshot.deallocate_count = stats.deallocate_count;
+        snapshot.central_allocate_count = stats.central_allocate_count;
+        snapshot.central_deallocate_count = stats.central_deallocate_count;
+        snapshot.page_allocate_count = stats.page_allocate_count;
+        snapshot.page_deallocate_count = stats.page_deallocate_count;
+        snapshot.system_map_count = stats.system_map_count;
+        snapshot.system_unmap_count = stats.system_unmap_count;
+        snapshot.central_lock = to_shared(stats.central_lock);
+        snapshot.page_lock = to_shared(stats.page_lock);
+
+        // 大小太多时只保留申请次数最多的，再按大小排列；2KB以上的大小没有申请次数，按向中心缓存申请的次数比较
+        std::vector<const size_class_stats*> size_classes;
+        for (const size_class_stats& size_class : stats.size_classes) {
+            size_classes.push_back(&size_class);
+        }
+        if (size_classes.size() > shared_stats::MAX_SIZE_CLASSES) {
+            std::nth_element(size_classes.begin(), size_classes.begin() + shared_stats::MAX_SIZE_CLASSES,
+                             size_classes.end(), [](const size_class_stats* left, const size_class_stats* right) {
+                                 if (left->allocate_count != right->allocate_count) {
+                                     return left->allocate_count > right->allocate_count;
+                                 }
+                                 return left->central_allocate_count > right->central_allocate_count;
+                             });
+            size_classes.resize(shared_stats::MAX_SIZE_CLASSES);
+            std::sort(size_classes.begin(), size_classes.end(),
+                      [](const size_class_stats* left, const size_class_stats* right) {
+                          return left->unit_size < right->unit_size;
+                      });
+        }
+        snapshot.size_class_count = size_classes.size();
+        for (size_t i = 0; i < size_classes.size(); i++) {
+            const size_class_stats& size_class = *size_classes[i];
+            snapshot.size_classes[i] = {size_class.unit_size,
+                                        size_class.thread_cache_blocks,
+                                        size_class.central_free_blocks,
+                                        size_class.in_use_blocks,
+                                        size_class.span_bytes,
+                                        size_class.allocate_count,
+                                        size_class.central_allocate_count,
+                                        size_class.central_deallocate_count,
+                                        size_class.lock.acquire_count,
+                                        size_class.lock.contended_count,
+                                        static_cast<uint64_t>(size_class.lock.total_wait_ns)};
+        }
+
+        const uint64_t sequence = m_segment->sequence.load(std::memory_order_relaxed);
+        m_segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        store_words(reinterpret_cast<uint64_t*>(&m_segment->stats), reinterpret_cast<const uint64_t*>(&snapshot),
+                    stats_words(snapshot));
+        m_segment->sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    void stats_segment::run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_wakeup.wait_for(lock, m_interval, [this] { return m_stopping; })) {
+            lock.unlock();
+            publish();
+            lock.lock();
+        }
+    }
+
+    void stats_segment::prepare_fork() {
+        stats_segment& segment = GetInstance();
+        segment.m_mutex.lock();
+        segment.m_publish_mutex.lock();
+    }
+
+    void stats_segment::after_fork_parent() {
+        stats_segment& segment = GetInstance();
+        segment.m_publish_mutex.unlock();
+        segment.m_mutex.unlock();
+    }
+
+    void stats_segment::after_fork_child() {
+        stats_segment& segment = GetInstance();
+        segment.m_publish_mutex.unlock();
+        segment.m_mutex.unlock();
+        // 后台线程没有被复制到子进程中，丢掉它的记录，不能join
+        new (&segment.m_thread) std::thread();
+        // 共享内存属于父进程，子进程不再写入
+        if (segment.m_segment != nullptr) {
+            munmap(segment.m_segment, sizeof(stats_segment_layout));
+            segment.m_segment = nullptr;
+        }
+    }
+
+    std::string stats_segment_path(pid_t pid) {
+        return "/dev/shm/memory_pool." + std::to_string(pid);
+    }
+
+    std::unique_ptr<shared_stats> read_stats_segment(pid_t pid) {
+        const int fd = ::open(stats_segment_path(pid).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return nullptr;
+        }
+        struct stat status;
+        void* memory = MAP_FAILED;
+        if (fstat(fd, &status) == 0 && static_cast<size_t>(status.st_size) == sizeof(stats_segment_layout)) {
+            memory = mmap(nullptr, sizeof(stats_segment_layout), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (memory == MAP_FAILED) {
+            return nullptr;
+        }
+        const stats_segment_layout* segment = static_cast<const stats_segment_layout*>(memory);
+        std::unique_ptr<shared_stats> result;
+        if (segment->magic == stats_segment_layout::MAGIC && segment->version == stats_segment_layout::VERSION &&
+            segment->size == sizeof(stats_segment_layout)) {
+            auto snapshot = std::make_unique<shared_stats>();
+            for (size_t retry = 0; retry < READ_RETRY_COUNT; retry++) {
+                const uint64_t before = segment->sequence.load(std::memory_order_acquire);
+                if (before % 2 != 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                const uint64_t* source = reinterpret_cast<const uint64_t*>(&segment->stats);
+                uint64_t* destination = reinterpret_cast<uint64_t*>(snapshot.get());
+                load_words(destination, source, STATS_HEADER_WORDS);
+                const size_t size_class_count = std::min<uint64_t>(snapshot->size_class_count,
+                                                                   shared_stats::MAX_SIZE_CLASSES);
+                load_words(destination + STATS_HEADER_WORDS, source + STATS_HEADER_WORDS,
+                           size_class_count * SIZE_CLASS_WORDS);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (segment->sequence.load(std::memory_order_relaxed) == before) {
+                    snapshot->size_class_count = size_class_count;
+                    result = std::move(snapshot);
+                    break;
+                }
+            }
+        }
+        munmap(memory, sizeof(stats_segment_layout));
+        return result;
+    }
+} // memory_pool
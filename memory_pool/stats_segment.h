@@ -0,0 +1,171 @@
+#ifndef STATS_SEGMENT_H
+#define STATS_SEGMENT_H
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+
+namespace memory_pool
+{
+
+    // 共享内存中一种大小的统计，只包含uint64_t，不同的编译选项和编译器读到的布局相同
+    struct shared_size_class_stats
+    {
+        uint64_t unit_size = 0;
+        uint64_t thread_cache_blocks = 0;
+        uint64_t central_free_blocks = 0;
+        uint64_t in_use_blocks = 0;
+        uint64_t span_bytes = 0;
+        // 线程缓存处理的申请次数和向中心缓存申请、归还的次数，前两个的差是线程缓存直接命中的次数
+        // 申请次数只统计2KB以内的大小，更大的为0
+        uint64_t allocate_count = 0;
+        uint64_t central_allocate_count = 0;
+        uint64_t central_deallocate_count = 0;
+        // 中心缓存中这个大小的锁
+        uint64_t lock_acquire_count = 0;
+        uint64_t lock_contended_count = 0;
+        uint64_t lock_wait_ns = 0;
+    };
+
+    // 共享内存中一把锁的统计
+    struct shared_lock_stats
+    {
+        uint64_t acquire_count = 0;
+        uint64_t contended_count = 0;
+        uint64_t total_wait_ns = 0;
+        uint64_t max_wait_ns = 0;
+    };
+
+    // 发布到共享内存中的统计，含义和pool_stats中同名的项相同，计数器都是累计值，读取的一方用两次读取的差计算速率
+    struct shared_stats
+    {
+        // 最多发布的大小个数，超过时只发布申请次数最多的
+        static constexpr size_t MAX_SIZE_CLASSES = 256;
+
+        // 发布时的CLOCK_MONOTONIC纳秒数和发布的次数
+        uint64_t publish_ns = 0;
+        uint64_t publish_count = 0;
+
+        // 各层的字节数
+        uint64_t thread_cache_bytes = 0;
+        uint64_t central_free_bytes = 0;
+        uint64_t in_use_bytes = 0;
+        uint64_t page_free_bytes = 0;
+        uint64_t large_unit_bytes = 0;
+        uint64_t metadata_bytes = 0;
+        uint64_t mapped_bytes = 0;
+        uint64_t resident_bytes = 0;
+        uint64_t reserved_bytes = 0;
+
+        // 累计的操作次数
+        uint64_t thread_cache_count = 0;
+        uint64_t allocate_count = 0;
+        uint64_t deallocate_count = 0;
+        uint64_t central_allocate_count = 0;
+        uint64_t central_deallocate_count = 0;
+        uint64_t page_allocate_count = 0;
+        uint64_t page_deallocate_count = 0;
+        uint64_t system_map_count = 0;
+        uint64_t system_unmap_count = 0;
+
+        shared_lock_stats central_lock;
+        shared_lock_stats page_lock;
+
+        // size_classes中有效的个数，按大小排列
+        uint64_t size_class_count = 0;
+        std::array<shared_size_class_stats, MAX_SIZE_CLASSES> size_classes = {};
+    };
+
+    // 共享内存的整体布局，开头的几项创建以后不再改变
+    // stats按顺序锁的方式更新：写之前sequence加1变为奇数，写完再加1变为偶数；
+    // 读取的一方在前后两次读到同一个偶数时，中间读到的内容才是完整的
+    struct stats_segment_layout
+    {
+        static constexpr uint64_t MAGIC = 0x5354415453504d4dULL; // "MMPSTATS"
+        static constexpr uint32_t VERSION = 1;
+
+        uint64_t magic = MAGIC;
+        uint32_t version = VERSION;
+        uint32_t size = sizeof(stats_segment_layout);
+        uint64_t pid = 0;
+        // 发布的间隔
+        uint64_t interval_ns = 0;
+        std::atomic<uint64_t> sequence = 0;
+        shared_stats stats;
+    };
+
+    // 把默认堆的统计定期发布到 /dev/shm/memory_pool.<pid> 中，其他进程（比如mempool_top）可以直接映射读取，
+    // 不需要调试器，也不需要在服务中加任何通信的接口
+    // 后台线程每隔一段时间调用collect_stats，只读取计数器，不会让正在申请和归还的线程等待
+    // 正常停止或者进程正常退出时删除文件，进程崩溃时文件会留下，读取的一方需要检查进程是否还在
+    // fork出的子进程不继续发布，需要时在子进程中重新start
+    class stats_segment
+    {
+    public:
+        static constexpr std::chrono::milliseconds DEFAULT_INTERVAL{1000};
+
+        static stats_segment &GetInstance()
+        {
+#ifdef MEMORY_POOL_NO_DESTROY
+            alignas(stats_segment) static std::byte storage[sizeof(stats_segment)];
+            static stats_segment *instance = new (storage) stats_segment();
+            return *instance;
+#else
+            static stats_segment instance;
+            return instance;
+#endif
+        }
+
+        ~stats_segment() { stop(); }
+
+        // 创建共享内存并启动后台线程，马上发布一次，之后每隔interval发布一次
+        // 返回值：是否启动成功，已经启动或者创建共享内存失败时返回false
+        bool start(std::chrono::milliseconds interval = DEFAULT_INTERVAL);
+
+        // 停止后台线程并删除共享内存
+        void stop();
+
+        // 马上发布一次，没有启动时什么也不做
+        void publish();
+
+    private:
+        stats_segment();
+
+        // 后台线程
+        void run();
+
+        static void prepare_fork();
+        static void after_fork_parent();
+        static void after_fork_child();
+
+        // 映射的共享内存，没有启动时为nullptr
+        stats_segment_layout *m_segment = nullptr;
+        std::string m_path;
+        std::chrono::milliseconds m_interval = DEFAULT_INTERVAL;
+        std::thread m_thread;
+        bool m_stopping = false;
+        // 保护m_stopping，后台线程在这里等待下一次发布
+        std::mutex m_mutex;
+        std::condition_variable m_wakeup;
+        // 保证只有一个写入的一方，也保护m_segment和m_path
+        std::mutex m_publish_mutex;
+    };
+
+    // 进程pid的共享内存的路径
+    std::string stats_segment_path(pid_t pid);
+
+    // 读取进程pid发布的统计，每次调用都重新打开和映射
+    // 返回值：没有发布、格式不对或者一直没有读到完整的内容时返回nullptr
+    std::unique_ptr<shared_stats> read_stats_segment(pid_t pid);
+
+} // memory_pool
+
+#endif // STATS_SEGMENT_H
@@ -2,132 +2,515 @@
 
 #include "thread_cache.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <iostream>
+#include <pthread.h>
 #include <bits/ostream.tcc>
 
 #include "central_cache.h"
+#include "event_tracer.h"
+#include "latency.h"
 #include "utils.h"
 
 namespace memory_pool
 {
+#ifdef MEMORY_POOL_REMOTE_FREE
+    namespace
+    {
+        // 下一个分配给线程缓存的拥有者编号，从1开始，0表示没有拥有者
+        std::atomic<uint64_t> next_owner_token = 1;
+    }
+#endif
+
     std::optional<void *> thread_cache::allocate(size_t memory_size)
     {
-        if (memory_size == 0)
+        void *result = allocate_raw(memory_size);
+        if (result == nullptr)
         {
-            return std::nullopt; // 对于大小为0的情况立即返回nullopt
+            return std::nullopt;
         }
+        return result;
+    }
 
-        // 将memory_size的大小对齐到8字节
-        memory_size = size_utils::align(memory_size);
-        //大内存直接交给下一层
-        if (memory_size > size_utils::MAX_CACHED_UNIT_SIZE)
+    void thread_cache::deallocate(void *start_p, size_t memory_size)
+    {
+        deallocate_raw(start_p, memory_size);
+    }
+
+    void *thread_cache::allocate_slow(size_t memory_size) noexcept
+    {
+        if (memory_size == 0)
         {
-            return allocate_from_central_cache(memory_size).and_then([](std::byte *memory_addr)
-                                                                     { return std::optional<void *>(memory_addr); });
+            return nullptr; // 对于大小为0的情况立即返回nullptr
         }
 
-        const size_t index = size_utils::get_index(memory_size);
-        // 如果当前的空闲链表中存在，则从空闲链表中取
-        if (m_free_cache[index] != nullptr)
+        // 将memory_size的大小对齐到分级的大小
+        memory_size = size_utils::align_unit(memory_size);
+        const size_t index = memory_size > size_utils::MAX_CACHED_UNIT_SIZE ? size_utils::CACHE_LINE_SIZE
+                                                                            : size_utils::get_index(memory_size);
+        if (index == size_utils::CACHE_LINE_SIZE)
         {
+            m_bytes_until_sample -= static_cast<std::ptrdiff_t>(std::min(memory_size, heap_profiler::MAX_SAMPLE_INTERVAL));
+        }
+        const bool sampled = m_bytes_until_sample < 0 && begin_sample();
+        if (sampled && index < size_utils::CACHE_LINE_SIZE)
+        {
+            // 采样的小内存放在堆分析器的槽中，槽用完时照常分配
+            m_sampling = true;
+            std::byte *sample = heap_profiler::GetInstance().allocate_small_sample(memory_size);
+            m_sampling = false;
+            if (sample != nullptr)
+            {
+                m_allocate_count[size_utils::get_counter_index(index)]++;
+                publish_counters(index);
+                return sample;
+            }
+        }
+        std::byte *result = nullptr;
+        try
+        {
+            if (index == size_utils::CACHE_LINE_SIZE)
+            {
+                //大内存直接交给下一层，一次只申请一块，也不挂到空闲链表上
+                result = central().allocate(memory_size, 1).value_or(nullptr);
+            }
+            else if (m_free_cache[index] != nullptr)
+            {
+                // 从空闲链表中取，没有时从中心缓存层申请
+                result = m_free_cache[index];
+                m_free_cache[index] = *(reinterpret_cast<std::byte **>(result));
+                m_free_cache_size[index]--;
+            }
+            else
+            {
+#ifdef MEMORY_POOL_REMOTE_FREE
+                result = allocate_from_owned_spans(memory_size);
+#else
+                result = allocate_from_central_cache(memory_size);
+#endif
+            }
+        }
+        catch (...)
+        {
+            // 记录页面的元数据申请失败，和申请不到页面一样处理
+            result = nullptr;
+        }
+        if (result != nullptr)
+        {
+            m_allocate_count[size_utils::get_counter_index(index)]++;
+            if (sampled && index == size_utils::CACHE_LINE_SIZE)
+            {
+                m_sampling = true;
+                heap_profiler::GetInstance().record_large_sample(result, memory_size);
+                m_sampling = false;
+            }
+        }
+        publish_counters(index);
+        return result;
+    }
 
-            std::byte *result = m_free_cache[index];
-            m_free_cache[index] = *(reinterpret_cast<std::byte **>(result));
-
-            m_free_cache_size[index]--;
-            return result;
+    bool thread_cache::begin_sample() noexcept
+    {
+        // 记录调用栈时的申请，倒数已经重新设置过了
+        if (m_sampling)
+        {
+            return false;
         }
-        //否则从中心缓存层申请
-        return allocate_from_central_cache(memory_size).and_then([](std::byte *memory_addr)
-                                                                 { return std::optional<void *>(memory_addr); });
+        heap_profiler &profiler = heap_profiler::GetInstance();
+        // 独立的堆销毁时它的内存一起失效，采样不会被释放，所以只采样默认的堆
+        if (m_central_cache != nullptr || !profiler.enabled())
+        {
+            m_bytes_until_sample = static_cast<std::ptrdiff_t>(heap_profiler::DISABLED_CHECK_BYTES);
+            return false;
+        }
+        m_bytes_until_sample = static_cast<std::ptrdiff_t>(profiler.next_sample_interval(m_sample_random));
+        return true;
     }
 
-    void thread_cache::deallocate(void *start_p, size_t memory_size)
+    void thread_cache::deallocate_slow(void *start_p, size_t memory_size) noexcept
     {
         if (memory_size == 0 || start_p == nullptr)
         {
             return;
         }
-        memory_size = size_utils::align(memory_size);
+        memory_size = size_utils::align_unit(memory_size);
         // 如果大于了最大缓存值了，说明是直接从中心缓存区申请的，可以直接返还给中心缓存区
         if (memory_size > size_utils::MAX_CACHED_UNIT_SIZE)
         {
-            central_cache::GetInstance().deallocate(reinterpret_cast<std::byte *>(start_p), memory_size);
+            m_deallocate_count++;
+            if (heap_profiler::GetInstance().has_large_samples())
+            {
+                heap_profiler::GetInstance().deallocate_large_sample(start_p);
+            }
+            central().deallocate(reinterpret_cast<std::byte *>(start_p), memory_size);
+            publish_counters(size_utils::CACHE_LINE_SIZE);
             return;
         }
 
-        const size_t index = size_utils::get_index(memory_size);
+        push_free_block(start_p, size_utils::get_index(memory_size));
+    }
 
-        *(reinterpret_cast<std::byte **>(start_p)) = m_free_cache[index];
-        m_free_cache[index] = reinterpret_cast<std::byte *>(start_p);
-        m_free_cache_size[index]++;
+    void thread_cache::publish_counters(size_t index) noexcept
+    {
+        if (m_counters == nullptr)
+        {
+            m_counters = central().register_thread_cache();
+            if (m_counters == nullptr)
+            {
+                return;
+            }
+            // 独立的堆的线程缓存属于堆，在堆析构时一起回收
+            if (m_central_cache == nullptr)
+            {
+                // thread_local对象的析构需要在每次访问时检查有没有注册过，注册时还会申请内存，
+                // 所以使用pthread的线程局部数据，只在这里注册一次
+                static pthread_key_t key;
+                static const bool key_created = pthread_key_create(&key, on_thread_exit) == 0;
+                if (key_created)
+                {
+                    pthread_setspecific(key, this);
+                }
+            }
+        }
+        if (index < size_utils::CACHE_LINE_SIZE)
+        {
+            m_counters->free_block_count[index].store(m_free_cache_size[index], std::memory_order_relaxed);
+        }
+        const size_t counter_index = size_utils::get_counter_index(index);
+        m_counters->allocate_count[counter_index].store(m_allocate_count[counter_index], std::memory_order_relaxed);
+        m_counters->deallocate_count.store(m_deallocate_count, std::memory_order_relaxed);
+    }
+
+    void thread_cache::on_thread_exit(void *cache) noexcept
+    {
+        static_cast<thread_cache *>(cache)->release_on_thread_exit();
+    }
 
-        // 检测一下需不需要回收
-        // 如果当前的列表所维护的大小已经超过了阈值，则触发资源回收
-        // 维护的大小 = 个数 × 单个空间的大小
-        if (m_free_cache_size[index] * memory_size > MAX_FREE_BYTES_PER_LISTS)
+    void thread_cache::release_on_thread_exit() noexcept
+    {
+        for (size_t index = 0; index < size_utils::CACHE_LINE_SIZE; index++)
+        {
+#ifdef MEMORY_POOL_REMOTE_FREE
+            // 内存块只能回到拥有者的span中，先交还拥有的span，剩下的内存块才能直接还给中心缓存
+            disown_spans(index);
+#endif
+            if (m_free_cache[index] == nullptr)
+            {
+                continue;
+            }
+            central().deallocate(m_free_cache[index], (index + 1) * size_utils::ALIGNMENT);
+            m_free_cache[index] = nullptr;
+            m_free_cache_size[index] = 0;
+            m_next_allocate_count[index] = 0;
+        }
+        if (m_counters != nullptr)
         {
-            // 如果超过了，则回收一半的多余的内存块
-            size_t deallocate_block_size = m_free_cache_size[index] / 2;
+            // 快速路径中的申请次数只在这种大小进入慢路径时才发布，交还之前全部发布一次
+            for (size_t index = 0; index < m_allocate_count.size(); index++)
+            {
+                m_counters->allocate_count[index].store(m_allocate_count[index], std::memory_order_relaxed);
+            }
+            m_counters->deallocate_count.store(m_deallocate_count, std::memory_order_relaxed);
+            central().unregister_thread_cache(m_counters);
+            m_counters = nullptr;
+        }
+        // 计数已经加到了退出线程的合计中，重新注册以后从0开始
+        m_allocate_count = {};
+        m_deallocate_count = 0;
+    }
 
-            std::byte *block_to_deallocate = m_free_cache[index];
-            std::byte *last_node_to_remove = block_to_deallocate;
+    void thread_cache::release_to_central_cache(size_t index)
+    {
+        latency_timer timer(latency_site::central_release);
+        trace_scope trace(trace_event_type::release, (index + 1) * size_utils::ALIGNMENT, m_free_cache_size[index]);
+#ifdef MEMORY_POOL_REMOTE_FREE
+        // 内存块只能回到自己的span中，所以只有整个span都空闲时才能归还
+        release_owned_spans(index);
+        publish_counters(index);
+        return;
+#endif
+        const size_t memory_size = (index + 1) * size_utils::ALIGNMENT;
+        // 回收一半的多余的内存块
+        size_t deallocate_block_size = m_free_cache_size[index] / 2;
 
-            for (auto i = 0; i < deallocate_block_size - 1; i++)
+        std::byte *block_to_deallocate = m_free_cache[index];
+        std::byte *last_node_to_remove = block_to_deallocate;
+
+        for (auto i = 0; i < deallocate_block_size - 1; i++)
+        {
+            assert(last_node_to_remove != nullptr);
+            if (*(reinterpret_cast<std::byte **>(last_node_to_remove)) == nullptr)
             {
-                assert(last_node_to_remove != nullptr);
-                if (*(reinterpret_cast<std::byte **>(last_node_to_remove)) == nullptr)
-                {
-                    // 如果链表提前结束，说明 m_free_cache_size[index] 计数有误，这是严重问题
-                    assert(false && "Free list is shorter than expected size count!");
-                    // 可能需要采取恢复措施或记录错误
-                    return; // 暂时返回，避免崩溃
-                }
-                last_node_to_remove = *(reinterpret_cast<std::byte **>(last_node_to_remove));
+                // 如果链表提前结束，说明 m_free_cache_size[index] 计数有误，这是严重问题
+                assert(false && "Free list is shorter than expected size count!");
+                // 可能需要采取恢复措施或记录错误
+                return; // 暂时返回，避免崩溃
             }
-            std::byte *new_head = *(reinterpret_cast<std::byte **>(last_node_to_remove));
-            // 断开归还链表与剩余链表的连接
-            *(reinterpret_cast<std::byte **>(last_node_to_remove)) = nullptr;
-            m_free_cache[index] = new_head;
-            m_free_cache_size[index] -= deallocate_block_size;
+            last_node_to_remove = *(reinterpret_cast<std::byte **>(last_node_to_remove));
+        }
+        std::byte *new_head = *(reinterpret_cast<std::byte **>(last_node_to_remove));
+        // 断开归还链表与剩余链表的连接
+        *(reinterpret_cast<std::byte **>(last_node_to_remove)) = nullptr;
+        m_free_cache[index] = new_head;
+        m_free_cache_size[index] -= deallocate_block_size;
 
-            // 检查当前的链表与要删除的链表的长度是不是一样的
-            assert(check_ptr_length(m_free_cache[index]) == m_free_cache_size[index]);
-            assert(check_ptr_length(block_to_deallocate) == deallocate_block_size);
+        // 检查当前的链表与要删除的链表的长度是不是一样的
+        assert(check_ptr_length(m_free_cache[index]) == m_free_cache_size[index]);
+        assert(check_ptr_length(block_to_deallocate) == deallocate_block_size);
 
-            // 释放空间
-            central_cache::GetInstance().deallocate(block_to_deallocate, memory_size);
-            // 在回收工作完成以后，还要调整这个空间大小的申请的个数
-            // 减半下一次申请的个数
-            m_next_allocate_count[index] /= 2;
+        // 释放空间
+        central().deallocate(block_to_deallocate, memory_size);
+        // 在回收工作完成以后，还要调整这个空间大小的申请的个数
+        // 减半下一次申请的个数
+        m_next_allocate_count[index] /= 2;
+        publish_counters(index);
+    }
+
+    bool thread_cache::reserve(size_t memory_size, size_t block_count)
+    {
+        memory_size = size_utils::align_unit(memory_size);
+        if (memory_size == 0 || memory_size > size_utils::MAX_CACHED_UNIT_SIZE)
+        {
+            return false;
         }
+        const size_t index = size_utils::get_index(memory_size);
+        block_count = std::min(block_count, MAX_FREE_BYTES_PER_LISTS / memory_size);
+#ifdef MEMORY_POOL_REMOTE_FREE
+        while (m_free_cache_size[index] < block_count)
+        {
+            if (!acquire_owned_span(memory_size))
+            {
+                return false;
+            }
+        }
+        publish_counters(index);
+        return true;
+#endif
+        while (m_free_cache_size[index] < block_count)
+        {
+            size_t batch_count = block_count - m_free_cache_size[index];
+#ifndef NDEBUG
+            // 要确保不会超过center_cache一次申请的最大个数
+            batch_count = std::min(batch_count, page_span::MAX_UNIT_COUNT);
+#endif
+            auto ret = central().allocate(memory_size, batch_count);
+            if (!ret.has_value())
+            {
+                return false;
+            }
+            std::byte *list_end = ret.value();
+            while (*(reinterpret_cast<std::byte **>(list_end)) != nullptr)
+            {
+                list_end = *(reinterpret_cast<std::byte **>(list_end));
+            }
+            *(reinterpret_cast<std::byte **>(list_end)) = m_free_cache[index];
+            m_free_cache[index] = ret.value();
+            m_free_cache_size[index] += batch_count;
+        }
+        publish_counters(index);
+        return true;
+    }
+
+    central_cache &thread_cache::central()
+    {
+        return m_central_cache != nullptr ? *m_central_cache : central_cache::GetInstance();
     }
 
-    std::optional<std::byte *> thread_cache::allocate_from_central_cache(size_t memory_size)
-    {   
+    std::byte *thread_cache::allocate_from_central_cache(size_t memory_size)
+    {
+        latency_timer timer(latency_site::central_refill);
         //计算申请块数
         size_t block_count = compute_allocate_count(memory_size);
+        trace_scope trace(trace_event_type::refill, memory_size, block_count);
         //将参数传递给中心缓存层
-        return central_cache::GetInstance().allocate(memory_size, block_count).transform([this, memory_size, block_count](std::byte *memory_list)
-                                                                                         {
-            size_t index = size_utils::get_index(memory_size);
-            std::byte* list_end = memory_list;
+        std::byte *memory_list = central().allocate(memory_size, block_count).value_or(nullptr);
+        if (memory_list == nullptr)
+        {
+            return nullptr;
+        }
+
+        size_t index = size_utils::get_index(memory_size);
+        std::byte *list_end = memory_list;
+        size_t list_size = 1;
+        while (*(reinterpret_cast<std::byte **>(list_end)) != nullptr)
+        {
+            list_end = *(reinterpret_cast<std::byte **>(list_end));
+            list_size++;
+        }
+
+        assert(list_size == block_count);
+        //将申请到的内存块挂到空闲链表上
+        *(reinterpret_cast<std::byte **>(list_end)) = m_free_cache[index];
+        // 将链表指向下一个结点，第一个结点要传出去
+        m_free_cache[index] = *reinterpret_cast<std::byte **>(memory_list);
+        m_free_cache_size[index] += block_count - 1;
+        return memory_list;
+    }
+
+#ifdef MEMORY_POOL_REMOTE_FREE
+    void thread_cache::deallocate_remote(page_span *span, void *start_p) noexcept
+    {
+        std::byte *memory = reinterpret_cast<std::byte *>(start_p);
+        // 不属于任何线程的内存块（中心缓存直接分配的，或者拥有者的线程已经退出），直接还给中心缓存
+        // 读到拥有者以后它的线程才退出时，远程释放链表已经关闭，同样还给中心缓存
+        if (span->owner_state().owner.load(std::memory_order_relaxed) != span_owner_state::NO_OWNER &&
+            span->owner_state().push_remote_free(memory))
+        {
+            return;
+        }
+        *(reinterpret_cast<std::byte **>(memory)) = nullptr;
+        central().deallocate(memory, span->unit_size());
+    }
+
+    std::byte *thread_cache::allocate_from_owned_spans(size_t memory_size)
+    {
+        const size_t index = size_utils::get_index(memory_size);
+        if (!collect_remote_frees(index) && !acquire_owned_span(memory_size))
+        {
+            return nullptr;
+        }
+        assert(m_free_cache[index] != nullptr);
+        std::byte *result = m_free_cache[index];
+        m_free_cache[index] = *(reinterpret_cast<std::byte **>(result));
+        m_free_cache_size[index]--;
+        return result;
+    }
+
+    bool thread_cache::acquire_owned_span(size_t memory_size)
+    {
+        latency_timer timer(latency_site::central_refill);
+        trace_scope trace(trace_event_type::refill, memory_size);
+        const size_t index = size_utils::get_index(memory_size);
+        if (m_owner_token == UNASSIGNED_OWNER_TOKEN)
+        {
+            m_owner_token = next_owner_token.fetch_add(1, std::memory_order_relaxed);
+        }
+        page_span *span = central().allocate_owned_span(memory_size, m_owner_token);
+        if (span == nullptr)
+        {
+            return false;
+        }
+        const size_t unit_count = span->owner_state().unit_count;
+        // 从后往前插入，让链表按地址从小到大排列
+        for (size_t i = unit_count; i > 0; i--)
+        {
+            std::byte *unit = span->data() + (i - 1) * memory_size;
+            *(reinterpret_cast<std::byte **>(unit)) = m_free_cache[index];
+            m_free_cache[index] = unit;
+        }
+        m_free_cache_size[index] += unit_count;
+        span->owner_state().next_owned = m_owned_spans[index];
+        m_owned_spans[index] = span;
+        // 有了新的span，重新按照阈值检查
+        m_next_release_count[index] = 0;
+        return true;
+    }
+
+    bool thread_cache::collect_remote_frees(size_t index)
+    {
+        bool collected = false;
+        for (page_span *span = m_owned_spans[index]; span != nullptr; span = span->owner_state().next_owned)
+        {
+            std::byte *memory_list = span->owner_state().take_remote_frees();
+            if (memory_list == nullptr)
+            {
+                continue;
+            }
+            std::byte *list_end = memory_list;
             size_t list_size = 1;
-            while (*(reinterpret_cast<std::byte**>(list_end)) != nullptr) {
-                list_end = *(reinterpret_cast<std::byte**>(list_end));
-                list_size ++;
+            while (*(reinterpret_cast<std::byte **>(list_end)) != nullptr)
+            {
+                list_end = *(reinterpret_cast<std::byte **>(list_end));
+                list_size++;
+            }
+            *(reinterpret_cast<std::byte **>(list_end)) = m_free_cache[index];
+            m_free_cache[index] = memory_list;
+            m_free_cache_size[index] += list_size;
+            collected = true;
+        }
+        return collected;
+    }
+
+    void thread_cache::release_owned_spans(size_t index)
+    {
+        collect_remote_frees(index);
+
+        // 统计每一个span有多少个内存块在空闲链表中
+        for (page_span *span = m_owned_spans[index]; span != nullptr; span = span->owner_state().next_owned)
+        {
+            span->owner_state().local_free_count = 0;
+        }
+        for (std::byte *current = m_free_cache[index]; current != nullptr; current = *(reinterpret_cast<std::byte **>(current)))
+        {
+            page_span *span = page_map::GetInstance().get(current);
+            assert(span != nullptr && span->owner_state().owner.load(std::memory_order_relaxed) == m_owner_token);
+            span->owner_state().local_free_count++;
+        }
+
+        // 从空闲链表中摘掉全部空闲的span中的内存块
+        std::byte **link = &m_free_cache[index];
+        while (*link != nullptr)
+        {
+            span_owner_state &state = page_map::GetInstance().get(*link)->owner_state();
+            if (state.local_free_count == state.unit_count)
+            {
+                *link = *(reinterpret_cast<std::byte **>(*link));
+                m_free_cache_size[index]--;
+            }
+            else
+            {
+                link = reinterpret_cast<std::byte **>(*link);
+            }
+        }
+
+        // 把这些span整个还给中心缓存
+        page_span **owned_link = &m_owned_spans[index];
+        while (*owned_link != nullptr)
+        {
+            page_span *span = *owned_link;
+            if (span->owner_state().local_free_count == span->owner_state().unit_count)
+            {
+                *owned_link = span->owner_state().next_owned;
+                central().deallocate_owned_span(span);
+            }
+            else
+            {
+                owned_link = &span->owner_state().next_owned;
             }
+        }
+        assert(check_ptr_length(m_free_cache[index]) == m_free_cache_size[index]);
+
+        // 剩下的span都还有内存块在使用，等链表长度翻倍以后再检查，避免每一次归还都扫描整个链表
+        m_next_release_count[index] = m_free_cache_size[index] * 2;
+    }
 
-            assert(list_size == block_count);
-            //将申请到的内存块挂到空闲链表上
-            *(reinterpret_cast<std::byte**>(list_end)) = m_free_cache[index];
-            // 将链表指向下一个结点，第一个结点要传出去
-            m_free_cache[index] = *reinterpret_cast<std::byte**>(memory_list);
-            m_free_cache_size[index] += block_count - 1;
-            return memory_list;
-         });
+    void thread_cache::disown_spans(size_t index)
+    {
+        if (m_owned_spans[index] == nullptr)
+        {
+            return;
+        }
+        release_owned_spans(index);
+        for (page_span *span = m_owned_spans[index]; span != nullptr; span = span->owner_state().next_owned)
+        {
+            span_owner_state &state = span->owner_state();
+            // 先清掉拥有者，再关闭链表：关闭之前放进来的内存块在这里取走，之后的由归还的线程还给中心缓存
+            state.owner.store(span_owner_state::NO_OWNER, std::memory_order_relaxed);
+            std::byte *memory_list = state.close_remote_frees();
+            while (memory_list != nullptr)
+            {
+                std::byte *next = *(reinterpret_cast<std::byte **>(memory_list));
+                *(reinterpret_cast<std::byte **>(memory_list)) = m_free_cache[index];
+                m_free_cache[index] = memory_list;
+                m_free_cache_size[index]++;
+                memory_list = next;
+            }
+        }
+        m_owned_spans[index] = nullptr;
+        m_next_release_count[index] = 0;
     }
+#endif
 
     size_t thread_cache::compute_allocate_count(size_t memory_size)
     {
@@ -139,8 +522,27 @@ namespace memory_pool
             return 1;
         }
 
+        // 还没有申请过的时候，使用画像中恢复的个数
+        size_t next_allocate_count_hint = m_next_allocate_count[index];
+        if (next_allocate_count_hint == 0)
+        {
+            // 画像可能来自不同的编译模式，仍然要满足下面的上限
+            next_allocate_count_hint = std::min(central().get_initial_batch_count(index),
+                                                MAX_FREE_BYTES_PER_LISTS / memory_size / 2);
+#ifndef NDEBUG
+            next_allocate_count_hint = std::min(next_allocate_count_hint, page_span::MAX_UNIT_COUNT);
+#endif
+        }
         // 最少申请4个块
-        size_t result = std::max(m_next_allocate_count[index], static_cast<size_t>(4));
+        size_t result = std::max(next_allocate_count_hint, static_cast<size_t>(4));
+#ifdef MEMORY_POOL_CACHE_LINE_ISOLATION
+        // 小内存块一次申请整数个缓存行，新切分的页面是按地址顺序分配的，
+        // 这样一批内存块正好占满几个缓存行，不会和其他线程的内存块共用一个缓存行
+        if (memory_size < size_utils::CPU_CACHE_LINE_BYTES)
+        {
+            result = size_utils::align(result, size_utils::CPU_CACHE_LINE_BYTES / memory_size);
+        }
+#endif
 
         // 计算下一次要申请的个数，默认乘2
         size_t next_allocate_count = result * 2;
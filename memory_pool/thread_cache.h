@@ -3,15 +3,23 @@
 #ifndef THREAD_CACHE_H
 #define THREAD_CACHE_H
 #include <array>
+#include <cstdint>
 #include <list>
 #include <optional>
 #include <set>
+#include "allocation_recorder.h"
+#include "heap_profiler.h"
 #include "utils.h"
+#ifdef MEMORY_POOL_REMOTE_FREE
+#include "page_map.h"
+#endif
 #include <span>
 #include <unordered_map>
 
 namespace memory_pool
 {
+    class central_cache;
+    struct thread_cache_counters;
 
     class thread_cache
     {
@@ -28,6 +36,12 @@ namespace memory_pool
             return instance;
         }
 
+        // 默认堆的线程缓存，向默认的中心缓存申请
+        thread_cache() = default;
+
+        // 独立的堆中的线程缓存，向指定的中心缓存申请
+        explicit thread_cache(central_cache &central) : m_central_cache(&central) {}
+
         // 向内存池申请一块空间
         // 参数：要申请的大小
         // 返回值：指向空间的指针，可能会申请失败
@@ -37,9 +51,183 @@ namespace memory_pool
         // 参数： start_p:内存开始的地址, size_t：这片地址的大小
         void deallocate(void *start_p, size_t memory_size);
 
+        // 不抛出异常的申请，失败时返回nullptr
+        // 空闲链表不为空时直接在这里取出链表头，只有需要向中心缓存申请或者需要采样时才调用慢路径
+        [[nodiscard("不应该忽略这个值，还需要手动归还到内存池中")]] void *allocate_raw(size_t memory_size) noexcept
+        {
+            // memory_size为0时减1会回绕成最大值，和大内存一样走慢路径
+            if (memory_size - 1 < size_utils::MAX_CACHED_UNIT_SIZE)
+            {
+                const size_t index = size_utils::get_index(memory_size);
+                std::byte *result = m_free_cache[index];
+                // 采样的倒数，没有开启采样时快速路径也只多了这一次减法和判断
+                m_bytes_until_sample -= static_cast<std::ptrdiff_t>(memory_size);
+                if (result != nullptr && m_bytes_until_sample >= 0) [[likely]]
+                {
+                    m_free_cache[index] = *(reinterpret_cast<std::byte **>(result));
+                    m_free_cache_size[index]--;
+                    m_allocate_count[size_utils::get_counter_index(index)]++;
+                    record_allocate(result, memory_size);
+                    return result;
+                }
+            }
+            void *result = allocate_slow(memory_size);
+            record_allocate(result, memory_size);
+            return result;
+        }
+
+        // 不抛出异常的归还，小内存直接挂到空闲链表上
+        // 参数： start_p:内存开始的地址, size_t：这片地址的大小
+        void deallocate_raw(void *start_p, size_t memory_size) noexcept
+        {
+            record_deallocate(start_p, memory_size);
+            if (start_p != nullptr && memory_size - 1 < size_utils::MAX_CACHED_UNIT_SIZE) [[likely]]
+            {
+                push_free_block(start_p, size_utils::get_index(memory_size));
+                return;
+            }
+            deallocate_slow(start_p, memory_size);
+        }
+
+        // 已经知道下标的小内存申请，下标可以在编译期算好，跳过对齐和下标的计算
+        // 参数：index:大小对应的下标，必须小于CACHE_LINE_SIZE
+        [[nodiscard("不应该忽略这个值，还需要手动归还到内存池中")]] std::optional<void *> allocate_by_index(size_t index)
+        {
+            m_bytes_until_sample -= static_cast<std::ptrdiff_t>((index + 1) * size_utils::ALIGNMENT);
+            if (m_free_cache[index] != nullptr && m_bytes_until_sample >= 0)
+            {
+                std::byte *result = m_free_cache[index];
+                m_free_cache[index] = *(reinterpret_cast<std::byte **>(result));
+                m_free_cache_size[index]--;
+                m_allocate_count[size_utils::get_counter_index(index)]++;
+                record_allocate(result, (index + 1) * size_utils::ALIGNMENT);
+                return result;
+            }
+            void *result = allocate_slow((index + 1) * size_utils::ALIGNMENT);
+            record_allocate(result, (index + 1) * size_utils::ALIGNMENT);
+            if (result == nullptr)
+            {
+                return std::nullopt;
+            }
+            return result;
+        }
+
+        // 已经知道下标的小内存归还
+        // 参数：start_p:内存开始的地址，不能为nullptr index:大小对应的下标，必须小于CACHE_LINE_SIZE
+        void deallocate_by_index(void *start_p, size_t index) noexcept
+        {
+            record_deallocate(start_p, (index + 1) * size_utils::ALIGNMENT);
+            push_free_block(start_p, index);
+        }
+
+        // 预先从中心缓存中取出指定个数的内存块放到空闲链表中，用于预热
+        // 为了不在之后的归还中马上被回收，个数不会超过一个列表缓存的上限
+        // 参数：memory_size:内存块的大小 block_count:空闲链表中至少要有的个数
+        bool reserve(size_t memory_size, size_t block_count);
+
     private:
+        // 把小内存块挂到空闲链表上，不记录这一次归还，记录由调用的地方负责
+        void push_free_block(void *start_p, size_t index) noexcept
+        {
+            m_deallocate_count++;
+            // 采样过的内存块在堆分析器的槽中，不属于任何空闲链表
+            if (heap_profiler::is_small_sample(start_p)) [[unlikely]]
+            {
+                heap_profiler::GetInstance().deallocate_small_sample(start_p);
+                return;
+            }
+#ifdef MEMORY_POOL_REMOTE_FREE
+            // 其他线程的span中的内存块，放到那个span的远程释放链表上
+            page_span *span = page_map::GetInstance().get(start_p);
+            if (span->owner_state().owner.load(std::memory_order_relaxed) != m_owner_token) [[unlikely]]
+            {
+                deallocate_remote(span, start_p);
+                return;
+            }
+#endif
+            std::byte *head = m_free_cache[index];
+            *(reinterpret_cast<std::byte **>(start_p)) = head;
+            m_free_cache[index] = reinterpret_cast<std::byte *>(start_p);
+            m_free_cache_size[index]++;
+            // 只归还不申请的线程可能一直不进入慢路径，链表第一次有内存块时注册，线程退出时才会回收
+            if (head == nullptr && m_counters == nullptr) [[unlikely]]
+            {
+                publish_counters(index);
+            }
+            // 如果当前的列表所维护的大小已经超过了阈值，则触发资源回收
+            if (over_limit(index))
+            {
+                release_to_central_cache(index);
+            }
+        }
+
+        // 对应的中心缓存
+        central_cache &central();
+
+        // 慢路径：空闲链表为空、大内存、大小为0或者采样的倒数减到了负数，失败时返回nullptr
+        // 小内存的采样的倒数已经在快速路径中减过了，大内存在这里减
+        void *allocate_slow(size_t memory_size) noexcept;
+
+        // 采样的倒数减到负数时调用，重新设置倒数
+        // 返回值：这一次申请要不要采样，没有开启采样、独立的堆或者正在记录另一个采样时不采样
+        bool begin_sample() noexcept;
+
+        // 慢路径：大内存直接还给中心缓存
+        void deallocate_slow(void *start_p, size_t memory_size) noexcept;
+
         // 向高层申请一块空间
-        std::optional<std::byte *> allocate_from_central_cache(size_t memory_size);
+        std::byte *allocate_from_central_cache(size_t memory_size);
+
+        // 把空闲链表中一半的内存块还给中心缓存
+        // 中心缓存只有在记录页面的元数据都申请不到时才会抛出异常，这时在noexcept的归还中直接终止程序
+        void release_to_central_cache(size_t index);
+
+        // 把一种大小空闲链表的长度和操作次数发布到统计记录中，只在慢路径中调用
+        // 第一次调用时注册统计记录，默认堆的线程缓存同时登记线程退出时的回收
+        // 参数：index:大小对应的下标，大内存传入CACHE_LINE_SIZE，只发布操作次数
+        void publish_counters(size_t index) noexcept;
+
+        // 线程退出时调用（pthread的线程局部数据的析构函数），参数为退出的线程的线程缓存
+        static void on_thread_exit(void *cache) noexcept;
+
+        // 把空闲链表中的内存块全部还给中心缓存（MEMORY_POOL_REMOTE_FREE模式下先交还拥有的span），统计记录交还给中心缓存复用
+        // 之后这个线程如果还有申请和归还（其他线程局部数据的析构函数中），会重新注册，退出时再回收一次
+        void release_on_thread_exit() noexcept;
+
+        // 空闲链表维护的大小是否超过了阈值
+        bool over_limit(size_t index) const
+        {
+#ifdef MEMORY_POOL_REMOTE_FREE
+            // 上一次检查时没有能整个归还的span，等链表变长以后再检查
+            if (m_free_cache_size[index] < m_next_release_count[index])
+            {
+                return false;
+            }
+#endif
+            return m_free_cache_size[index] * (index + 1) * size_utils::ALIGNMENT > MAX_FREE_BYTES_PER_LISTS;
+        }
+
+#ifdef MEMORY_POOL_REMOTE_FREE
+        // 归还其他线程的span中的内存块
+        void deallocate_remote(page_span *span, void *start_p) noexcept;
+
+        // 从拥有的span中取内存块：先取走其他线程归还的，没有时再向中心缓存要一个新的span
+        std::byte *allocate_from_owned_spans(size_t memory_size);
+
+        // 向中心缓存要一个新的span，切分好以后全部放入空闲链表
+        bool acquire_owned_span(size_t memory_size);
+
+        // 把拥有的span中其他线程归还的内存块全部放入空闲链表
+        // 返回值：是否取到了内存块
+        bool collect_remote_frees(size_t index);
+
+        // 把全部空闲的span整个还给中心缓存
+        void release_owned_spans(size_t index);
+
+        // 线程退出时交还拥有的span：全部空闲的整个还给中心缓存，其余的清掉拥有者，
+        // 关闭远程释放链表，空闲的内存块还给中心缓存，之后这些span中的内存块都直接还给中心缓存
+        void disown_spans(size_t index);
+#endif
 
         // 当前还没有被分配的内存
         std::array<std::byte *, size_utils::CACHE_LINE_SIZE> m_free_cache = {};
@@ -51,6 +239,34 @@ namespace memory_pool
 
         // 用于表示下一次再申请指定大小的内存时，会申请几个内存
         std::array<size_t, size_utils::CACHE_LINE_SIZE> m_next_allocate_count = {};
+
+        // 对应的中心缓存，为nullptr时使用默认的中心缓存，这样默认堆的线程缓存可以在编译期初始化
+        central_cache *m_central_cache = nullptr;
+
+        // 2KB以内每一种大小的申请次数（最后一项为更大的大小和大内存）和归还的总次数，在慢路径中发布到m_counters
+        std::array<size_t, size_utils::COUNTED_SIZE_CLASSES + 1> m_allocate_count = {};
+        size_t m_deallocate_count = 0;
+        // 在中心缓存中注册的统计记录，第一次进入慢路径时取得，线程退出时交还
+        thread_cache_counters *m_counters = nullptr;
+
+        // 距离下一次采样还剩的字节数，减到负数时进入慢路径
+        // 初始为0，第一次申请时就会在慢路径中按照是否开启了采样设置
+        std::ptrdiff_t m_bytes_until_sample = 0;
+        // 生成采样间隔的随机数状态
+        uint64_t m_sample_random = 0;
+        // 正在记录采样，记录调用栈时的申请不再采样
+        bool m_sampling = false;
+
+#ifdef MEMORY_POOL_REMOTE_FREE
+        // 还没有拥有过span时的编号，不和任何span的拥有者相等（包括没有拥有者的span）
+        static constexpr uint64_t UNASSIGNED_OWNER_TOKEN = ~uint64_t{0};
+        // 这个线程缓存拥有的span上记录的编号，第一次拥有span时分配，每个线程缓存都不同
+        uint64_t m_owner_token = UNASSIGNED_OWNER_TOKEN;
+        // 每一种大小拥有的span，通过span_owner_state::next_owned连成链表，默认堆的线程缓存在线程退出时交还
+        std::array<page_span *, size_utils::CACHE_LINE_SIZE> m_owned_spans = {};
+        // 空闲链表至少要有这么多个内存块才会再检查能不能归还span
+        std::array<size_t, size_utils::CACHE_LINE_SIZE> m_next_release_count = {};
+#endif
     };
 
 } // memory_pool
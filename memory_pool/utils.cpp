@@ -2,6 +2,10 @@
 
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace memory_pool
 {
@@ -64,4 +68,34 @@ namespace memory_pool
         }
         return result; // 返回总节点数
     }
+
+    void copy_memory(void *destination, const void *source, size_t size)
+    {
+#ifdef __SSE2__
+        const bool aligned = (reinterpret_cast<std::uintptr_t>(destination) | reinterpret_cast<std::uintptr_t>(source)) % 16 == 0;
+        if (size >= STREAMING_COPY_SIZE && aligned)
+        {
+            // 一次拷贝64字节，正好是一个缓存行
+            auto *dst = static_cast<__m128i *>(destination);
+            const auto *src = static_cast<const __m128i *>(source);
+            const size_t line_count = size / 64;
+            for (size_t i = 0; i < line_count; i++, dst += 4, src += 4)
+            {
+                __m128i a = _mm_load_si128(src);
+                __m128i b = _mm_load_si128(src + 1);
+                __m128i c = _mm_load_si128(src + 2);
+                __m128i d = _mm_load_si128(src + 3);
+                _mm_stream_si128(dst, a);
+                _mm_stream_si128(dst + 1, b);
+                _mm_stream_si128(dst + 2, c);
+                _mm_stream_si128(dst + 3, d);
+            }
+            // non-temporal写入需要sfence才能保证对其他线程可见的顺序
+            _mm_sfence();
+            std::memcpy(dst, src, size % 64);
+            return;
+        }
+#endif
+        std::memcpy(destination, source, size);
+    }
 } // memory_pool
\ No newline at end of file
@@ -1,9 +1,12 @@
 #ifndef UTILS_H
 #define UTILS_H
+#include <algorithm>
 #include <atomic>
+#include <bit>
 #include <bitset>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <span>
 #include <thread>
@@ -71,15 +74,42 @@ namespace memory_pool
         //  这个值就是缓存的最大的内容
         static constexpr size_t MAX_CACHED_UNIT_SIZE = 16 * 1024; // 16KB 为大内存的临界点
         static constexpr size_t CACHE_LINE_SIZE = MAX_CACHED_UNIT_SIZE / ALIGNMENT;
+        // CPU缓存行的字节数，开启MEMORY_POOL_CACHE_LINE_ISOLATION时按这个值隔离不同线程的内存块
+        static constexpr size_t CPU_CACHE_LINE_BYTES = 64;
         // 内存字节数对齐，对齐成8的倍数，8字节也是内存池最小的分配大小
-        static size_t align(const size_t memory_size, const size_t alignment = ALIGNMENT)
+        static constexpr size_t align(const size_t memory_size, const size_t alignment = ALIGNMENT)
         {
             return (memory_size + alignment - 1) & ~(alignment - 1);
         }
 
-        static size_t get_index(const size_t memory_size)
+        // 内存块实际使用的大小（分级的大小）
+        // 开启MEMORY_POOL_CACHE_LINE_ISOLATION时，64字节及以上的内存块按缓存行对齐，
+        // 更小的内存块向上取整到2的幂，保证一个内存块不会跨过缓存行
+        static constexpr size_t align_unit(const size_t memory_size)
         {
-            return align(memory_size) / ALIGNMENT - 1;
+#ifdef MEMORY_POOL_CACHE_LINE_ISOLATION
+            if (memory_size >= CPU_CACHE_LINE_BYTES)
+            {
+                return align(memory_size, CPU_CACHE_LINE_BYTES);
+            }
+            return std::bit_ceil(align(memory_size));
+#else
+            return align(memory_size);
+#endif
+        }
+
+        static constexpr size_t get_index(const size_t memory_size)
+        {
+            return align_unit(memory_size) / ALIGNMENT - 1;
+        }
+
+        // 线程缓存单独统计申请次数的大小个数（2KB以内），每个线程的计数器不会因为大小的个数而变得很大
+        static constexpr size_t COUNTED_SIZE_CLASSES = 256;
+
+        // 大小的下标对应的申请次数的下标，更大的大小和大内存（下标为CACHE_LINE_SIZE）合在最后一项中
+        static constexpr size_t get_counter_index(const size_t index)
+        {
+            return std::min(index, COUNTED_SIZE_CLASSES);
         }
     };
 
@@ -89,6 +119,70 @@ namespace memory_pool
     // 所以可以在debug的时候使用这种实现方法，确保内存不会被多次释放，而在release模式下使用下面那种方式
     // 如果限定了page_span的大小，就要确保central_cache中一次分配不超过指定的大小
 
+    class page_span;
+
+#ifdef MEMORY_POOL_REMOTE_FREE
+    // 交给某一个线程缓存的span的状态，只在 MEMORY_POOL_REMOTE_FREE 模式下使用
+    // 拥有者在本线程释放时直接放回自己的空闲链表，其他线程释放时放到这个span的远程释放链表上
+    // 拥有者的线程退出时把owner清零并关闭远程释放链表，之后的归还和中心缓存直接分配的内存块一样处理
+    struct span_owner_state
+    {
+        // 没有拥有者（中心缓存直接分配的，或者拥有者的线程已经退出）
+        static constexpr uint64_t NO_OWNER = 0;
+
+        // 拥有这个span的线程缓存的编号，在交给线程缓存之前设置，之后只会在拥有者的线程退出时清零
+        // 使用编号而不是线程缓存的地址：新线程的线程缓存可能和退出的线程在同一个地址上
+        std::atomic<uint64_t> owner = NO_OWNER;
+        // 切分出来的内存块个数
+        size_t unit_count = 0;
+        // 其他线程归还的内存块，原子地头插，由拥有者一次全部取走
+        std::atomic<std::byte *> remote_free_list = nullptr;
+        // 拥有者的同一个大小的下一个span，只由拥有者访问
+        page_span *next_owned = nullptr;
+        // 拥有者统计空闲链表时使用的计数，只由拥有者访问
+        size_t local_free_count = 0;
+
+        // 关闭以后的远程释放链表，不是有效的地址
+        static std::byte *closed_list()
+        {
+            return reinterpret_cast<std::byte *>(1);
+        }
+
+        // 其他线程归还一个内存块
+        // 返回值：链表已经关闭时返回false，内存块要直接还给中心缓存
+        bool push_remote_free(std::byte *memory)
+        {
+            std::byte *head = remote_free_list.load(std::memory_order_relaxed);
+            do
+            {
+                if (head == closed_list())
+                {
+                    return false;
+                }
+                *(reinterpret_cast<std::byte **>(memory)) = head;
+            } while (!remote_free_list.compare_exchange_weak(head, memory, std::memory_order_release,
+                                                             std::memory_order_relaxed));
+            return true;
+        }
+
+        // 拥有者取走所有远程归还的内存块
+        std::byte *take_remote_frees()
+        {
+            if (remote_free_list.load(std::memory_order_relaxed) == nullptr)
+            {
+                return nullptr;
+            }
+            return remote_free_list.exchange(nullptr, std::memory_order_acquire);
+        }
+
+        // 拥有者的线程退出时取走所有远程归还的内存块并关闭链表，之后的push_remote_free都会失败
+        std::byte *close_remote_frees()
+        {
+            return remote_free_list.exchange(closed_list(), std::memory_order_acquire);
+        }
+    };
+#endif
+
 #ifndef NDEBUG
     class page_span
     {
@@ -111,6 +205,12 @@ namespace memory_pool
             return m_allocated_map.none();
         }
 
+        // 可以切分出的内存块个数，受bitset容量的限制
+        size_t unit_count() { return std::min(m_memory.size() / m_unit_size, MAX_UNIT_COUNT); }
+
+        // 分配出去的内存块个数
+        size_t allocated_count() { return m_allocated_map.count(); }
+
         // 申请一块内存
         void allocate(memory_span memory);
 
@@ -135,11 +235,19 @@ namespace memory_pool
         // 获得这个所维护的地址
         memory_span get_memory_span() { return m_memory; }
 
+#ifdef MEMORY_POOL_REMOTE_FREE
+        // 属于哪一个线程缓存，以及其他线程归还的内存块
+        span_owner_state &owner_state() { return m_owner_state; }
+#endif
+
     private:
         // 这个page_span管理的空间大小
         const memory_span m_memory;
         // 一个分配单位的大小
         const size_t m_unit_size;
+#ifdef MEMORY_POOL_REMOTE_FREE
+        span_owner_state m_owner_state;
+#endif
         // 用于管理目前页面的分配情况（4096 / 8 = 512）
         // 这个是可以管理多个page合并的情况的，但是由于bitset是不可以动态分配的
         // 所以这里的值决定了整体的分配情况
@@ -167,6 +275,12 @@ namespace memory_pool
             return m_allocated_unit_count == 0;
         }
 
+        // 可以切分出的内存块个数
+        size_t unit_count() { return m_memory.size() / m_unit_size; }
+
+        // 分配出去的内存块个数
+        size_t allocated_count() { return m_allocated_unit_count; }
+
         // 申请一块内存
         void allocate(memory_span memory) { m_allocated_unit_count++; }
 
@@ -191,20 +305,32 @@ namespace memory_pool
         // 获得这个所维护的地址
         memory_span get_memory_span() { return m_memory; }
 
+#ifdef MEMORY_POOL_REMOTE_FREE
+        // 属于哪一个线程缓存，以及其他线程归还的内存块
+        span_owner_state &owner_state() { return m_owner_state; }
+#endif
+
     private:
         // 这个page_span管理的空间大小
         const memory_span m_memory;
         // 一个分配单位的大小
         const size_t m_unit_size;
-        // 管理的大小
-        size_t m_total_unit_count;
+#ifdef MEMORY_POOL_REMOTE_FREE
+        span_owner_state m_owner_state;
+#endif
         // 分配出去的个数
-        size_t m_allocated_unit_count;
+        size_t m_allocated_unit_count = 0;
     };
 
 #endif
 
     size_t check_ptr_length(std::byte *ptr);
+
+    // 超过这个大小的拷贝使用不经过缓存的写入，避免把缓存中的其他数据挤出去
+    constexpr size_t STREAMING_COPY_SIZE = 4 * 1024 * 1024;
+
+    // 拷贝内存，大块内存并且两边都按16字节对齐时使用non-temporal写入，其他情况使用memcpy
+    void copy_memory(void *destination, const void *source, size_t size);
 } // memory_pool
 
 #endif // UTILS_H
\ No newline at end of file
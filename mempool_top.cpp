@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <signal.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "memory_pool/memory_pool.h"
+
+// 查看另一个进程的内存池：读取它用 start_stats_segment（或者 LD_PRELOAD 时的环境变量 MEMORY_POOL_STATS_SEGMENT）
+// 发布到 /dev/shm/memory_pool.<pid> 中的统计，每隔一段时间刷新一次，显示各层的字节数、操作的速率、锁的竞争，
+// 以及申请最多的几种大小和它们在线程缓存中的命中率
+// 用法：mempool_top <pid> [-d 刷新间隔秒数] [-n 刷新次数] [-k 显示的大小个数]
+// 指定了 -n 时不清屏，逐次输出，方便重定向到文件
+
+const double DEFAULT_DELAY_SECONDS = 1;
+const size_t DEFAULT_TOP_SIZE_CLASSES = 15;
+
+struct top_options {
+    pid_t pid = 0;
+    double delay_seconds = DEFAULT_DELAY_SECONDS;
+    // 0表示一直刷新
+    size_t iterations = 0;
+    size_t top_size_classes = DEFAULT_TOP_SIZE_CLASSES;
+};
+
+std::string format_bytes(uint64_t bytes) {
+    const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    double value = static_cast<double>(bytes);
+    size_t unit = 0;
+    while (value >= 1024 && unit + 1 < std::size(units)) {
+        value /= 1024;
+        ++unit;
+    }
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << value << " " << units[unit];
+    return out.str();
+}
+
+// 两次读取之间的计数器增量，每秒
+double rate(uint64_t current, uint64_t previous, double seconds) {
+    return current >= previous ? (current - previous) / seconds : 0;
+}
+
+// 在上一次的读取中找到同样大小的项，没有时返回nullptr
+const memory_pool::shared_size_class_stats* find_size_class(const memory_pool::shared_stats& stats,
+                                                            uint64_t unit_size) {
+    const auto begin = stats.size_classes.begin();
+    const auto end = begin + stats.size_class_count;
+    const auto it = std::lower_bound(begin, end, unit_size,
+                                     [](const memory_pool::shared_size_class_stats& size_class, uint64_t size) {
+                                         return size_class.unit_size < size;
+                                     });
+    return it != end && it->unit_size == unit_size ? &*it : nullptr;
+}
+
+void print_lock(const char* name, const memory_pool::shared_lock_stats& current,
+                const memory_pool::shared_lock_stats& previous, double seconds) {
+    const double acquires = rate(current.acquire_count, previous.acquire_count, seconds);
+    const double contended = rate(current.contended_count, previous.contended_count, seconds);
+    std::cout << std::left << std::setw(14) << name << std::right << std::setw(12) << acquires << std::setw(14)
+              << contended << std::setw(11) << (acquires > 0 ? contended / acquires * 100 : 0) << "%"
+              << std::setw(14) << rate(current.total_wait_ns, previous.total_wait_ns, seconds) / 1e6 << std::setw(14)
+              << current.max_wait_ns / 1e3 << "\n";
+}
+
+void print(const top_options& options, const memory_pool::shared_stats& current,
+           const memory_pool::shared_stats& previous) {
+    const double seconds = std::max<double>(current.publish_ns - previous.publish_ns, 1) / 1e9;
+    std::cout << "mempool_top - pid " << options.pid << ", " << current.thread_cache_count << " thread caches, "
+              << "window " << std::fixed << std::setprecision(2) << seconds << " s, publish #"
+              << current.publish_count << "\n\n";
+
+    std::cout << std::left << std::setw(16) << "in use" << std::setw(14) << format_bytes(current.in_use_bytes)
+              << std::setw(16) << "mapped" << format_bytes(current.mapped_bytes) << "\n"
+              << std::setw(16) << "thread caches" << std::setw(14) << format_bytes(current.thread_cache_bytes)
+              << std::setw(16) << "resident" << format_bytes(current.resident_bytes) << "\n"
+              << std::setw(16) << "central free" << std::setw(14) << format_bytes(current.central_free_bytes)
+              << std::setw(16) << "reserved" << format_bytes(current.reserved_bytes) << "\n"
+              << std::setw(16) << "page free" << std::setw(14) << format_bytes(current.page_free_bytes)
+              << std::setw(16) << "large units" << format_bytes(current.large_unit_bytes) << "\n"
+              << std::setw(16) << "metadata" << format_bytes(current.metadata_bytes) << "\n\n";
+
+    std::cout << std::setprecision(0) << std::left << std::setw(16) << "alloc/s" << std::setw(14)
+              << rate(current.allocate_count, previous.allocate_count, seconds) << std::setw(16) << "free/s"
+              << rate(current.deallocate_count, previous.deallocate_count, seconds) << "\n"
+              << std::setw(16) << "refill/s" << std::setw(14)
+              << rate(current.central_allocate_count, previous.central_allocate_count, seconds) << std::setw(16)
+              << "release/s" << rate(current.central_deallocate_count, previous.central_deallocate_count, seconds)
+              << "\n"
+              << std::setw(16) << "page alloc/s" << std::setw(14)
+              << rate(current.page_allocate_count, previous.page_allocate_count, seconds) << std::setw(16)
+              << "page free/s" << rate(current.page_deallocate_count, previous.page_deallocate_count, seconds) << "\n"
+              << std::setw(16) << "mmap/s" << std::setw(14)
+              << rate(current.system_map_count, previous.system_map_count, seconds) << std::setw(16) << "munmap/s"
+              << rate(current.system_unmap_count, previous.system_unmap_count, seconds) << "\n\n";
+
+    std::cout << std::left << std::setw(14) << "lock" << std::right << std::setw(12) << "acquire/s" << std::setw(14)
+              << "contended/s" << std::setw(12) << "contended" << std::setw(14) << "wait ms/s" << std::setw(14)
+              << "max wait us" << "\n";
+    print_lock("central", current.central_lock, previous.central_lock, seconds);
+    print_lock("page", current.page_lock, previous.page_lock, seconds);
+    std::cout << "\n";
+
+    // 按这段时间内的申请速率排列
+    struct size_class_rate {
+        const memory_pool::shared_size_class_stats* current;
+        const memory_pool::shared_size_class_stats* previous;
+        double allocations;
+    };
+    const memory_pool::shared_size_class_stats empty;
+    std::vector<size_class_rate> size_classes;
+    for (size_t i = 0; i < current.size_class_count; ++i) {
+        const memory_pool::shared_size_class_stats& size_class = current.size_classes[i];
+        const memory_pool::shared_size_class_stats* last = find_size_class(previous, size_class.unit_size);
+        if (last == nullptr) {
+            last = &empty;
+        }
+        size_classes.push_back({&size_class, last, rate(size_class.allocate_count, last->allocate_count, seconds)});
+    }
+    std::sort(size_classes.begin(), size_classes.end(), [](const size_class_rate& a, const size_class_rate& b) {
+        return a.allocations != b.allocations ? a.allocations > b.allocations
+                                              : a.current->in_use_blocks > b.current->in_use_blocks;
+    });
+    size_classes.resize(std::min(size_classes.size(), options.top_size_classes));
+
+    std::cout << std::right << std::setw(8) << "size" << std::setw(12) << "alloc/s" << std::setw(9) << "hit %"
+              << std::setw(11) << "refill/s" << std::setw(12) << "in use" << std::setw(12) << "cached"
+              << std::setw(14) << "central free" << std::setw(13) << "contended/s" << "\n";
+    for (const size_class_rate& entry : size_classes) {
+        const auto& size_class = *entry.current;
+        const auto& last = *entry.previous;
+        const double refills = rate(size_class.central_allocate_count, last.central_allocate_count, seconds);
+        std::cout << std::setw(8) << size_class.unit_size;
+        using memory_pool::size_utils;
+        if (size_class.unit_size <= size_utils::COUNTED_SIZE_CLASSES * size_utils::ALIGNMENT) {
+            // 没有经过中心缓存的申请都是线程缓存直接命中的
+            const double hit = entry.allocations > 0 ? std::max(0.0, 1 - refills / entry.allocations) * 100 : 0;
+            std::cout << std::setw(12) << std::setprecision(0) << entry.allocations << std::setw(9)
+                      << std::setprecision(1) << hit;
+        } else {
+            // 更大的大小没有单独统计申请次数
+            std::cout << std::setw(12) << "-" << std::setw(9) << "-";
+        }
+        std::cout << std::setw(11) << std::setprecision(0) << refills << std::setw(12) << size_class.in_use_blocks
+                  << std::setw(12) << size_class.thread_cache_blocks << std::setw(14) << size_class.central_free_blocks
+                  << std::setw(13) << rate(size_class.lock_contended_count, last.lock_contended_count, seconds)
+                  << "\n";
+    }
+}
+
+bool parse_options(int argc, char* argv[], top_options& options) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            options.delay_seconds = std::max(std::atof(argv[++i]), 0.05);
+        } else if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            options.iterations = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            options.top_size_classes = std::strtoul(argv[++i], nullptr, 10);
+        } else if (options.pid == 0 && std::atoi(argv[i]) > 0) {
+            options.pid = std::atoi(argv[i]);
+        } else {
+            return false;
+        }
+    }
+    return options.pid != 0;
+}
+
+int main(int argc, char* argv[]) {
+    top_options options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "Usage: mempool_top <pid> [-d delay seconds] [-n iterations] [-k size classes]\n";
+        return 2;
+    }
+    // 进程崩溃时共享内存会留下，先确认进程还在
+    if (kill(options.pid, 0) != 0 && errno == ESRCH) {
+        std::cerr << "Process " << options.pid << " does not exist\n";
+        return 1;
+    }
+    std::unique_ptr<memory_pool::shared_stats> previous = memory_pool::read_stats_segment(options.pid);
+    if (previous == nullptr) {
+        std::cerr << "Cannot read " << memory_pool::stats_segment_path(options.pid)
+                  << " (start it with memory_pool::start_stats_segment or MEMORY_POOL_STATS_SEGMENT=<ms>)\n";
+        return 1;
+    }
+
+    const bool interactive = options.iterations == 0;
+    for (size_t iteration = 0; interactive || iteration < options.iterations; ++iteration) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(options.delay_seconds));
+        std::unique_ptr<memory_pool::shared_stats> current = memory_pool::read_stats_segment(options.pid);
+        if (current == nullptr) {
+            std::cerr << "Process " << options.pid << " stopped publishing\n";
+            return 1;
+        }
+        // 刷新比发布快时这次还没有新的内容
+        if (current->publish_count == previous->publish_count) {
+            continue;
+        }
+        if (interactive) {
+            std::cout << "\033[H\033[2J";
+        } else if (iteration > 0) {
+            std::cout << "\n";
+        }
+        print(options, *current, *previous);
+        std::cout << std::flush;
+        previous = std::move(current);
+    }
+    return 0;
+}
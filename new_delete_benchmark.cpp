@@ -0,0 +1,105 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 模拟一个STL容器密集的工作负载：map、unordered_map和string的反复插入和删除
+// 同一份代码编译成两个程序，一个链接memory_pool_new（全局new/delete走内存池），一个使用默认的new/delete
+
+const size_t NUM_KEYS = 200000;           // 容器中同时存在的最多元素个数
+const size_t NUM_OPERATIONS = 2000000;    // 每一个负载执行的操作次数
+const unsigned int RANDOM_SEED = 54321;   // 固定的随机种子，确保每次运行结果可复现
+const unsigned int NUM_RUNS = 3;          // 运行次数
+
+std::string make_string(std::mt19937& rng) {
+    // 长度跨过短字符串优化的上限，一部分字符串会申请堆内存
+    std::uniform_int_distribution<size_t> length_dist(8, 96);
+    return std::string(length_dist(rng), static_cast<char>('a' + rng() % 26));
+}
+
+// 返回整个负载耗费的时间 (ms)
+template <typename Workload>
+double measure(Workload workload) {
+    auto start = std::chrono::steady_clock::now();
+    workload();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// 随机插入、删除 std::map<int, std::string>
+void map_churn() {
+    std::mt19937 rng(RANDOM_SEED);
+    std::map<int, std::string> map;
+    for (size_t i = 0; i < NUM_OPERATIONS; ++i) {
+        int key = static_cast<int>(rng() % NUM_KEYS);
+        if (rng() % 2 == 0) {
+            map[key] = make_string(rng);
+        } else {
+            map.erase(key);
+        }
+    }
+}
+
+// 随机插入、删除 std::unordered_map<std::string, std::vector<int>>
+void unordered_map_churn() {
+    std::mt19937 rng(RANDOM_SEED);
+    std::unordered_map<std::string, std::vector<int>> map;
+    for (size_t i = 0; i < NUM_OPERATIONS; ++i) {
+        std::string key = "key_" + std::to_string(rng() % NUM_KEYS);
+        if (rng() % 2 == 0) {
+            map[key].push_back(static_cast<int>(i));
+        } else {
+            map.erase(key);
+        }
+    }
+}
+
+// 字符串的拼接、拷贝和释放
+void string_churn() {
+    std::mt19937 rng(RANDOM_SEED);
+    std::vector<std::string> strings(NUM_KEYS / 4);
+    for (size_t i = 0; i < NUM_OPERATIONS; ++i) {
+        std::string& target = strings[rng() % strings.size()];
+        if (target.size() > 512) {
+            target = make_string(rng);
+        } else {
+            target += make_string(rng);
+        }
+    }
+}
+
+int main() {
+#ifdef USE_MEMORY_POOL_NEW
+    const char* allocator_name = "memory_pool operator new/delete";
+#else
+    const char* allocator_name = "default operator new/delete";
+#endif
+    std::cout << "\n=== STL Container Churn Benchmark ===\n"
+              << "Allocator: " << allocator_name << "\n"
+              << "Operations per workload: " << NUM_OPERATIONS << "\n"
+              << "Number of runs: " << NUM_RUNS << "\n\n";
+
+    double map_ms = 0, unordered_map_ms = 0, string_ms = 0;
+    for (unsigned int run = 0; run < NUM_RUNS; ++run) {
+        map_ms += measure(map_churn);
+        unordered_map_ms += measure(unordered_map_churn);
+        string_ms += measure(string_churn);
+    }
+
+    std::cout << std::left << std::setw(35) << "Workload"
+              << std::right << std::setw(15) << "Time (ms)" << "\n";
+    std::cout << std::string(50, '-') << "\n";
+    auto print_line = [](const std::string& name, double ms) {
+        std::cout << std::left << std::setw(35) << name
+                  << std::right << std::setw(15) << std::fixed << std::setprecision(2) << ms / NUM_RUNS << "\n";
+    };
+    print_line("std::map<int, string>", map_ms);
+    print_line("std::unordered_map<string, vector>", unordered_map_ms);
+    print_line("std::string append/assign", string_ms);
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "memory_pool/object_pool.h"
+
+// 对比 object_pool<T> 和 new/delete、std::make_unique 创建和销毁订单、会话对象的开销
+// 每一轮创建一批对象，再按随机顺序销毁一半、补回一半，模拟对象的不断进出
+
+const size_t NUM_LIVE_OBJECTS = 10000;   // 同时存在的对象个数
+const size_t NUM_ROUNDS = 200;           // 轮数
+const unsigned int RANDOM_SEED = 54321;  // 固定的随机种子，确保每次运行结果可复现
+const unsigned int NUM_RUNS = 3;         // 运行次数
+
+// 订单对象
+struct Order {
+    Order(uint64_t order_id, double order_price) : id(order_id), price(order_price) {}
+    uint64_t id;
+    double price;
+    uint32_t quantity = 0;
+    char symbol[12] = {};
+};
+
+// 会话对象
+struct Session {
+    explicit Session(uint64_t session_id) : id(session_id) {}
+    uint64_t id;
+    uint64_t last_active = 0;
+    char buffer[200] = {};
+};
+
+// 返回整个过程耗费的时间 (ms)
+// create(i)创建一个对象，destroy(p)销毁一个对象
+template <typename Pointer, typename Create, typename Destroy>
+double run_churn(Create create, Destroy destroy) {
+    std::mt19937 rng(RANDOM_SEED);
+    std::vector<Pointer> objects;
+    objects.reserve(NUM_LIVE_OBJECTS);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < NUM_LIVE_OBJECTS; ++i) {
+        objects.push_back(create(i));
+    }
+    for (size_t round = 0; round < NUM_ROUNDS; ++round) {
+        for (size_t i = 0; i < NUM_LIVE_OBJECTS / 2; ++i) {
+            size_t index = rng() % NUM_LIVE_OBJECTS;
+            destroy(std::move(objects[index]));
+            objects[index] = create(round * NUM_LIVE_OBJECTS + i);
+        }
+    }
+    for (auto& object : objects) {
+        destroy(std::move(object));
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <typename T, typename... Args>
+void run_type(const std::string& name, Args... args) {
+    memory_pool::object_pool<T> pool;
+    pool.reserve(NUM_LIVE_OBJECTS);
+
+    double pool_ms = 0, new_ms = 0, unique_ms = 0;
+    for (unsigned int run = 0; run < NUM_RUNS; ++run) {
+        pool_ms += run_churn<T*>([&](size_t i) { return pool.create(i, args...); },
+                                 [&](T* object) { pool.destroy(object); });
+        new_ms += run_churn<T*>([&](size_t i) { return new T(i, args...); },
+                                [](T* object) { delete object; });
+        unique_ms += run_churn<std::unique_ptr<T>>([&](size_t i) { return std::make_unique<T>(i, args...); },
+                                                   [](std::unique_ptr<T> object) { object.reset(); });
+    }
+    std::cout << std::left << std::setw(20) << name
+              << std::right << std::fixed << std::setprecision(2)
+              << std::setw(18) << pool_ms / NUM_RUNS
+              << std::setw(18) << new_ms / NUM_RUNS
+              << std::setw(18) << unique_ms / NUM_RUNS << "\n";
+}
+
+int main() {
+    std::cout << "\n=== object_pool Benchmark ===\n"
+              << "Live objects: " << NUM_LIVE_OBJECTS << ", rounds: " << NUM_ROUNDS << "\n"
+              << "Number of runs: " << NUM_RUNS << "\n\n";
+
+    std::cout << std::left << std::setw(20) << "Object"
+              << std::right << std::setw(18) << "object_pool (ms)"
+              << std::setw(18) << "new/delete (ms)"
+              << std::setw(18) << "make_unique (ms)" << "\n";
+    std::cout << std::string(74, '-') << "\n";
+    run_type<Order>("Order (" + std::to_string(sizeof(Order)) + " B)", 1.0);
+    run_type<Session>("Session (" + std::to_string(sizeof(Session)) + " B)");
+
+    return 0;
+}
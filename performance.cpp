@@ -567,6 +567,24 @@ void print_results_table(const AggregatedStats& pool_stats,
 
 }
 
+// 打印内存池中锁的争用情况，累计了所有运行
+void print_lock_contention() {
+    const memory_pool::pool_stats stats = memory_pool::memory_pool::stats();
+    std::cout << "\n--- 内存池锁争用 ---\n"
+              << std::left << std::setw(25) << "Lock" << std::right << std::setw(14) << "Acquired"
+              << std::setw(14) << "Contended" << std::setw(16) << "Wait (ms)" << std::setw(16) << "Max wait (us)" << "\n";
+    auto print_lock = [](const std::string& name, const memory_pool::lock_stats& lock) {
+        std::cout << std::left << std::setw(25) << name << std::right << std::setw(14) << lock.acquire_count
+                  << std::setw(14) << lock.contended_count << std::setw(16) << std::fixed << std::setprecision(3)
+                  << lock.total_wait_ns / 1e6 << std::setw(16) << lock.max_wait_ns / 1e3 << "\n";
+    };
+    print_lock("page_cache", stats.page_lock);
+    print_lock("central_cache (all)", stats.central_lock);
+    for (const auto& size_class : memory_pool::top_contended_size_classes(stats, 5)) {
+        print_lock("central_cache " + std::to_string(size_class.unit_size) + "B", size_class.lock);
+    }
+}
+
 // 修改main函数
 int main() {
     try {
@@ -657,6 +675,9 @@ int main() {
         } else {
             std::cerr << "\nNot enough successful tests to make meaningful comparisons.\n";
         }
+        if (pool_success) {
+            print_lock_contention();
+        }
 
     } catch (const std::exception& e) {
         std::cerr << "Program failed: " << e.what() << std::endl;
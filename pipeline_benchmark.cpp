@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "memory_pool/memory_pool.h"
+
+// 模拟生产者/消费者流水线：生产者线程申请消息，消费者线程处理完以后释放
+// 所有的释放都发生在另一个线程上，对比内存的膨胀（峰值常驻内存 / 峰值存活字节数）和吞吐量
+// 之后模拟线程的频繁创建：短暂的线程申请消息后退出，由主线程在它们退出以后释放，
+// 检查退出的线程的内存能不能回收，映射的内存不应该随轮数增长
+// 同一份代码编译成两个程序，一个使用默认的内存池，一个开启了 MEMORY_POOL_REMOTE_FREE
+
+const size_t NUM_PAIRS = 2;                    // 生产者/消费者的对数
+const size_t MESSAGES_PER_PRODUCER = 2000000;  // 每个生产者产生的消息个数
+const size_t BATCH_SIZE = 256;                 // 一次放入队列的消息个数
+const size_t MAX_QUEUED_BATCHES = 64;          // 队列中最多的批数，限制存活的消息个数
+const size_t MIN_MESSAGE_SIZE = 16;            // 最小的消息大小
+const size_t MAX_MESSAGE_SIZE = 512;           // 最大的消息大小
+const unsigned int RANDOM_SEED = 54321;        // 固定的随机种子，确保每次运行结果可复现
+const size_t CHURN_ROUNDS = 200;               // 线程创建的轮数
+const size_t CHURN_THREADS = 4;                // 每一轮创建的线程个数
+const size_t CHURN_MESSAGES = 2000;            // 每个线程申请的消息个数
+
+struct Message {
+    void* data;
+    size_t size;
+};
+
+// 一个生产者和一个消费者之间的有界队列
+class BatchQueue {
+public:
+    void push(std::vector<Message> batch) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_full.wait(lock, [this] { return m_batches.size() < MAX_QUEUED_BATCHES; });
+        m_batches.push_back(std::move(batch));
+        m_not_empty.notify_one();
+    }
+
+    // 空的批表示生产者已经结束
+    std::vector<Message> pop() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock, [this] { return !m_batches.empty(); });
+        std::vector<Message> batch = std::move(m_batches.front());
+        m_batches.pop_front();
+        m_not_full.notify_one();
+        return batch;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_not_full;
+    std::condition_variable m_not_empty;
+    std::deque<std::vector<Message>> m_batches;
+};
+
+// 进程的峰值常驻内存 (KB)
+size_t peak_rss_kb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::stoul(line.substr(6));
+        }
+    }
+    return 0;
+}
+
+// 一轮结束以后内存池映射的字节数
+size_t mapped_bytes() {
+    return memory_pool::memory_pool::stats().mapped_bytes;
+}
+
+// 每一轮的线程申请完消息就退出，主线程在所有线程退出以后再释放
+// 返回值：（耗时秒数，第一轮以后映射的字节数的增长）
+std::pair<double, size_t> run_thread_churn() {
+    size_t first_round_mapped = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < CHURN_ROUNDS; ++round) {
+        std::vector<std::vector<Message>> messages(CHURN_THREADS);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < CHURN_THREADS; ++t) {
+            threads.emplace_back([&, t] {
+                std::mt19937 rng(RANDOM_SEED + round * CHURN_THREADS + t);
+                std::uniform_int_distribution<size_t> size_dist(MIN_MESSAGE_SIZE, MAX_MESSAGE_SIZE);
+                messages[t].reserve(CHURN_MESSAGES);
+                for (size_t i = 0; i < CHURN_MESSAGES; ++i) {
+                    size_t size = size_dist(rng);
+                    void* data = memory_pool::memory_pool::allocate(size).value();
+                    std::memset(data, static_cast<int>(i), std::min(size, size_t{64}));
+                    // 一部分消息在线程内释放，让线程缓存的空闲链表中也留下内存块
+                    if (i % 4 == 0) {
+                        memory_pool::memory_pool::deallocate(data, size);
+                    } else {
+                        messages[t].push_back({data, size});
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (const auto& thread_messages : messages) {
+            for (const Message& message : thread_messages) {
+                memory_pool::memory_pool::deallocate(message.data, message.size);
+            }
+        }
+        if (round == 0) {
+            first_round_mapped = mapped_bytes();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    const size_t last_round_mapped = mapped_bytes();
+    return {std::chrono::duration<double>(end - start).count(),
+            last_round_mapped > first_round_mapped ? last_round_mapped - first_round_mapped : 0};
+}
+
+int main() {
+#ifdef MEMORY_POOL_REMOTE_FREE
+    const char* mode = "remote free";
+#else
+    const char* mode = "default";
+#endif
+    std::cout << "\n=== Producer/Consumer Pipeline Benchmark ===\n"
+              << "Mode: " << mode << "\n"
+              << "Pairs: " << NUM_PAIRS << ", messages per producer: " << MESSAGES_PER_PRODUCER
+              << " (" << MIN_MESSAGE_SIZE << "-" << MAX_MESSAGE_SIZE << " B)\n"
+              << "Batch size: " << BATCH_SIZE << ", max queued batches: " << MAX_QUEUED_BATCHES << "\n\n";
+
+    const size_t baseline_rss_kb = peak_rss_kb();
+    std::vector<BatchQueue> queues(NUM_PAIRS);
+    std::vector<std::thread> threads;
+    // 每一对的峰值存活字节数的上限：队列中的批、生产者和消费者各持有的一批
+    const size_t max_live_bytes = NUM_PAIRS * (MAX_QUEUED_BATCHES + 2) * BATCH_SIZE * MAX_MESSAGE_SIZE;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t pair = 0; pair < NUM_PAIRS; ++pair) {
+        threads.emplace_back([&, pair] {
+            std::mt19937 rng(RANDOM_SEED + pair);
+            std::uniform_int_distribution<size_t> size_dist(MIN_MESSAGE_SIZE, MAX_MESSAGE_SIZE);
+            std::vector<Message> batch;
+            batch.reserve(BATCH_SIZE);
+            for (size_t i = 0; i < MESSAGES_PER_PRODUCER; ++i) {
+                size_t size = size_dist(rng);
+                void* data = memory_pool::memory_pool::allocate(size).value();
+                std::memset(data, static_cast<int>(i), std::min(size, size_t{64}));
+                batch.push_back({data, size});
+                if (batch.size() == BATCH_SIZE) {
+                    queues[pair].push(std::move(batch));
+                    batch.clear();
+                    batch.reserve(BATCH_SIZE);
+                }
+            }
+            if (!batch.empty()) {
+                queues[pair].push(std::move(batch));
+            }
+            queues[pair].push({});
+        });
+        threads.emplace_back([&, pair] {
+            while (true) {
+                std::vector<Message> batch = queues[pair].pop();
+                if (batch.empty()) {
+                    break;
+                }
+                for (const Message& message : batch) {
+                    memory_pool::memory_pool::deallocate(message.data, message.size);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    size_t total_messages = NUM_PAIRS * MESSAGES_PER_PRODUCER;
+    size_t rss_growth_kb = peak_rss_kb() - baseline_rss_kb;
+    std::cout << std::left << std::setw(30) << "Time (ms)" << std::fixed << std::setprecision(2) << seconds * 1000 << "\n"
+              << std::setw(30) << "Throughput (M msgs/s)" << total_messages / seconds / 1e6 << "\n"
+              << std::setw(30) << "Peak RSS growth (KB)" << rss_growth_kb << "\n"
+              << std::setw(30) << "Max live bytes (KB)" << max_live_bytes / 1024 << "\n"
+              << std::setw(30) << "Blowup (RSS / live)" << static_cast<double>(rss_growth_kb) / (max_live_bytes / 1024) << "\n";
+
+    std::cout << "\n=== Thread Churn ===\n"
+              << "Rounds: " << CHURN_ROUNDS << ", threads per round: " << CHURN_THREADS
+              << ", messages per thread: " << CHURN_MESSAGES << " (freed by main after the thread exits)\n\n";
+    auto [churn_seconds, churn_growth] = run_thread_churn();
+    std::cout << std::left << std::setw(30) << "Time (ms)" << std::fixed << std::setprecision(2) << churn_seconds * 1000
+              << "\n"
+              << std::setw(30) << "Mapped growth (KB)" << churn_growth / 1024 << "\n";
+
+    return 0;
+}
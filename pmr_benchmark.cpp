@@ -0,0 +1,112 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+#include "memory_pool/pool_resource.h"
+
+// 对比不同的 std::pmr::memory_resource 在 pmr 容器上的表现
+// 每一个负载都使用同一个随机种子，保证不同的资源执行完全相同的操作
+
+const size_t NUM_KEYS = 100000;          // map中同时存在的最多元素个数
+const size_t NUM_OPERATIONS = 1000000;   // 每一个负载执行的操作次数
+const unsigned int RANDOM_SEED = 54321;  // 固定的随机种子，确保每次运行结果可复现
+const unsigned int NUM_RUNS = 3;         // 运行次数
+
+// 返回整个负载耗费的时间 (ms)
+template <typename Workload>
+double measure(Workload workload, std::pmr::memory_resource* resource) {
+    auto start = std::chrono::steady_clock::now();
+    workload(resource);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// 反复创建不同长度的 std::pmr::vector，逐个追加元素让它多次扩容
+void vector_workload(std::pmr::memory_resource* resource) {
+    std::mt19937 rng(RANDOM_SEED);
+    for (size_t i = 0; i < NUM_OPERATIONS / 100; ++i) {
+        std::pmr::vector<int> vector(resource);
+        size_t length = rng() % 1000;
+        for (size_t j = 0; j < length; ++j) {
+            vector.push_back(static_cast<int>(j));
+        }
+    }
+}
+
+// 随机插入、删除 std::pmr::map<int, int>
+void map_workload(std::pmr::memory_resource* resource) {
+    std::mt19937 rng(RANDOM_SEED);
+    std::pmr::map<int, int> map(resource);
+    for (size_t i = 0; i < NUM_OPERATIONS; ++i) {
+        int key = static_cast<int>(rng() % NUM_KEYS);
+        if (rng() % 2 == 0) {
+            map[key] = static_cast<int>(i);
+        } else {
+            map.erase(key);
+        }
+    }
+}
+
+// 随机替换一组 std::pmr::string，长度跨过短字符串优化的上限
+void string_workload(std::pmr::memory_resource* resource) {
+    std::mt19937 rng(RANDOM_SEED);
+    std::pmr::vector<std::pmr::string> strings(NUM_KEYS / 4, resource);
+    for (size_t i = 0; i < NUM_OPERATIONS; ++i) {
+        size_t length = 8 + rng() % 120;
+        strings[rng() % strings.size()] = std::pmr::string(length, 'x', resource);
+    }
+}
+
+int main() {
+    std::cout << "\n=== std::pmr Container Benchmark ===\n"
+              << "Operations per workload: " << NUM_OPERATIONS << "\n"
+              << "Number of runs: " << NUM_RUNS << "\n\n";
+
+    std::cout << std::left << std::setw(25) << "Resource"
+              << std::right << std::setw(15) << "vector (ms)"
+              << std::setw(15) << "map (ms)"
+              << std::setw(15) << "string (ms)" << "\n";
+    std::cout << std::string(70, '-') << "\n";
+
+    // 池资源每一次运行都重新创建，让它们和内存池一样从空的状态开始
+    auto run_resource = [](const std::string& name, auto make_resource) {
+        double vector_ms = 0, map_ms = 0, string_ms = 0;
+        for (unsigned int run = 0; run < NUM_RUNS; ++run) {
+            {
+                auto resource = make_resource();
+                vector_ms += measure(vector_workload, resource.get());
+            }
+            {
+                auto resource = make_resource();
+                map_ms += measure(map_workload, resource.get());
+            }
+            {
+                auto resource = make_resource();
+                string_ms += measure(string_workload, resource.get());
+            }
+        }
+        std::cout << std::left << std::setw(25) << name
+                  << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(15) << vector_ms / NUM_RUNS
+                  << std::setw(15) << map_ms / NUM_RUNS
+                  << std::setw(15) << string_ms / NUM_RUNS << "\n";
+    };
+
+    // 不拥有资源的包装，用于全局共享的资源
+    struct shared_resource {
+        std::pmr::memory_resource* resource;
+        std::pmr::memory_resource* get() const { return resource; }
+    };
+
+    run_resource("memory_pool", [] { return shared_resource{&memory_pool::pool_resource::GetInstance()}; });
+    run_resource("synchronized_pool", [] { return std::make_unique<std::pmr::synchronized_pool_resource>(); });
+    run_resource("unsynchronized_pool", [] { return std::make_unique<std::pmr::unsynchronized_pool_resource>(); });
+    run_resource("new_delete", [] { return shared_resource{std::pmr::new_delete_resource()}; });
+
+    return 0;
+}
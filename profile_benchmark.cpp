@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "memory_pool/memory_pool.h"
+
+// 测量进程重启以后到达稳定状态所需要的时间
+// 冷启动：计数器都从0开始，线程缓存和中心缓存需要多次小批量补充才能学到合适的大小
+// 热启动：先用load_profile恢复上一次保存的画像，再运行同样的负载
+// 两次都在新fork出来的子进程中运行，保证内存池的状态是全新的
+
+const size_t NUM_WINDOWS = 40;              // 统计窗口的个数
+const size_t OPS_PER_WINDOW = 50000;        // 每个窗口的操作数
+const size_t LIVE_OBJECTS = 200000;         // 稳定状态下存活的对象个数
+const size_t MIN_ALLOC_SIZE = 8;            // 最小分配大小
+const size_t MAX_ALLOC_SIZE = 2048;         // 最大分配大小
+const unsigned int RANDOM_SEED = 54321;     // 固定的随机种子，两次运行的负载完全一样
+const double STEADY_TOLERANCE = 1.25;       // 与稳定状态相差25%以内就认为已经稳定
+const size_t STEADY_WINDOWS = 3;            // 连续这么多个窗口都稳定才算到达稳定状态
+
+struct Block {
+    void* ptr;
+    size_t size;
+};
+
+// 运行负载，返回每个窗口耗费的时间 (us)
+std::vector<double> run_workload() {
+    std::mt19937 rng(RANDOM_SEED);
+    // 偏向小对象的分布，更接近实际的业务
+    std::geometric_distribution<size_t> size_dist(0.01);
+    std::vector<Block> live;
+    live.reserve(LIVE_OBJECTS);
+    std::vector<double> window_us;
+
+    for (size_t window = 0; window < NUM_WINDOWS; ++window) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < OPS_PER_WINDOW; ++i) {
+            // 存活对象还没到目标个数之前只分配，之后一半分配一半释放
+            bool should_allocate = live.size() < LIVE_OBJECTS ? true : (rng() & 1);
+            if (should_allocate || live.empty()) {
+                size_t size = std::clamp(MIN_ALLOC_SIZE + size_dist(rng) * 8, MIN_ALLOC_SIZE, MAX_ALLOC_SIZE);
+                live.push_back(Block{memory_pool::memory_pool::allocate(size).value(), size});
+            } else {
+                size_t index = rng() % live.size();
+                memory_pool::memory_pool::deallocate(live[index].ptr, live[index].size);
+                live[index] = live.back();
+                live.pop_back();
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        window_us.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+
+    for (const auto& block : live) {
+        memory_pool::memory_pool::deallocate(block.ptr, block.size);
+    }
+    return window_us;
+}
+
+// 打印一次运行的结果：前几个窗口的耗时、到达稳定状态的时间
+void report(const std::string& name, const std::vector<double>& window_us, double startup_us) {
+    // 以最后10个窗口的中位数作为稳定状态
+    std::vector<double> tail(window_us.end() - 10, window_us.end());
+    std::sort(tail.begin(), tail.end());
+    double steady_us = tail[tail.size() / 2];
+
+    // 第一个连续STEADY_WINDOWS个窗口都在容差以内的位置就是稳定状态的开始
+    size_t steady_window = window_us.size();
+    size_t stable_count = 0;
+    for (size_t i = 0; i < window_us.size(); ++i) {
+        stable_count = window_us[i] <= steady_us * STEADY_TOLERANCE ? stable_count + 1 : 0;
+        if (stable_count == STEADY_WINDOWS) {
+            steady_window = i + 1 - STEADY_WINDOWS;
+            break;
+        }
+    }
+    double time_to_steady_us = startup_us;
+    for (size_t i = 0; i < steady_window; ++i) {
+        time_to_steady_us += window_us[i];
+    }
+
+    std::cout << std::left << std::setw(12) << name
+              << std::right << std::fixed << std::setprecision(2)
+              << std::setw(15) << startup_us / 1000.0
+              << std::setw(15) << window_us[0] / 1000.0
+              << std::setw(15) << window_us[1] / 1000.0
+              << std::setw(15) << steady_us / 1000.0
+              << std::setw(12) << steady_window
+              << std::setw(18) << time_to_steady_us / 1000.0 << "\n";
+    std::cout.flush();
+}
+
+// 在子进程中运行，保证每一次都是一个全新的内存池
+template <typename Func>
+void run_in_child(Func func) {
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        func();
+        std::cout.flush();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+}
+
+int main(int argc, char* argv[]) {
+    std::string profile_path = argc > 1 ? argv[1] : "/tmp/memory_pool_benchmark.profile";
+
+    std::cout << "\n=== Warm Start Benchmark ===\n"
+              << "Windows: " << NUM_WINDOWS << " x " << OPS_PER_WINDOW << " ops\n"
+              << "Live objects: " << LIVE_OBJECTS << "\n"
+              << "Allocation size range: " << MIN_ALLOC_SIZE << " - " << MAX_ALLOC_SIZE << " bytes\n"
+              << "Profile: " << profile_path << "\n\n";
+
+    std::cout << std::left << std::setw(12) << "Start"
+              << std::right << std::setw(15) << "Load (ms)"
+              << std::setw(15) << "Window 1 (ms)"
+              << std::setw(15) << "Window 2 (ms)"
+              << std::setw(15) << "Steady (ms)"
+              << std::setw(12) << "Windows"
+              << std::setw(18) << "To steady (ms)" << "\n";
+    std::cout << std::string(102, '-') << "\n";
+
+    // 冷启动，结束时保存画像
+    run_in_child([&] {
+        auto window_us = run_workload();
+        report("cold", window_us, 0.0);
+        if (!memory_pool::memory_pool::save_profile(profile_path)) {
+            std::cerr << "save_profile failed\n";
+        }
+    });
+
+    // 热启动，先恢复画像
+    run_in_child([&] {
+        auto start = std::chrono::steady_clock::now();
+        bool loaded = memory_pool::memory_pool::load_profile(profile_path);
+        auto end = std::chrono::steady_clock::now();
+        if (!loaded) {
+            std::cerr << "load_profile failed\n";
+        }
+        auto window_us = run_workload();
+        report("warm", window_us, std::chrono::duration<double, std::micro>(end - start).count());
+    });
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "memory_pool/memory_pool.h"
+
+// 模拟一个不断翻倍增长的缓冲区（序列化缓冲区、列存的构建器等）
+// 从1MB开始每次翻倍直到上限，每次扩容以后把新增的部分写满
+
+const size_t START_SIZE = 1024 * 1024;                 // 起始大小 1MB
+const size_t DEFAULT_MAX_SIZE = 1024ull * 1024 * 1024; // 默认上限 1GB，可以通过第一个参数指定（单位MB）
+const unsigned int NUM_RUNS = 3;                       // 运行次数
+
+// 把 [from, to) 写一遍，模拟填充新扩出来的空间
+void fill(void* memory, size_t from, size_t to) {
+    std::memset(static_cast<char*>(memory) + from, 0x5a, to - from);
+}
+
+// 返回整个增长过程耗费的时间 (ms)
+template <typename GrowFunc, typename FreeFunc>
+double run_growth(size_t max_size, GrowFunc grow_func, FreeFunc free_func) {
+    auto start = std::chrono::steady_clock::now();
+    size_t size = START_SIZE;
+    void* buffer = grow_func(nullptr, 0, size);
+    fill(buffer, 0, size);
+    while (size < max_size) {
+        size_t new_size = size * 2;
+        buffer = grow_func(buffer, size, new_size);
+        if (buffer == nullptr) {
+            std::cerr << "grow failed at " << new_size << " bytes\n";
+            std::exit(1);
+        }
+        fill(buffer, size, new_size);
+        size = new_size;
+    }
+    free_func(buffer, size);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    size_t max_size = DEFAULT_MAX_SIZE;
+    if (argc > 1) {
+        max_size = std::stoull(argv[1]) * 1024 * 1024;
+    }
+
+    std::cout << "\n=== Growing Buffer Benchmark ===\n"
+              << "Growth: " << START_SIZE / (1024 * 1024) << " MB -> " << max_size / (1024 * 1024)
+              << " MB, doubling each step\n"
+              << "Number of runs: " << NUM_RUNS << "\n\n";
+
+    // 内存池的reallocate，超大块内存走mremap
+    auto pool_reallocate = [](void* p, size_t old_size, size_t new_size) -> void* {
+        auto ret = memory_pool::memory_pool::reallocate(p, old_size, new_size);
+        return ret.has_value() ? ret.value() : nullptr;
+    };
+    // 内存池申请新空间、拷贝、释放旧空间
+    auto pool_copy = [](void* p, size_t old_size, size_t new_size) -> void* {
+        auto ret = memory_pool::memory_pool::allocate(new_size);
+        if (!ret.has_value()) {
+            return nullptr;
+        }
+        if (p != nullptr) {
+            std::memcpy(ret.value(), p, old_size);
+            memory_pool::memory_pool::deallocate(p, old_size);
+        }
+        return ret.value();
+    };
+    // vector一类的容器：先尝试不移动地扩容，失败时再申请、拷贝、释放
+    auto pool_try_expand = [pool_copy](void* p, size_t old_size, size_t new_size) -> void* {
+        if (p != nullptr && memory_pool::memory_pool::try_expand(p, old_size, new_size)) {
+            return p;
+        }
+        return pool_copy(p, old_size, new_size);
+    };
+    auto pool_free = [](void* p, size_t size) { memory_pool::memory_pool::deallocate(p, size); };
+    auto libc_realloc = [](void* p, size_t, size_t new_size) { return realloc(p, new_size); };
+    auto libc_free = [](void* p, size_t) { free(p); };
+
+    double pool_reallocate_ms = 0, pool_try_expand_ms = 0, pool_copy_ms = 0, libc_realloc_ms = 0;
+    for (unsigned int run = 0; run < NUM_RUNS; ++run) {
+        pool_reallocate_ms += run_growth(max_size, pool_reallocate, pool_free);
+        pool_try_expand_ms += run_growth(max_size, pool_try_expand, pool_free);
+        pool_copy_ms += run_growth(max_size, pool_copy, pool_free);
+        libc_realloc_ms += run_growth(max_size, libc_realloc, libc_free);
+    }
+    pool_reallocate_ms /= NUM_RUNS;
+    pool_try_expand_ms /= NUM_RUNS;
+    pool_copy_ms /= NUM_RUNS;
+    libc_realloc_ms /= NUM_RUNS;
+
+    std::cout << std::left << std::setw(35) << "Method"
+              << std::right << std::setw(15) << "Time (ms)"
+              << std::setw(20) << "(vs copy)" << "\n";
+    std::cout << std::string(70, '-') << "\n";
+    auto print_line = [&](const std::string& name, double ms) {
+        std::cout << std::left << std::setw(35) << name
+                  << std::right << std::setw(15) << std::fixed << std::setprecision(2) << ms
+                  << std::setw(19) << (ms > 0 ? pool_copy_ms / ms : 0.0) << "x\n";
+    };
+    print_line("memory_pool::reallocate", pool_reallocate_ms);
+    print_line("memory_pool try_expand, else copy", pool_try_expand_ms);
+    print_line("memory_pool allocate+copy+free", pool_copy_ms);
+    print_line("libc realloc", libc_realloc_ms);
+
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "memory_pool/memory_pool.h"
+
+// 回放 MEMORY_POOL_ALLOCATION_TRACE 记录下来的申请和归还，对比内存池、malloc和pmr
+// 记录中的每个线程在回放时也是一个线程，按记录的先后顺序执行自己的操作；
+// 一个线程归还另一个线程申请的对象时，等到那个线程申请完再归还
+// 默认按记录的时间间隔执行（--speed 可以按比例加快），--fast 时不等待，只保留先后顺序
+// 用法：memory_pool_replay_benchmark [记录文件] [--fast] [--speed 倍数]
+
+const char* TRACE_PATH = "memory_pool_allocations.trace";
+// 离预定时间还有这么久时先睡眠，剩下的时间忙等
+const std::chrono::microseconds SLEEP_THRESHOLD{200};
+
+using latency_recorder = memory_pool::latency_recorder;
+
+struct pool_backend {
+    static constexpr const char* name = "memory_pool";
+    void* allocate(size_t size) { return memory_pool::memory_pool::allocate_raw(size); }
+    void deallocate(void* object, size_t size) { memory_pool::memory_pool::deallocate_raw(object, size); }
+};
+
+struct malloc_backend {
+    static constexpr const char* name = "malloc";
+    void* allocate(size_t size) { return std::malloc(size); }
+    void deallocate(void* object, size_t) { std::free(object); }
+};
+
+struct pmr_backend {
+    static constexpr const char* name = "pmr synchronized";
+    std::pmr::synchronized_pool_resource resource;
+    void* allocate(size_t size) { return resource.allocate(size, alignof(std::max_align_t)); }
+    void deallocate(void* object, size_t size) { resource.deallocate(object, size, alignof(std::max_align_t)); }
+};
+
+// 一个线程的回放结果，延迟按latency_recorder的桶计数
+struct thread_result {
+    std::array<uint64_t, latency_recorder::BUCKET_COUNT> buckets = {};
+    uint64_t operations = 0;
+    uint64_t total_ticks = 0;
+    uint64_t max_ticks = 0;
+    // 实际执行比预定时间晚的最大值 (ns)
+    int64_t max_lag_ns = 0;
+};
+
+struct replay_options {
+    bool fast = false;
+    double speed = 1;
+};
+
+// 延迟的分位数 (ns)，取所在桶的上界
+double percentile_ns(const std::array<uint64_t, latency_recorder::BUCKET_COUNT>& buckets, uint64_t total,
+                     double quantile, double ticks_per_ns) {
+    const uint64_t target = static_cast<uint64_t>(quantile * total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen > target) {
+            return latency_recorder::bucket_upper_bound(i) / ticks_per_ns;
+        }
+    }
+    return 0;
+}
+
+template <typename Backend>
+void replay(const memory_pool::allocation_trace& trace, const std::vector<std::vector<size_t>>& thread_events,
+            const std::vector<uint64_t>& object_sizes, const replay_options& options, double ticks_per_ns) {
+    Backend backend;
+    std::vector<std::atomic<void*>> objects(trace.object_count);
+    std::vector<thread_result> results(thread_events.size());
+    std::atomic<bool> go{false};
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_events.size(); ++t) {
+        threads.emplace_back([&, t] {
+            thread_result& result = results[t];
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t index : thread_events[t]) {
+                const memory_pool::allocation_event& event = trace.events[index];
+                if (!options.fast) {
+                    const auto target = start + std::chrono::nanoseconds(
+                                                     static_cast<int64_t>(event.time_ns / options.speed));
+                    auto now = std::chrono::steady_clock::now();
+                    if (target - now > SLEEP_THRESHOLD) {
+                        std::this_thread::sleep_for(target - now - SLEEP_THRESHOLD);
+                    }
+                    while ((now = std::chrono::steady_clock::now()) < target) {
+                    }
+                    result.max_lag_ns = std::max<int64_t>(
+                        result.max_lag_ns, std::chrono::duration_cast<std::chrono::nanoseconds>(now - target).count());
+                }
+                const size_t size = std::max<size_t>(object_sizes[event.object], 1);
+                uint64_t ticks = 0;
+                if (event.op == memory_pool::allocation_op::allocate) {
+                    const uint64_t begin = latency_recorder::now();
+                    void* object = backend.allocate(size);
+                    ticks = latency_recorder::now() - begin;
+                    static_cast<char*>(object)[0] = 1;
+                    objects[event.object].store(object, std::memory_order_release);
+                } else {
+                    // 另一个线程申请的对象，记录中申请在前，等它执行到
+                    void* object = objects[event.object].load(std::memory_order_acquire);
+                    while (object == nullptr) {
+                        std::this_thread::yield();
+                        object = objects[event.object].load(std::memory_order_acquire);
+                    }
+                    objects[event.object].store(nullptr, std::memory_order_relaxed);
+                    const uint64_t begin = latency_recorder::now();
+                    backend.deallocate(object, size);
+                    ticks = latency_recorder::now() - begin;
+                }
+                result.buckets[latency_recorder::bucket_index(ticks)]++;
+                result.operations++;
+                result.total_ticks += ticks;
+                result.max_ticks = std::max(result.max_ticks, ticks);
+            }
+        });
+    }
+    const auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    // 记录结束时还没有归还的对象
+    for (size_t object = 0; object < objects.size(); ++object) {
+        if (void* memory = objects[object].load(std::memory_order_relaxed)) {
+            backend.deallocate(memory, std::max<size_t>(object_sizes[object], 1));
+        }
+    }
+
+    thread_result total;
+    for (const thread_result& result : results) {
+        for (size_t i = 0; i < total.buckets.size(); ++i) {
+            total.buckets[i] += result.buckets[i];
+        }
+        total.operations += result.operations;
+        total.total_ticks += result.total_ticks;
+        total.max_ticks = std::max(total.max_ticks, result.max_ticks);
+        total.max_lag_ns = std::max(total.max_lag_ns, result.max_lag_ns);
+    }
+    std::cout << std::left << std::setw(20) << Backend::name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(12) << std::chrono::duration<double, std::milli>(end - start).count() << std::setw(12)
+              << total.total_ticks / ticks_per_ns / std::max<uint64_t>(total.operations, 1) << std::setw(12)
+              << percentile_ns(total.buckets, total.operations, 0.5, ticks_per_ns) << std::setw(12)
+              << percentile_ns(total.buckets, total.operations, 0.99, ticks_per_ns) << std::setw(12)
+              << percentile_ns(total.buckets, total.operations, 0.999, ticks_per_ns) << std::setw(14)
+              << total.max_ticks / ticks_per_ns / 1000;
+    if (!options.fast) {
+        std::cout << std::setw(14) << total.max_lag_ns / 1000.0;
+    }
+    std::cout << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::string trace_path = TRACE_PATH;
+    replay_options options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--fast") == 0) {
+            options.fast = true;
+        } else if (std::strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            options.speed = std::max(std::atof(argv[++i]), 1e-3);
+        } else {
+            trace_path = argv[i];
+        }
+    }
+
+    std::optional<memory_pool::allocation_trace> trace = memory_pool::load_allocation_trace(trace_path);
+    if (!trace.has_value()) {
+        std::cerr << "Cannot read allocation trace " << trace_path
+                  << " (record one with memory_pool_recording_allocation_trace_benchmark)\n";
+        return 1;
+    }
+
+    // 按线程分开，对象的大小以申请时为准，pmr归还时需要和申请时一样
+    std::vector<std::vector<size_t>> thread_events(trace->thread_count);
+    std::vector<uint64_t> object_sizes(trace->object_count);
+    for (size_t i = 0; i < trace->events.size(); ++i) {
+        const memory_pool::allocation_event& event = trace->events[i];
+        thread_events[event.thread].push_back(i);
+        if (event.op == memory_pool::allocation_op::allocate) {
+            object_sizes[event.object] = event.size;
+        }
+    }
+    const uint64_t duration_ns = trace->events.empty() ? 0 : trace->events.back().time_ns;
+
+    std::cout << "\n=== Allocation Replay Benchmark ===\n"
+              << "Trace: " << trace_path << "\n"
+              << "Events: " << trace->events.size() << ", objects: " << trace->object_count
+              << ", threads: " << trace->thread_count << ", frees without a recorded allocation: "
+              << trace->unmatched_count << "\n"
+              << "Recorded duration: " << std::fixed << std::setprecision(2) << duration_ns / 1e6 << " ms, mode: "
+              << (options.fast ? std::string("as fast as possible")
+                               : "recorded timing at " + std::to_string(options.speed) + "x")
+              << "\n\n";
+
+    const double ticks_per_ns = latency_recorder::GetInstance().ticks_per_ns();
+    std::cout << std::left << std::setw(20) << "backend" << std::right << std::setw(12) << "wall ms" << std::setw(12)
+              << "mean ns" << std::setw(12) << "p50 ns" << std::setw(12) << "p99 ns" << std::setw(12) << "p99.9 ns"
+              << std::setw(14) << "max us";
+    if (!options.fast) {
+        std::cout << std::setw(14) << "max lag us";
+    }
+    std::cout << "\n";
+    replay<pool_backend>(*trace, thread_events, object_sizes, options, ticks_per_ns);
+    replay<malloc_backend>(*trace, thread_events, object_sizes, options, ticks_per_ns);
+    replay<pmr_backend>(*trace, thread_events, object_sizes, options, ticks_per_ns);
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "memory_pool/memory_pool.h"
+
+// 验证获取统计快照不会拖慢正在申请和归还的线程
+// 同样的工作量分别在没有读取统计、以及另一个线程每毫秒读取一次统计的情况下运行，对比耗时
+// 最后把一次快照以Prometheus的文本格式写到文件中，并列出各个慢路径的延迟分布
+
+const size_t NUM_THREADS = 4;                // 工作线程数
+const size_t OPERATIONS_PER_THREAD = 2000000; // 每个线程的申请次数
+const size_t LIVE_OBJECTS = 1024;            // 每个线程同时持有的对象个数
+const size_t MAX_OBJECT_SIZE = 2048;         // 最大的对象大小
+const unsigned int RANDOM_SEED = 54321;      // 固定的随机种子，确保每次运行结果可复现
+const char* STATS_PATH = "memory_pool_stats.prom";
+
+// 所有工作线程跑完需要的时间 (ms)
+double run_workers() {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < NUM_THREADS; ++t) {
+        threads.emplace_back([t] {
+            std::mt19937 rng(RANDOM_SEED + t);
+            std::vector<std::pair<void*, size_t>> objects(LIVE_OBJECTS, {nullptr, 0});
+            for (size_t i = 0; i < OPERATIONS_PER_THREAD; ++i) {
+                auto& [object, size] = objects[rng() % LIVE_OBJECTS];
+                memory_pool::memory_pool::deallocate(object, size);
+                size = rng() % MAX_OBJECT_SIZE + 1;
+                object = memory_pool::memory_pool::allocate(size).value();
+            }
+            for (auto& [object, size] : objects) {
+                memory_pool::memory_pool::deallocate(object, size);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main() {
+    std::cout << "\n=== Stats Snapshot Benchmark ===\n"
+              << "Threads: " << NUM_THREADS << ", operations per thread: " << OPERATIONS_PER_THREAD << "\n\n";
+
+    // 先跑一遍，让各层都准备好内存
+    run_workers();
+    double quiet_ms = run_workers();
+
+    std::atomic<bool> stop{false};
+    size_t snapshot_count = 0;
+    double max_snapshot_us = 0;
+    double total_snapshot_us = 0;
+    std::thread reader([&] {
+        while (!stop.load(std::memory_order_relaxed)) {
+            auto start = std::chrono::steady_clock::now();
+            memory_pool::pool_stats stats = memory_pool::memory_pool::stats();
+            auto end = std::chrono::steady_clock::now();
+            double snapshot_us = std::chrono::duration<double, std::micro>(end - start).count();
+            max_snapshot_us = std::max(max_snapshot_us, snapshot_us);
+            total_snapshot_us += snapshot_us;
+            snapshot_count += stats.size_classes.empty() ? 0 : 1;
+            // 采集程序一般按固定的间隔读取，这里取一个很短的间隔
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    double observed_ms = run_workers();
+    stop.store(true);
+    reader.join();
+
+    std::cout << std::left << std::setw(35) << "Workers without snapshots (ms)"
+              << std::fixed << std::setprecision(2) << quiet_ms << "\n"
+              << std::setw(35) << "Workers with snapshots (ms)" << observed_ms << "\n"
+              << std::setw(35) << "Snapshots taken" << snapshot_count << "\n"
+              << std::setw(35) << "Average snapshot (us)" << total_snapshot_us / std::max<size_t>(snapshot_count, 1) << "\n"
+              << std::setw(35) << "Slowest snapshot (us)" << max_snapshot_us << "\n\n";
+
+    memory_pool::pool_stats stats = memory_pool::memory_pool::stats(true);
+    std::cout << std::setw(35) << "Mapped (KB)" << stats.mapped_bytes / 1024 << "\n"
+              << std::setw(35) << "Resident (KB)" << stats.resident_bytes / 1024 << "\n"
+              << std::setw(35) << "Thread caches (KB)" << stats.thread_cache_bytes / 1024 << "\n"
+              << std::setw(35) << "Central free lists (KB)" << stats.central_free_bytes / 1024 << "\n"
+              << std::setw(35) << "Free pages (KB)" << stats.page_free_bytes / 1024 << "\n"
+              << std::setw(35) << "Spans" << stats.span_count << "\n"
+              << std::setw(35) << "Fragmentation ratio" << stats.fragmentation_ratio << "\n\n";
+
+    // 延迟为三次运行的全部记录，读取时已经开始了新的窗口，写到文件中的只包括之后的记录
+    std::cout << std::setw(18) << "Slow path (ns)" << std::right << std::setw(10) << "count" << std::setw(10) << "p50"
+              << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(12) << "max" << "\n"
+              << std::setprecision(0);
+    for (size_t site = 0; site < memory_pool::LATENCY_SITE_COUNT; ++site) {
+        const memory_pool::latency_stats& latency = stats.latencies[site];
+        std::cout << std::left << std::setw(18)
+                  << memory_pool::latency_site_name(static_cast<memory_pool::latency_site>(site)) << std::right
+                  << std::setw(10) << latency.count << std::setw(10) << latency.p50_ns << std::setw(10) << latency.p99_ns
+                  << std::setw(10) << latency.p999_ns << std::setw(12) << latency.max_ns << "\n";
+    }
+    if (memory_pool::memory_pool::write_stats(STATS_PATH)) {
+        std::cout << "\nPrometheus metrics written to " << STATS_PATH << "\n";
+    }
+
+    return 0;
+}